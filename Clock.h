@@ -0,0 +1,48 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include "exa.h"
+
+namespace exa
+{
+	// High resolution clock based on SDL_GetPerformanceCounter
+	class Clock
+	{
+	public:
+		// Current value of high resolution counter in ticks
+		static inline uint64 now()
+		{
+			return SDL_GetPerformanceCounter();
+		}
+
+		// Ticks per second
+		static inline uint64 frequency()
+		{
+			static const uint64 s_frequency = SDL_GetPerformanceFrequency();
+			return s_frequency;
+		}
+
+		static inline double toSeconds(uint64 ticks)
+		{
+			return static_cast<double>(ticks) / static_cast<double>(frequency());
+		}
+
+		static inline double toMilliseconds(uint64 ticks)
+		{
+			return toSeconds(ticks) * 1000.0;
+		}
+
+		static inline uint64 fromSeconds(double seconds)
+		{
+			return static_cast<uint64>(seconds * static_cast<double>(frequency()));
+		}
+
+		// Seconds elapsed since ticks value
+		static inline double secondsSince(uint64 ticks)
+		{
+			return toSeconds(now() - ticks);
+		}
+	};
+}
@@ -0,0 +1,249 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "DrawBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Log.h"
+#include "Profiler.h"
+#include "StreamBuffer.h"
+#include "VertexArray.h"
+
+namespace exa
+{
+	namespace
+	{
+		// drawIndex = drawIndexBuffer[baseInstance + gl_InstanceID / divisor], divisor bigger than any
+		// instance count makes all instances of draw read entry of baseInstance
+		const GLuint DRAW_INDEX_DIVISOR = 0x7FFFFFFF;
+
+		// Largest GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT of existing hardware, padding reserved per batch
+		const size_t MAX_UNIFORM_ALIGNMENT = 256;
+
+		size_t getIndexSize(GLenum indexType)
+		{
+			return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16) : sizeof(uint32);
+		}
+	}
+
+	DrawBatch::DrawBatch(size_t drawDataStride)
+		: m_drawDataStride(drawDataStride)
+	{
+	}
+
+	void DrawBatch::reset()
+	{
+		m_draws.clear();
+		m_drawData.clear();
+	}
+
+	void DrawBatch::add(const GeometryArena& arena, GeometryArena::Handle mesh, const void* drawData, uint32 instanceCount)
+	{
+		if (!arena.isValid(mesh)) {
+			log::warning("Adding invalid mesh %u to draw batch", mesh);
+			return;
+		}
+
+		const GeometryRange& range = arena.getRange(mesh);
+
+		DrawElementsIndirectCommand draw;
+		draw.count = range.indexCount;
+		draw.instanceCount = instanceCount;
+		draw.firstIndex = static_cast<uint32>(range.indexOffset / getIndexSize(arena.getIndexType()));
+		draw.baseVertex = range.baseVertex;
+		draw.baseInstance = static_cast<uint32>(m_draws.size());
+		m_draws.push_back(draw);
+
+		if (m_drawDataStride > 0) {
+			const size_t offset = m_drawData.size();
+			m_drawData.resize(offset + m_drawDataStride);
+			if (drawData != nullptr) {
+				memcpy(&m_drawData[offset], drawData, m_drawDataStride);
+			}
+			else {
+				memset(&m_drawData[offset], 0, m_drawDataStride);
+			}
+		}
+	}
+
+	DrawBatcher::DrawBatcher(GeometryArena* arena, uint32 maxDraws, size_t drawDataStride, DrawBatcherMode preferredMode)
+		: m_arena(arena)
+		, m_mode(preferredMode)
+		, m_maxDraws(maxDraws)
+		, m_drawDataStride(drawDataStride)
+	{
+		// drawIndex attribute is fed by baseInstance of indirect commands, which must be zero without ARB_base_instance
+		if (m_mode == DrawBatcherMode::EXA_MULTI_DRAW_INDIRECT
+			&& !(GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance && GLAD_GL_ARB_shader_storage_buffer_object)) {
+			log::message("Multi draw indirect is not supported, draws are submitted one by one");
+			m_mode = DrawBatcherMode::EXA_CPU_LOOP;
+		}
+
+		if (m_mode == DrawBatcherMode::EXA_MULTI_DRAW_INDIRECT) {
+			m_indirect = exanew StreamBuffer(GL_DRAW_INDIRECT_BUFFER, maxDraws * sizeof(DrawElementsIndirectCommand));
+			if (m_drawDataStride > 0) {
+				m_drawData = exanew StreamBuffer(GL_SHADER_STORAGE_BUFFER, maxDraws * m_drawDataStride);
+			}
+
+			std::vector<uint32> drawIndices(maxDraws);
+			for (uint32 i = 0; i < maxDraws; i++) {
+				drawIndices[i] = i;
+			}
+
+			exaglGenBuffers(1, &m_drawIndexBuffer);
+			exaglBindBuffer(GL_ARRAY_BUFFER, m_drawIndexBuffer);
+			exaglBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(drawIndices.size() * sizeof(uint32)), drawIndices.data(), GL_STATIC_DRAW);
+
+			// Attribute array is part of arena vertex array, so it survives arena growth
+			m_arena->getVertexArray()->bind();
+			exaglEnableVertexAttribArray(DRAW_INDEX_LOCATION);
+			exaglVertexAttribIPointer(DRAW_INDEX_LOCATION, 1, GL_UNSIGNED_INT, 0, nullptr);
+			exaglVertexAttribDivisor(DRAW_INDEX_LOCATION, DRAW_INDEX_DIVISOR);
+			m_arena->getVertexArray()->unbind();
+		}
+		else if (m_drawDataStride > 0) {
+			GLint maxBlockSize = 0;
+			exaglGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+			m_maxUniformDraws = std::max(static_cast<uint32>(maxBlockSize / m_drawDataStride), 1u);
+
+			// Every batch starts at aligned offset
+			m_drawData = exanew StreamBuffer(GL_UNIFORM_BUFFER, maxDraws * (m_drawDataStride + MAX_UNIFORM_ALIGNMENT));
+		}
+	}
+
+	DrawBatcher::~DrawBatcher()
+	{
+		SafeDelete(m_indirect);
+		SafeDelete(m_drawData);
+
+		if (m_drawIndexBuffer != 0) {
+			exaglDeleteBuffers(1, &m_drawIndexBuffer);
+		}
+	}
+
+	void DrawBatcher::record(RenderCommandBuffer& commands, const DrawBatch& batch, GLenum mode)
+	{
+		if (batch.getDrawCount() == 0) {
+			return;
+		}
+
+		if (batch.getDrawDataStride() != m_drawDataStride) {
+			log::error("Draw batch has %u bytes of data per draw, batcher expects %u",
+				static_cast<unsigned int>(batch.getDrawDataStride()), static_cast<unsigned int>(m_drawDataStride));
+			return;
+		}
+
+		commands.bindVertexArray(m_arena->getVertexArray());
+		commands.drawBatch(this, mode, batch.getDraws().data(), batch.getDrawCount(),
+			batch.getDrawData().data(), batch.getDrawData().size());
+	}
+
+	void DrawBatcher::submit(GLenum mode, const DrawElementsIndirectCommand* draws, uint32 drawCount, const void* drawData)
+	{
+		if (drawCount == 0) {
+			return;
+		}
+
+		if (drawCount > m_maxDraws) {
+			log::error("Draw batch of %u draws exceeds limit of %u draws", drawCount, m_maxDraws);
+			return;
+		}
+
+		m_frameDraws += drawCount;
+
+		if (m_mode == DrawBatcherMode::EXA_MULTI_DRAW_INDIRECT) {
+			submitIndirect(mode, draws, drawCount, drawData);
+		}
+		else {
+			submitLoop(mode, draws, drawCount, drawData);
+		}
+	}
+
+	void DrawBatcher::submitIndirect(GLenum mode, const DrawElementsIndirectCommand* draws, uint32 drawCount, const void* drawData)
+	{
+		const size_t indirectOffset = m_indirect->write(draws, drawCount * sizeof(DrawElementsIndirectCommand));
+		if (indirectOffset == StreamBuffer::INVALID_OFFSET) {
+			return;
+		}
+
+		if (m_drawData != nullptr && drawData != nullptr) {
+			const size_t size = drawCount * m_drawDataStride;
+			const size_t offset = m_drawData->write(drawData, size);
+			if (offset == StreamBuffer::INVALID_OFFSET) {
+				return;
+			}
+			m_drawData->bindRange(DRAW_DATA_BINDING, offset, size);
+		}
+
+		m_indirect->bind();
+		exaglMultiDrawElementsIndirect(mode, m_arena->getIndexType(), reinterpret_cast<const GLvoid*>(indirectOffset), static_cast<GLsizei>(drawCount), 0);
+		m_frameCalls++;
+	}
+
+	void DrawBatcher::submitLoop(GLenum mode, const DrawElementsIndirectCommand* draws, uint32 drawCount, const void* drawData)
+	{
+		const GLenum indexType = m_arena->getIndexType();
+		const size_t indexSize = getIndexSize(indexType);
+
+		// Uniform block holds limited number of draws, batch is split into chunks
+		const uint32 chunkSize = m_maxUniformDraws > 0 ? m_maxUniformDraws : drawCount;
+
+		for (uint32 chunkStart = 0; chunkStart < drawCount; chunkStart += chunkSize) {
+			const uint32 chunkCount = std::min(chunkSize, drawCount - chunkStart);
+
+			if (m_drawData != nullptr && drawData != nullptr) {
+				const size_t size = chunkCount * m_drawDataStride;
+				const size_t offset = m_drawData->write(static_cast<const unsigned char*>(drawData) + chunkStart * m_drawDataStride, size);
+				if (offset == StreamBuffer::INVALID_OFFSET) {
+					return;
+				}
+				m_drawData->bindRange(DRAW_DATA_BINDING, offset, size);
+			}
+
+			for (uint32 i = 0; i < chunkCount; i++) {
+				const DrawElementsIndirectCommand& draw = draws[chunkStart + i];
+
+				// Attribute array is disabled, shader reads current generic value
+				exaglVertexAttribI1ui(DRAW_INDEX_LOCATION, i);
+				exaglDrawElementsInstancedBaseVertex(mode, static_cast<GLsizei>(draw.count), indexType,
+					reinterpret_cast<const GLvoid*>(draw.firstIndex * indexSize), static_cast<GLsizei>(draw.instanceCount), draw.baseVertex);
+				m_frameCalls++;
+			}
+		}
+	}
+
+	void DrawBatcher::beginFrame()
+	{
+		m_frameDraws = 0;
+		m_frameCalls = 0;
+
+		if (m_indirect != nullptr) {
+			m_indirect->beginFrame();
+		}
+		if (m_drawData != nullptr) {
+			m_drawData->beginFrame();
+		}
+	}
+
+	void DrawBatcher::endFrame()
+	{
+		if (m_indirect != nullptr) {
+			m_indirect->endFrame();
+		}
+		if (m_drawData != nullptr) {
+			m_drawData->endFrame();
+		}
+	}
+
+	void DrawBatcher::beginFrameCallback(void* userData, const FrameSnapshot& /*snapshot*/)
+	{
+		static_cast<DrawBatcher*>(userData)->beginFrame();
+	}
+
+	void DrawBatcher::endFrameCallback(void* userData, const FrameSnapshot& /*snapshot*/)
+	{
+		static_cast<DrawBatcher*>(userData)->endFrame();
+	}
+}
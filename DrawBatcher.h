@@ -0,0 +1,177 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "exa.h"
+#include "GeometryArena.h"
+#include "RenderCommandBuffer.h"
+
+namespace exa
+{
+	class StreamBuffer;
+
+	// Record of indirect buffer, layout is fixed by OpenGL
+	struct DrawElementsIndirectCommand
+	{
+		uint32 count;
+		uint32 instanceCount;
+		// In indices, not bytes
+		uint32 firstIndex;
+		int32 baseVertex;
+		// Draw index within batch, read by shader as drawIndex attribute
+		uint32 baseInstance;
+	};
+
+	static_assert(sizeof(DrawElementsIndirectCommand) == 20, "Indirect command layout is fixed by OpenGL");
+
+	// How batches are submitted, picked by what driver supports
+	enum class DrawBatcherMode : std::int8_t
+	{
+		// One glMultiDrawElementsIndirect per batch, per-draw data in shader storage buffer
+		// (ARB_multi_draw_indirect, ARB_base_instance, ARB_shader_storage_buffer_object)
+		EXA_MULTI_DRAW_INDIRECT,
+		// Loop of glDrawElementsInstancedBaseVertex, per-draw data in uniform buffer
+		EXA_CPU_LOOP,
+		EXA_TOTAL_ITEMS
+	};
+
+	// Draws of meshes from one GeometryArena sharing material (shader, textures, state), recorded
+	// on any thread. Per-draw data is opaque block of fixed stride, std430 struct for shader storage
+	// buffer and std140 for uniform buffer fallback (use vec4 members to have both).
+	class DrawBatch
+	{
+	public:
+		explicit DrawBatch(size_t drawDataStride);
+
+		// Drops draws, keeps memory
+		void reset();
+
+		void add(const GeometryArena& arena, GeometryArena::Handle mesh, const void* drawData, uint32 instanceCount = 1);
+
+		template <typename DrawData>
+		void add(const GeometryArena& arena, GeometryArena::Handle mesh, const DrawData& drawData, uint32 instanceCount = 1)
+		{
+			add(arena, mesh, &drawData, instanceCount);
+		}
+
+		const std::vector<DrawElementsIndirectCommand>& getDraws() const {
+			return m_draws;
+		}
+
+		const std::vector<unsigned char>& getDrawData() const {
+			return m_drawData;
+		}
+
+		size_t getDrawDataStride() const {
+			return m_drawDataStride;
+		}
+
+		uint32 getDrawCount() const {
+			return static_cast<uint32>(m_draws.size());
+		}
+
+	private:
+		std::vector<DrawElementsIndirectCommand> m_draws;
+		std::vector<unsigned char> m_drawData;
+		size_t m_drawDataStride = 0;
+	};
+
+	// Submits whole batches with single API call, so driver overhead doesn't depend on number of objects.
+	// Shader reads index of draw from instanced attribute and fetches its data:
+	//
+	// layout(location = 15) in uint drawIndex;
+	// #if EXA_DRAW_DATA_SSBO
+	// layout(std430, binding = 0) readonly buffer DrawDataBlock { DrawData draws[]; };
+	// #else
+	// layout(std140) uniform DrawDataBlock { DrawData draws[MAX_DRAWS]; };
+	// #endif
+	//
+	// Fallback needs MAX_DRAWS of getMaxUniformDraws and shader.bindUniformBlock("DrawDataBlock", DRAW_DATA_BINDING).
+	//
+	// batch.add(*arena, mesh, drawData);
+	// commands.bindShader(shader);
+	// batcher.record(commands, batch);
+	//
+	// @note Instance attributes of arena vertex array are offset by draw index in multi draw mode.
+	//		 Submission must happen on thread owning OpenGL context, call beginFrame and endFrame there
+	//		 (beginFrameCallback, endFrameCallback)
+	class DrawBatcher
+	{
+	public:
+		// Location of drawIndex attribute, last one guaranteed by OpenGL
+		static const GLuint DRAW_INDEX_LOCATION = 15;
+
+		// Binding point of DrawDataBlock storage or uniform block
+		static const GLuint DRAW_DATA_BINDING = 0;
+
+		// @param maxDraws Draws per frame over all batches
+		// @param drawDataStride Bytes of per-draw data, same for all batches
+		DrawBatcher(GeometryArena* arena, uint32 maxDraws, size_t drawDataStride, DrawBatcherMode preferredMode = DrawBatcherMode::EXA_MULTI_DRAW_INDIRECT);
+		~DrawBatcher();
+
+		DrawBatcherMode getMode() const {
+			return m_mode;
+		}
+
+		// Value of EXA_DRAW_DATA_SSBO define for shaders drawn by batcher (Shader::addDefine)
+		const char* getDrawDataDefine() const {
+			return m_mode == DrawBatcherMode::EXA_MULTI_DRAW_INDIRECT ? "1" : "0";
+		}
+
+		// Draws per uniform block in fallback mode, size of draws array of uniform block
+		uint32 getMaxUniformDraws() const {
+			return m_maxUniformDraws;
+		}
+
+		// Records batch into command buffer, draws and their data are copied
+		void record(RenderCommandBuffer& commands, const DrawBatch& batch, GLenum mode = GL_TRIANGLES);
+
+		// Uploads and draws batch, called when command buffer is replayed
+		void submit(GLenum mode, const DrawElementsIndirectCommand* draws, uint32 drawCount, const void* drawData);
+
+		void beginFrame();
+
+		void endFrame();
+
+		static void beginFrameCallback(void* userData, const FrameSnapshot& snapshot);
+
+		static void endFrameCallback(void* userData, const FrameSnapshot& snapshot);
+
+		// Draws submitted since beginFrame
+		uint32 getDrawCount() const {
+			return m_frameDraws;
+		}
+
+		// API draw calls issued since beginFrame
+		uint32 getCallCount() const {
+			return m_frameCalls;
+		}
+
+	private:
+		void submitIndirect(GLenum mode, const DrawElementsIndirectCommand* draws, uint32 drawCount, const void* drawData);
+
+		void submitLoop(GLenum mode, const DrawElementsIndirectCommand* draws, uint32 drawCount, const void* drawData);
+
+		GeometryArena* m_arena = nullptr;
+		DrawBatcherMode m_mode = DrawBatcherMode::EXA_MULTI_DRAW_INDIRECT;
+
+		uint32 m_maxDraws = 0;
+		size_t m_drawDataStride = 0;
+		uint32 m_maxUniformDraws = 0;
+
+		// Indirect commands, multi draw mode only
+		StreamBuffer* m_indirect = nullptr;
+
+		// Per-draw data, shader storage or uniform buffer
+		StreamBuffer* m_drawData = nullptr;
+
+		// 0, 1, 2, ... read through baseInstance as drawIndex, multi draw mode only
+		GLuint m_drawIndexBuffer = 0;
+
+		uint32 m_frameDraws = 0;
+		uint32 m_frameCalls = 0;
+	};
+}
@@ -0,0 +1,540 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "DynamicAabbTree.h"
+
+#include <cfloat>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		// Moving proxy is enlarged by this many expected displacements
+		const float DISPLACEMENT_MULTIPLIER = 2.0f;
+
+		const uint32 SAH_BINS = 16;
+
+		// Smaller ranges are split in the middle
+		const uint32 MIN_SAH_LEAVES = 4;
+
+		// Subtrees smaller than this are not worth job of their own
+		const uint32 MIN_PARALLEL_LEAVES = 4096;
+
+		Aabb emptyAabb()
+		{
+			return Aabb(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+		}
+	}
+
+	DynamicAabbTree::DynamicAabbTree(float margin)
+		: m_margin(margin)
+	{
+	}
+
+	DynamicAabbTree::Proxy DynamicAabbTree::allocateNode()
+	{
+		if (m_freeList == NULL_PROXY) {
+			m_nodes.emplace_back();
+			return static_cast<Proxy>(m_nodes.size() - 1);
+		}
+
+		const Proxy node = m_freeList;
+		m_freeList = m_nodes[node].parent;
+		m_nodes[node] = Node();
+		return node;
+	}
+
+	void DynamicAabbTree::freeNode(Proxy node)
+	{
+		m_nodes[node] = Node();
+		m_nodes[node].parent = m_freeList;
+		m_freeList = node;
+	}
+
+	Aabb DynamicAabbTree::fatten(const Aabb& aabb) const
+	{
+		return Aabb(aabb.min - glm::vec3(m_margin), aabb.max + glm::vec3(m_margin));
+	}
+
+	DynamicAabbTree::Proxy DynamicAabbTree::createProxy(const Aabb& aabb, uint32 id)
+	{
+		const Proxy proxy = allocateNode();
+		Node& node = m_nodes[proxy];
+		node.aabb = fatten(aabb);
+		node.height = 0;
+		node.id = id;
+
+		insertLeaf(proxy);
+		m_proxyCount++;
+		return proxy;
+	}
+
+	void DynamicAabbTree::destroyProxy(Proxy proxy)
+	{
+		if (proxy < 0 || static_cast<size_t>(proxy) >= m_nodes.size() || !m_nodes[proxy].isLeaf() || m_nodes[proxy].height != 0) {
+			log::warning("Destroying invalid proxy %d of AABB tree", proxy);
+			return;
+		}
+
+		// Refit must not touch freed node
+		if (m_nodes[proxy].dirty) {
+			m_dirty.erase(std::find(m_dirty.begin(), m_dirty.end(), proxy));
+		}
+
+		removeLeaf(proxy);
+		freeNode(proxy);
+		m_proxyCount--;
+	}
+
+	bool DynamicAabbTree::moveProxy(Proxy proxy, const Aabb& aabb, const glm::vec3& displacement)
+	{
+		if (m_nodes[proxy].aabb.contains(aabb)) {
+			return false;
+		}
+
+		Aabb fat = fatten(aabb);
+		const glm::vec3 reach = displacement * DISPLACEMENT_MULTIPLIER;
+		fat.min += glm::min(reach, glm::vec3(0.0f));
+		fat.max += glm::max(reach, glm::vec3(0.0f));
+
+		removeLeaf(proxy);
+		m_nodes[proxy].aabb = fat;
+		insertLeaf(proxy);
+		return true;
+	}
+
+	void DynamicAabbTree::updateProxy(Proxy proxy, const Aabb& aabb)
+	{
+		Node& node = m_nodes[proxy];
+		if (node.aabb.contains(aabb)) {
+			return;
+		}
+
+		node.aabb = fatten(aabb);
+		if (!node.dirty) {
+			node.dirty = true;
+			m_dirty.push_back(proxy);
+		}
+	}
+
+	void DynamicAabbTree::refit()
+	{
+		EXA_PROFILE_FUNCTION();
+
+		for (const Proxy proxy : m_dirty) {
+			m_nodes[proxy].dirty = false;
+
+			Proxy index = m_nodes[proxy].parent;
+			while (index != NULL_PROXY) {
+				Node& node = m_nodes[index];
+				const Aabb aabb = Aabb::merge(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+
+				// Ancestors depend only on their children, unchanged node means unchanged ancestors
+				if (aabb.min == node.aabb.min && aabb.max == node.aabb.max) {
+					break;
+				}
+
+				node.aabb = aabb;
+				index = node.parent;
+			}
+		}
+
+		m_dirty.clear();
+	}
+
+	void DynamicAabbTree::clear()
+	{
+		m_nodes.clear();
+		m_dirty.clear();
+		m_root = NULL_PROXY;
+		m_freeList = NULL_PROXY;
+		m_proxyCount = 0;
+	}
+
+	float DynamicAabbTree::getAreaRatio() const
+	{
+		if (m_root == NULL_PROXY) {
+			return 0.0f;
+		}
+
+		const float rootArea = m_nodes[m_root].aabb.getSurfaceArea();
+		if (rootArea <= 0.0f) {
+			return 0.0f;
+		}
+
+		float totalArea = 0.0f;
+		for (const Node& node : m_nodes) {
+			if (node.height > 0) {
+				totalArea += node.aabb.getSurfaceArea();
+			}
+		}
+
+		return totalArea / rootArea;
+	}
+
+	void DynamicAabbTree::insertLeaf(Proxy leaf)
+	{
+		if (m_root == NULL_PROXY) {
+			m_root = leaf;
+			m_nodes[leaf].parent = NULL_PROXY;
+			return;
+		}
+
+		// Descend towards sibling with lowest cost of new parent plus enlargement of ancestors
+		const Aabb leafAabb = m_nodes[leaf].aabb;
+		Proxy index = m_root;
+		while (!m_nodes[index].isLeaf()) {
+			const Node& node = m_nodes[index];
+
+			const float area = node.aabb.getSurfaceArea();
+			const float combinedArea = Aabb::merge(node.aabb, leafAabb).getSurfaceArea();
+
+			// Cost of making new parent of this node and leaf
+			const float cost = 2.0f * combinedArea;
+
+			// Minimum cost of pushing leaf further down
+			const float inheritanceCost = 2.0f * (combinedArea - area);
+
+			float childCosts[2];
+			const Proxy children[2] = { node.child1, node.child2 };
+			for (uint32 i = 0; i < 2; i++) {
+				const Node& child = m_nodes[children[i]];
+				const float mergedArea = Aabb::merge(leafAabb, child.aabb).getSurfaceArea();
+				childCosts[i] = (child.isLeaf() ? mergedArea : mergedArea - child.aabb.getSurfaceArea()) + inheritanceCost;
+			}
+
+			if (cost < childCosts[0] && cost < childCosts[1]) {
+				break;
+			}
+
+			index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+		}
+
+		const Proxy sibling = index;
+		const Proxy oldParent = m_nodes[sibling].parent;
+		const Proxy newParent = allocateNode();
+
+		Node& parent = m_nodes[newParent];
+		parent.parent = oldParent;
+		parent.aabb = Aabb::merge(leafAabb, m_nodes[sibling].aabb);
+		parent.height = m_nodes[sibling].height + 1;
+		parent.child1 = sibling;
+		parent.child2 = leaf;
+
+		if (oldParent != NULL_PROXY) {
+			if (m_nodes[oldParent].child1 == sibling) {
+				m_nodes[oldParent].child1 = newParent;
+			}
+			else {
+				m_nodes[oldParent].child2 = newParent;
+			}
+		}
+		else {
+			m_root = newParent;
+		}
+
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+
+		index = newParent;
+		while (index != NULL_PROXY) {
+			index = balance(index);
+
+			Node& node = m_nodes[index];
+			node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+			node.aabb = Aabb::merge(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+
+			index = node.parent;
+		}
+	}
+
+	void DynamicAabbTree::removeLeaf(Proxy leaf)
+	{
+		if (leaf == m_root) {
+			m_root = NULL_PROXY;
+			return;
+		}
+
+		const Proxy parent = m_nodes[leaf].parent;
+		const Proxy grandParent = m_nodes[parent].parent;
+		const Proxy sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+		freeNode(parent);
+
+		if (grandParent == NULL_PROXY) {
+			m_root = sibling;
+			m_nodes[sibling].parent = NULL_PROXY;
+			return;
+		}
+
+		if (m_nodes[grandParent].child1 == parent) {
+			m_nodes[grandParent].child1 = sibling;
+		}
+		else {
+			m_nodes[grandParent].child2 = sibling;
+		}
+		m_nodes[sibling].parent = grandParent;
+
+		Proxy index = grandParent;
+		while (index != NULL_PROXY) {
+			index = balance(index);
+
+			Node& node = m_nodes[index];
+			node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+			node.aabb = Aabb::merge(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+
+			index = node.parent;
+		}
+	}
+
+	DynamicAabbTree::Proxy DynamicAabbTree::balance(Proxy indexA)
+	{
+		Node& a = m_nodes[indexA];
+		if (a.isLeaf() || a.height < 2) {
+			return indexA;
+		}
+
+		const Proxy indexB = a.child1;
+		const Proxy indexC = a.child2;
+		Node& b = m_nodes[indexB];
+		Node& c = m_nodes[indexC];
+
+		const int32 difference = c.height - b.height;
+
+		// Rotates higher child up, its higher child stays under it and lower one moves under A
+		if (difference > 1 || difference < -1) {
+			const Proxy indexUp = difference > 1 ? indexC : indexB;
+			const Proxy indexStay = difference > 1 ? indexB : indexC;
+			Node& up = m_nodes[indexUp];
+			Node& stay = m_nodes[indexStay];
+
+			const Proxy indexF = up.child1;
+			const Proxy indexG = up.child2;
+			Node& f = m_nodes[indexF];
+			Node& g = m_nodes[indexG];
+
+			up.child1 = indexA;
+			up.parent = a.parent;
+			a.parent = indexUp;
+
+			if (up.parent != NULL_PROXY) {
+				if (m_nodes[up.parent].child1 == indexA) {
+					m_nodes[up.parent].child1 = indexUp;
+				}
+				else {
+					m_nodes[up.parent].child2 = indexUp;
+				}
+			}
+			else {
+				m_root = indexUp;
+			}
+
+			const bool keepF = f.height > g.height;
+			const Proxy indexKeep = keepF ? indexF : indexG;
+			const Proxy indexMove = keepF ? indexG : indexF;
+			Node& keep = m_nodes[indexKeep];
+			Node& move = m_nodes[indexMove];
+
+			up.child2 = indexKeep;
+			if (difference > 1) {
+				a.child2 = indexMove;
+			}
+			else {
+				a.child1 = indexMove;
+			}
+			move.parent = indexA;
+
+			a.aabb = Aabb::merge(stay.aabb, move.aabb);
+			up.aabb = Aabb::merge(a.aabb, keep.aabb);
+			a.height = 1 + std::max(stay.height, move.height);
+			up.height = 1 + std::max(a.height, keep.height);
+
+			return indexUp;
+		}
+
+		return indexA;
+	}
+
+	uint32 DynamicAabbTree::split(uint32 begin, uint32 end)
+	{
+		const uint32 middle = begin + (end - begin) / 2;
+		if (end - begin < MIN_SAH_LEAVES) {
+			return middle;
+		}
+
+		Aabb centroidBounds = emptyAabb();
+		for (uint32 i = begin; i < end; i++) {
+			centroidBounds.min = glm::min(centroidBounds.min, m_buildItems[i].centroid);
+			centroidBounds.max = glm::max(centroidBounds.max, m_buildItems[i].centroid);
+		}
+
+		const glm::vec3 size = centroidBounds.max - centroidBounds.min;
+		const int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+		if (size[axis] <= 0.0f) {
+			return middle;
+		}
+
+		Aabb binBounds[SAH_BINS];
+		uint32 binCounts[SAH_BINS] = {};
+		for (Aabb& bounds : binBounds) {
+			bounds = emptyAabb();
+		}
+
+		const float scale = SAH_BINS / size[axis];
+		auto binOf = [&](const BuildItem& item) {
+			const uint32 bin = static_cast<uint32>((item.centroid[axis] - centroidBounds.min[axis]) * scale);
+			return std::min(bin, SAH_BINS - 1);
+		};
+
+		for (uint32 i = begin; i < end; i++) {
+			const uint32 bin = binOf(m_buildItems[i]);
+			binBounds[bin] = Aabb::merge(binBounds[bin], m_nodes[m_buildItems[i].node].aabb);
+			binCounts[bin]++;
+		}
+
+		// Cost of split after bin i: area of left side * its leaves + area of right side * its leaves
+		float leftCosts[SAH_BINS - 1];
+		Aabb bounds = emptyAabb();
+		uint32 count = 0;
+		for (uint32 i = 0; i < SAH_BINS - 1; i++) {
+			bounds = Aabb::merge(bounds, binBounds[i]);
+			count += binCounts[i];
+			leftCosts[i] = count > 0 ? bounds.getSurfaceArea() * count : 0.0f;
+		}
+
+		float bestCost = FLT_MAX;
+		uint32 bestBin = 0;
+		bounds = emptyAabb();
+		count = 0;
+		for (uint32 i = SAH_BINS - 1; i > 0; i--) {
+			bounds = Aabb::merge(bounds, binBounds[i]);
+			count += binCounts[i];
+			const float cost = leftCosts[i - 1] + (count > 0 ? bounds.getSurfaceArea() * count : 0.0f);
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestBin = i;
+			}
+		}
+
+		BuildItem* first = &m_buildItems[begin];
+		BuildItem* last = first + (end - begin);
+		const BuildItem* pivot = std::partition(first, last, [&](const BuildItem& item) { return binOf(item) < bestBin; });
+
+		const uint32 result = begin + static_cast<uint32>(pivot - first);
+		return (result == begin || result == end) ? middle : result;
+	}
+
+	DynamicAabbTree::Proxy DynamicAabbTree::build(uint32 begin, uint32 end, uint32 innerBase, Proxy parent, uint32 depth, uint32 maxDepth, std::vector<BuildTask>* tasks)
+	{
+		const uint32 count = end - begin;
+		if (count == 1) {
+			const Proxy leaf = m_buildItems[begin].node;
+			m_nodes[leaf].parent = parent;
+			return leaf;
+		}
+
+		// Every range of n leaves uses n - 1 inner nodes, so ranges know their nodes before they are built
+		const Proxy index = m_buildInner[innerBase];
+
+		if (tasks != nullptr && (depth >= maxDepth || count < MIN_PARALLEL_LEAVES)) {
+			BuildTask task;
+			task.begin = begin;
+			task.end = end;
+			task.innerBase = innerBase;
+			task.parent = parent;
+			tasks->push_back(task);
+			return index;
+		}
+
+		const uint32 middle = split(begin, end);
+
+		Node& node = m_nodes[index];
+		node.parent = parent;
+		node.child1 = build(begin, middle, innerBase + 1, index, depth + 1, maxDepth, tasks);
+		node.child2 = build(middle, end, innerBase + (middle - begin), index, depth + 1, maxDepth, tasks);
+
+		// Children of deferred ranges are finished after jobs
+		if (tasks == nullptr) {
+			node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+			node.aabb = Aabb::merge(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+		}
+
+		return index;
+	}
+
+	void DynamicAabbTree::rebuild(JobSystem* jobSystem)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		refit();
+
+		m_buildItems.clear();
+		m_buildItems.reserve(m_proxyCount);
+		for (Proxy index = 0; index < static_cast<Proxy>(m_nodes.size()); index++) {
+			Node& node = m_nodes[index];
+			if (node.height == 0) {
+				BuildItem item;
+				item.node = index;
+				item.centroid = node.aabb.getCenter();
+				m_buildItems.push_back(item);
+			}
+			else if (node.height > 0) {
+				freeNode(index);
+			}
+		}
+
+		const uint32 count = static_cast<uint32>(m_buildItems.size());
+		if (count == 0) {
+			m_root = NULL_PROXY;
+			return;
+		}
+
+		m_buildInner.resize(count - 1);
+		for (Proxy& inner : m_buildInner) {
+			inner = allocateNode();
+		}
+
+		if (jobSystem == nullptr || jobSystem->getNumThreads() == 1 || count < 2 * MIN_PARALLEL_LEAVES) {
+			m_root = build(0, count, 0, NULL_PROXY, 0, 0, nullptr);
+			return;
+		}
+
+		// Top of tree is split on calling thread into about four ranges per thread
+		uint32 maxDepth = 2;
+		while ((1u << maxDepth) < jobSystem->getNumThreads() * 4) {
+			maxDepth++;
+		}
+
+		std::vector<BuildTask> tasks;
+		m_root = build(0, count, 0, NULL_PROXY, 0, maxDepth, &tasks);
+
+		jobSystem->parallelFor(static_cast<uint32>(tasks.size()), 1, [this, &tasks](uint32 begin, uint32 end) {
+			for (uint32 i = begin; i < end; i++) {
+				const BuildTask& task = tasks[i];
+				build(task.begin, task.end, task.innerBase, task.parent, 0, 0, nullptr);
+			}
+		});
+
+		// Inner nodes built before their children, finished in reverse order
+		std::vector<Proxy> top;
+		top.push_back(m_root);
+		for (size_t i = 0; i < top.size(); i++) {
+			const Node& node = m_nodes[top[i]];
+			if (node.height < 0) {
+				top.push_back(node.child1);
+				top.push_back(node.child2);
+			}
+		}
+
+		for (size_t i = top.size(); i-- > 0;) {
+			Node& node = m_nodes[top[i]];
+			if (node.height < 0) {
+				node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+				node.aabb = Aabb::merge(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+			}
+		}
+	}
+}
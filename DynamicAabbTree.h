@@ -0,0 +1,383 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "exa.h"
+#include "FrustumCuller.h"
+
+namespace exa
+{
+	class JobSystem;
+
+	struct Aabb
+	{
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+
+		Aabb() = default;
+
+		Aabb(const glm::vec3& min, const glm::vec3& max)
+			: min(min)
+			, max(max)
+		{
+		}
+
+		glm::vec3 getCenter() const {
+			return (min + max) * 0.5f;
+		}
+
+		glm::vec3 getExtent() const {
+			return (max - min) * 0.5f;
+		}
+
+		float getSurfaceArea() const {
+			const glm::vec3 size = max - min;
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+
+		bool contains(const Aabb& other) const {
+			return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::lessThanEqual(other.max, max));
+		}
+
+		bool overlaps(const Aabb& other) const {
+			return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::lessThanEqual(other.min, max));
+		}
+
+		bool overlapsSphere(const glm::vec3& center, float radius) const {
+			const glm::vec3 offset = glm::clamp(center, min, max) - center;
+			return glm::dot(offset, offset) <= radius * radius;
+		}
+
+		// Slab test, inverseDirection is 1 / direction and must be finite (0 * inf would give NaN), see raycast
+		bool intersectsRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& distance) const {
+			const glm::vec3 t0 = (min - origin) * inverseDirection;
+			const glm::vec3 t1 = (max - origin) * inverseDirection;
+			const glm::vec3 entries = glm::min(t0, t1);
+			const glm::vec3 exits = glm::max(t0, t1);
+			const float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+			const float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+			distance = enter;
+			return enter <= exit;
+		}
+
+		static Aabb merge(const Aabb& a, const Aabb& b) {
+			return Aabb(glm::min(a.min, b.min), glm::max(a.max, b.max));
+		}
+	};
+
+	// Bounding volume hierarchy of proxies (objects given by AABB and id) for culling and picking.
+	// Proxies are inserted incrementally at place of lowest surface area cost and tree is kept balanced
+	// by rotations, so adding, removing and moving cost O(log n). Leaves store AABB enlarged by margin,
+	// objects moving inside of it don't touch the tree.
+	//
+	// Moving objects can be handled in two ways:
+	// - moveProxy reinserts proxy once it leaves its enlarged AABB, tree keeps its quality
+	// - updateProxy only stores new AABB and refit recomputes changed ancestors, cheaper for many
+	//   objects moving every frame, but quality drops over time; rebuild when getAreaRatio grows
+	//
+	// rebuild builds whole tree again top-down with binned SAH, subtrees are built in parallel.
+	// Proxy handles stay valid over rebuilds.
+	//
+	// Queries call callback(id) for every proxy whose enlarged AABB passes, callback returns false to stop:
+	//
+	// tree.queryFrustum(frustum, [&](uint32 id) { visible.push_back(id); return true; });
+	class DynamicAabbTree
+	{
+	public:
+		using Proxy = int32;
+
+		static const Proxy NULL_PROXY = -1;
+
+		// Query traversal entries kept on stack, deeper trees continue on heap
+		static const uint32 MAX_STACK = 256;
+
+		// @param margin Enlargement of leaf AABBs in world units
+		explicit DynamicAabbTree(float margin = 0.1f);
+
+		Proxy createProxy(const Aabb& aabb, uint32 id);
+
+		void destroyProxy(Proxy proxy);
+
+		// @param displacement Expected movement until next call, enlarges AABB in that direction
+		// @return True if proxy was reinserted
+		bool moveProxy(Proxy proxy, const Aabb& aabb, const glm::vec3& displacement = glm::vec3(0.0f));
+
+		// Stores AABB of leaf without changing tree structure, ancestors are updated by refit
+		void updateProxy(Proxy proxy, const Aabb& aabb);
+
+		// Refits ancestors of proxies changed by updateProxy, stops at first ancestor that doesn't change
+		void refit();
+
+		// Rebuilds tree with binned SAH
+		// @param jobSystem nullptr builds on calling thread only
+		void rebuild(JobSystem* jobSystem = nullptr);
+
+		void clear();
+
+		uint32 getId(Proxy proxy) const {
+			return m_nodes[proxy].id;
+		}
+
+		// Enlarged AABB stored in tree
+		const Aabb& getFatAabb(Proxy proxy) const {
+			return m_nodes[proxy].aabb;
+		}
+
+		uint32 getProxyCount() const {
+			return m_proxyCount;
+		}
+
+		int32 getHeight() const {
+			return m_root == NULL_PROXY ? 0 : m_nodes[m_root].height;
+		}
+
+		// Sum of surface areas of inner nodes relative to root, grows as tree quality drops
+		float getAreaRatio() const;
+
+		template <typename Callback>
+		void queryAabb(const Aabb& aabb, Callback&& callback) const
+		{
+			query([&aabb](const Aabb& bounds) { return bounds.overlaps(aabb); }, callback);
+		}
+
+		template <typename Callback>
+		void querySphere(const glm::vec3& center, float radius, Callback&& callback) const
+		{
+			query([&center, radius](const Aabb& bounds) { return bounds.overlapsSphere(center, radius); }, callback);
+		}
+
+		// Subtrees fully inside frustum are reported without further tests
+		template <typename Callback>
+		void queryFrustum(const Frustum& frustum, Callback&& callback) const;
+
+		// Callback is called for proxies hit by ray in no particular order as callback(id, maxDistance) and
+		// returns new max distance: distance of exact hit clips ray, maxDistance keeps it, 0 stops query
+		template <typename Callback>
+		void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback&& callback) const;
+
+	private:
+		struct Node
+		{
+			Aabb aabb;
+			Proxy parent = NULL_PROXY;
+			Proxy child1 = NULL_PROXY;
+			Proxy child2 = NULL_PROXY;
+			// Leaf is 0, free node -1
+			int32 height = -1;
+			uint32 id = 0;
+			// Waits for refit
+			bool dirty = false;
+
+			bool isLeaf() const {
+				return child1 == NULL_PROXY;
+			}
+		};
+
+		struct BuildItem
+		{
+			Proxy node;
+			glm::vec3 centroid;
+		};
+
+		// Range of leaves built by one job
+		struct BuildTask
+		{
+			uint32 begin;
+			uint32 end;
+			uint32 innerBase;
+			Proxy parent;
+		};
+
+		Proxy allocateNode();
+		void freeNode(Proxy node);
+
+		Aabb fatten(const Aabb& aabb) const;
+
+		void insertLeaf(Proxy leaf);
+		void removeLeaf(Proxy leaf);
+		Proxy balance(Proxy node);
+
+		// Builds leaves [begin, end) of m_buildItems using inner nodes m_buildInner[innerBase, innerBase + end - begin - 1).
+		// Ranges at depth of maxDepth are stored in tasks instead of being built
+		Proxy build(uint32 begin, uint32 end, uint32 innerBase, Proxy parent, uint32 depth, uint32 maxDepth, std::vector<BuildTask>* tasks);
+		uint32 split(uint32 begin, uint32 end);
+
+		template <typename Test, typename Callback>
+		void query(const Test& test, Callback& callback) const;
+
+		// Traversal stack of queries, fixed array while it fits and heap beyond, so no subtree is ever skipped
+		template <typename T>
+		class QueryStack
+		{
+		public:
+			QueryStack() = default;
+			QueryStack(const QueryStack&) = delete;
+			QueryStack& operator=(const QueryStack&) = delete;
+
+			void push(T value) {
+				if (m_size == m_capacity) {
+					grow();
+				}
+				m_data[m_size++] = value;
+			}
+
+			T pop() {
+				return m_data[--m_size];
+			}
+
+			bool empty() const {
+				return m_size == 0;
+			}
+
+		private:
+			void grow() {
+				m_capacity *= 2;
+				m_heap.resize(m_capacity);
+				if (m_data == m_local) {
+					std::copy(m_local, m_local + m_size, m_heap.begin());
+				}
+				m_data = m_heap.data();
+			}
+
+			T m_local[MAX_STACK];
+			std::vector<T> m_heap;
+			T* m_data = m_local;
+			uint32 m_size = 0;
+			uint32 m_capacity = MAX_STACK;
+		};
+
+		std::vector<Node> m_nodes;
+		Proxy m_root = NULL_PROXY;
+		Proxy m_freeList = NULL_PROXY;
+		uint32 m_proxyCount = 0;
+
+		float m_margin = 0.0f;
+
+		std::vector<Proxy> m_dirty;
+
+		std::vector<BuildItem> m_buildItems;
+		std::vector<Proxy> m_buildInner;
+	};
+
+	template <typename Test, typename Callback>
+	void DynamicAabbTree::query(const Test& test, Callback& callback) const
+	{
+		if (m_root == NULL_PROXY) {
+			return;
+		}
+
+		QueryStack<Proxy> stack;
+		stack.push(m_root);
+
+		while (!stack.empty()) {
+			const Node& node = m_nodes[stack.pop()];
+			if (!test(node.aabb)) {
+				continue;
+			}
+
+			if (node.isLeaf()) {
+				if (!callback(node.id)) {
+					return;
+				}
+			}
+			else {
+				stack.push(node.child1);
+				stack.push(node.child2);
+			}
+		}
+	}
+
+	template <typename Callback>
+	void DynamicAabbTree::queryFrustum(const Frustum& frustum, Callback&& callback) const
+	{
+		if (m_root == NULL_PROXY) {
+			return;
+		}
+
+		// Lowest bit marks subtree inside of all planes
+		QueryStack<uint32> stack;
+		stack.push(static_cast<uint32>(m_root) << 1);
+
+		while (!stack.empty()) {
+			const uint32 entry = stack.pop();
+			const Node& node = m_nodes[entry >> 1];
+			bool inside = (entry & 1) != 0;
+
+			if (!inside) {
+				const glm::vec3 center = node.aabb.getCenter();
+				const glm::vec3 extent = node.aabb.getExtent();
+
+				bool outside = false;
+				inside = true;
+				for (const glm::vec4& plane : frustum.planes) {
+					const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+					const float reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+					if (distance + reach < 0.0f) {
+						outside = true;
+						break;
+					}
+					inside &= distance - reach >= 0.0f;
+				}
+
+				if (outside) {
+					continue;
+				}
+			}
+
+			if (node.isLeaf()) {
+				if (!callback(node.id)) {
+					return;
+				}
+			}
+			else {
+				const uint32 flag = inside ? 1 : 0;
+				stack.push((static_cast<uint32>(node.child1) << 1) | flag);
+				stack.push((static_cast<uint32>(node.child2) << 1) | flag);
+			}
+		}
+	}
+
+	template <typename Callback>
+	void DynamicAabbTree::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback&& callback) const
+	{
+		if (m_root == NULL_PROXY) {
+			return;
+		}
+
+		// Zero components would give infinity and NaN for origin on slab plane, huge finite value keeps test exact
+		const float minDirection = 1e-20f;
+		glm::vec3 inverseDirection;
+		for (int axis = 0; axis < 3; axis++) {
+			const float magnitude = std::max(std::abs(direction[axis]), minDirection);
+			inverseDirection[axis] = std::copysign(1.0f / magnitude, direction[axis]);
+		}
+
+		QueryStack<Proxy> stack;
+		stack.push(m_root);
+
+		while (!stack.empty()) {
+			const Node& node = m_nodes[stack.pop()];
+
+			float distance = 0.0f;
+			if (!node.aabb.intersectsRay(origin, inverseDirection, maxDistance, distance)) {
+				continue;
+			}
+
+			if (node.isLeaf()) {
+				maxDistance = callback(node.id, maxDistance);
+				if (maxDistance <= 0.0f) {
+					return;
+				}
+			}
+			else {
+				stack.push(node.child1);
+				stack.push(node.child2);
+			}
+		}
+	}
+}
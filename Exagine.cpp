@@ -5,24 +5,61 @@
 
 #include <iostream>
 
+#include <glm/gtc/packing.hpp>
+
 #include "Util.h"
 #include "Shader.h"
 #include "Texture.h"
 #include "VertexBuffer.h"
+#include "IndexBuffer.h"
 #include "VertexArray.h"
 #include "Log.h"
 #include "Window.h"
 #include "Image.h"
+#include "RenderThread.h"
+#include "Profiler.h"
+#include "ShaderReloader.h"
 
 namespace exa
 {
+	Vertex Vertex::pack(const vec3f& position, const vec2f& texCoords)
+	{
+		const glm::u16vec4 packedPosition = glm::packHalf(glm::vec4(position.x, position.y, position.z, 1.0f));
+		const glm::u16vec2 packedTexCoords = glm::packUnorm<uint16>(glm::vec2(texCoords.x, texCoords.y));
+
+		Vertex vertex;
+		for (int i = 0; i < 4; i++) {
+			vertex.Position[i] = packedPosition[i];
+		}
+		vertex.TexCoords[0] = packedTexCoords.x;
+		vertex.TexCoords[1] = packedTexCoords.y;
+		return vertex;
+	}
+
 	bool Exagine::close()
 	{
+		// Replay queued frames and take OpenGL context back before deleting GL objects
+		SafeDelete(m_renderThread);
+
+		PROFILER().releaseGpuResources();
+
+		SafeDelete(m_shaderReloader);
+
+#if EXA_GL_STATE_CACHE
+		log::debug("GL state cache: %llu calls issued, %llu skipped",
+			static_cast<unsigned long long>(GLSTATE().getStats().issued),
+			static_cast<unsigned long long>(GLSTATE().getStats().skipped));
+#endif
+
 		SafeDelete(m_VAO);
 		SafeDelete(m_VBO);
+		SafeDelete(m_IBO);
 		SafeDelete(m_mainShader);
 		SafeDelete(m_texture);
 
+		// Join worker threads before subsystems they may use are freed
+		SafeDelete(m_jobSystem);
+
 		// Delete window and quit SDL
 		// @note Must be called last
 		SafeDelete(m_Window);
@@ -37,46 +74,206 @@ namespace exa
 	void Exagine::handleWindowEvents()
 	{
 		m_Window->pollEvents();
+
+		if (m_shaderReloader != nullptr) {
+			m_shaderReloader->pollChanges();
+		}
+
+		m_framePacer.markInputSampled(m_currentFrame);
 	}
 
 	void Exagine::drawScreen()
 	{
-		m_mainShader->bind();
-
-		m_mainShader->bindUniform("color", glm::vec4(1, 0, 1, 1));
+		m_commands->bindShader(m_mainShader);
 
-		m_mainShader->activateTexture2D(0, m_texture->get(), "diffuseTexture");
+		m_commands->setUniform(m_mainShader, "color", glm::vec4(1, 0, 1, 1));
 
-		m_VAO->bind();
+		m_commands->activateTexture(m_mainShader, GL_TEXTURE_2D, 0, m_texture->get(), "diffuseTexture");
 
-		exaglDrawArrays(GL_TRIANGLES, 0, m_vertices.size());
+		m_commands->bindVertexArray(m_VAO);
 
-		exaglBindVertexArray(0);
+		m_commands->drawElements(GL_TRIANGLES, m_IBO->getCount(), m_IBO->getType(), 0);
 
-		m_mainShader->unbind();
+		// Program and vertex array are left bound, so next frame binds are dropped by state cache
 	}
 
 	void Exagine::beforeDraw()
 	{
+		// Waits for free buffer if render thread is more than two frames behind
+		m_commands = (m_renderThread != nullptr) ? &m_renderThread->beginFrame() : &m_commandBuffer;
+		m_commands->reset();
+
+		// Recompiled programs are swapped in before any draw of the frame
+		if (m_shaderReloader != nullptr) {
+			m_commands->callback(&ShaderReloader::updateCallback, m_shaderReloader);
+		}
+
 		// Clear screen
-		exaglClear(GL_COLOR_BUFFER_BIT);
+		m_commands->clear(GL_COLOR_BUFFER_BIT);
 	}
 
 	void Exagine::afterDraw()
 	{
+		m_commands->callback(&Exagine::presentCallback, this);
+
+		FrameSnapshot snapshot;
+		snapshot.frameIndex = m_currentFrame;
+		snapshot.interpolationAlpha = m_timestep.getAlpha();
+		snapshot.simulationTime = m_timestep.getTime();
+		snapshot.width = m_Window->getWidth();
+		snapshot.height = m_Window->getHeight();
+		snapshot.swapInterval = m_framePacer.getSwapInterval();
+		snapshot.lowLatency = m_framePacer.isLowLatency();
+
+		if (m_renderThread != nullptr) {
+			m_renderThread->submitFrame(snapshot);
+		}
+		else {
+			m_commands->setSnapshot(snapshot);
+			m_commands->execute();
+		}
+
+		m_commands = nullptr;
+	}
+
+	void Exagine::presentCallback(void* userData, const FrameSnapshot& snapshot)
+	{
+		static_cast<Exagine*>(userData)->present(snapshot);
+	}
+
+	void Exagine::present(const FrameSnapshot& snapshot)
+	{
+		EXA_PROFILE_SCOPE("present");
+
+		// Present settings come from snapshot, game thread may already change them for later frames
+		if (snapshot.swapInterval != m_presentedSwapInterval) {
+			m_Window->setSwapInterval(snapshot.swapInterval);
+			m_presentedSwapInterval = snapshot.swapInterval;
+		}
+
+		m_framePacer.beginSwap(snapshot.frameIndex);
+
+		// Submit is measured apart from swap, which also waits for retrace in vsync modes
+		exaglFlush();
+		m_framePacer.markSubmitted(snapshot.frameIndex);
+
 		// Update window
 		m_Window->swapWindow();
+
+		// Don't let driver queue frames, so next frame samples input right before it is presented
+		if (snapshot.lowLatency) {
+			exaglFinish();
+		}
+
+		m_framePacer.endSwap(snapshot.frameIndex);
 	}
 
 	void Exagine::frame()
 	{
-		handleWindowEvents();
+		m_jobSystem->run(m_frameGraph);
+	}
+
+	void Exagine::buildFrameGraph()
+	{
+		m_frameGraph.clear();
+
+		// Limiter sleeps here, before input is sampled
+		TaskGraph::TaskId paceTask = m_frameGraph.addTask("pace", [this]() {
+			m_currentFrame = m_framePacer.beginFrame();
+			EXA_PROFILE_FRAME(m_currentFrame);
+		}, TaskAffinity::EXA_MAIN_THREAD);
+
+		m_eventsTask = m_frameGraph.addTask("events", [this]() {
+			handleWindowEvents();
+		}, TaskAffinity::EXA_MAIN_THREAD);
+
+		// Runs bounded number of fixed steps, render uses getInterpolationAlpha() to blend states
+		m_simulateTask = m_frameGraph.addTask("simulate", [this]() {
+			uint32 steps = m_timestep.advance();
+			for (uint32 i = 0; i < steps; i++) {
+				fixedUpdate(m_timestep.getStep());
+			}
+		});
+
+		TaskGraph::TaskId beforeDrawTask = m_frameGraph.addTask("beforeDraw", [this]() {
+			beforeDraw();
+		}, TaskAffinity::EXA_MAIN_THREAD);
+
+		m_drawScreenTask = m_frameGraph.addTask("drawScreen", [this]() {
+			drawScreen();
+		}, TaskAffinity::EXA_MAIN_THREAD);
+
+		TaskGraph::TaskId afterDrawTask = m_frameGraph.addTask("afterDraw", [this]() {
+			afterDraw();
+		}, TaskAffinity::EXA_MAIN_THREAD);
+
+		m_frameGraph.addDependency(m_eventsTask, paceTask);
+		m_frameGraph.addDependency(m_simulateTask, m_eventsTask);
+		m_frameGraph.addDependency(beforeDrawTask, m_eventsTask);
+		m_frameGraph.addDependency(m_drawScreenTask, m_simulateTask);
+		m_frameGraph.addDependency(m_drawScreenTask, beforeDrawTask);
+		m_frameGraph.addDependency(afterDrawTask, m_drawScreenTask);
+	}
+
+	TaskGraph::TaskId Exagine::addFrameTask(const char* name, Job job)
+	{
+		TaskGraph::TaskId task = m_frameGraph.addTask(name, std::move(job));
+		m_frameGraph.addDependency(task, m_simulateTask);
+		m_frameGraph.addDependency(m_drawScreenTask, task);
+		return task;
+	}
+
+	void Exagine::addFrameTaskDependency(TaskGraph::TaskId task, TaskGraph::TaskId dependency)
+	{
+		m_frameGraph.addDependency(task, dependency);
+	}
+
+	void Exagine::setPresentMode(PresentMode mode)
+	{
+		m_framePacer.setPresentMode(mode);
+
+		if (m_Window == nullptr) {
+			// Applied in init
+			return;
+		}
+
+		// Context is current on render thread, interval is applied from snapshot before next swap
+		if (m_renderThread == nullptr) {
+			m_presentedSwapInterval = m_framePacer.getSwapInterval();
+			m_Window->setSwapInterval(m_presentedSwapInterval);
+		}
+
+		// Low latency mode predicts retrace from refresh rate
+		if (mode != PresentMode::EXA_PRESENT_LIMITED && mode != PresentMode::EXA_PRESENT_UNCAPPED) {
+			m_framePacer.setTargetFrameRate(m_Window->getRefreshRate());
+		}
+	}
+
+	void Exagine::setHeadless(int32 width, int32 height)
+	{
+		if (m_statusCode != StatusCode::EXA_NONE) {
+			log::error("Headless mode must be set before engine is started");
+			return;
+		}
 
-		beforeDraw();
+		m_headless = true;
+		m_headlessWidth = width;
+		m_headlessHeight = height;
 
-		drawScreen();
+		// Nothing to synchronize with, measure raw throughput
+		m_framePacer.setPresentMode(PresentMode::EXA_PRESENT_UNCAPPED);
+	}
+
+	void Exagine::fixedUpdate(double dt)
+	{
+		for (auto& callback : m_fixedUpdates) {
+			callback(dt);
+		}
+	}
 
-		afterDraw();
+	void Exagine::addFixedUpdate(std::function<void(double)> callback)
+	{
+		m_fixedUpdates.push_back(std::move(callback));
 	}
 
 	bool Exagine::init()
@@ -88,6 +285,8 @@ namespace exa
 		// Initialize logger
 		LOGGER();
 
+		EXA_PROFILE_THREAD("Main");
+
 		if (!setStatusCode(StatusCode::EXA_STARTING)) {
 			return false;
 		}
@@ -96,17 +295,30 @@ namespace exa
 
 		m_Window = new Window();
 
+		if (m_headless) {
+			m_Window->setHeadless(m_headlessWidth, m_headlessHeight);
+		}
+
 		if (!m_Window->init()) {
 			return false;
 		}
 
-		m_vertices.push_back({ vec3f{ -1.0f, -1.0f, 0.0f }, vec2f{ 0.0f, 0.0f } }); // Bottom Left
-		m_vertices.push_back({ vec3f{ -1.0f, 1.0f, 0.0f },  vec2f{ 0.0f, 1.0f } });	// Top Left 
-		m_vertices.push_back({ vec3f{ 1.0f, -1.0f, 0.0f },  vec2f{ 1.0f, 0.0f } });	// Bottom Right
+		setPresentMode(m_framePacer.getPresentMode());
+
+		m_jobSystem = exanew JobSystem();
+
+		if (!m_jobSystem->init()) {
+			return false;
+		}
+
+		buildFrameGraph();
+
+		m_vertices.push_back(Vertex::pack({ -1.0f, -1.0f, 0.0f }, { 0.0f, 0.0f })); // Bottom Left
+		m_vertices.push_back(Vertex::pack({ -1.0f, 1.0f, 0.0f },  { 0.0f, 1.0f }));	// Top Left 
+		m_vertices.push_back(Vertex::pack({ 1.0f, -1.0f, 0.0f },  { 1.0f, 0.0f }));	// Bottom Right
+		m_vertices.push_back(Vertex::pack({ 1.0f, 1.0f, 0.0f },   { 1.0f, 1.0f })); // Top Right
 
-		m_vertices.push_back({ vec3f{ 1.0f, -1.0f, 0.0f },  vec2f{ 1.0f, 0.0f } });	// Bottom Right
-		m_vertices.push_back({ vec3f{ -1.0f, 1.0f, 0.0f },  vec2f{ 0.0f, 1.0f } });	// Top Left 
-		m_vertices.push_back({ vec3f{ 1.0f, 1.0f, 0.0f },   vec2f{ 1.0f, 1.0f } }); // Top Right
+		m_indices = { 0, 1, 2, 2, 1, 3 };
 
 		m_mainShader = exanew Shader();
 		m_mainShader->addShader("main.vert");
@@ -116,13 +328,14 @@ namespace exa
 
 		m_VAO = exanew VertexArray();
 
-		m_VAO->bind();
-
 		m_VBO = exanew VertexBuffer();
 		m_VBO->setData(m_vertices.data(), m_vertices.size() * sizeof(Vertex), GL_STATIC_DRAW);
 
-		m_mainShader->attribute<Vertex, vec3f>("vPosition", &Vertex::Position);
-		m_mainShader->attribute<Vertex, vec2f>("texCoord", &Vertex::TexCoords);
+		m_VAO->setLayout<QuadVertexLayout>(*m_VBO, m_mainShader->getReflection());
+
+		// Recorded in VAO
+		m_IBO = exanew IndexBuffer();
+		m_IBO->setData(m_indices, GL_STATIC_DRAW);
 
 		m_VBO->unbind(); // Unbind VBO
 
@@ -130,9 +343,23 @@ namespace exa
 
 		m_texture = exanew Texture("smiley.png");
 
+		if (m_shaderHotReload) {
+			m_shaderReloader = exanew ShaderReloader();
+			m_shaderReloader->watch(m_mainShader);
+		}
+
 		// Set OpenGL clear color
 		exaglClearColor(0.5, 0.5, 0.5, 1);
 
+		// @note Must be last, OpenGL context is owned by render thread after it
+		if (m_useRenderThread) {
+			m_renderThread = exanew RenderThread();
+			if (!m_renderThread->start(m_Window)) {
+				log::warning("Falling back to rendering on main thread");
+				SafeDelete(m_renderThread);
+			}
+		}
+
 		log::debug("Initialized all engine subsystems");
 
 		return true;
@@ -144,9 +371,17 @@ namespace exa
 			return false;
 		}
 
+		// Don't count initialization time as simulation time
+		m_timestep.reset();
+
 		while (!m_quit)
 		{
 			frame();
+
+			if (m_maxFrames != 0 && m_framePacer.getFrameIndex() >= m_maxFrames) {
+				log::message("Rendered %llu frames, stopping", static_cast<unsigned long long>(m_maxFrames));
+				m_quit = true;
+			}
 		}
 
 		return true;
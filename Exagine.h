@@ -4,17 +4,26 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 #include "exa.h"
+#include "JobSystem.h"
+#include "FixedTimestep.h"
+#include "FramePacer.h"
+#include "RenderCommandBuffer.h"
+#include "VertexLayout.h"
 
 namespace exa
 {
 	class Shader;
 	class Texture;
 	class VertexBuffer;
+	class IndexBuffer;
 	class VertexArray;
 	class Window;
+	class RenderThread;
+	class ShaderReloader;
 
 	// Engine status
 	enum class StatusCode : std::int8_t 
@@ -36,11 +45,23 @@ namespace exa
 		EXA_TOTAL_ITEMS
 	};
 
+	EXA_VERTEX_ATTRIBUTE(PositionAttribute, "vPosition")
+	EXA_VERTEX_ATTRIBUTE(TexCoordAttribute, "texCoord")
+
+	// Half float position and 16 bit normalized texture coordinates, 12 bytes instead of 20
 	struct Vertex {
-		vec3f Position;
-		vec2f TexCoords;
+		uint16 Position[4];
+		uint16 TexCoords[2];
+
+		static Vertex pack(const vec3f& position, const vec2f& texCoords);
 	};
 
+	using QuadVertexLayout = VertexLayout<
+		VertexAttribute<PositionAttribute, half4>,
+		VertexAttribute<TexCoordAttribute, unorm16x2>>;
+
+	static_assert(sizeof(Vertex) == QuadVertexLayout::stride(), "Vertex doesn't match its layout");
+
 	class Exagine
 	{
 	public:
@@ -61,21 +82,93 @@ namespace exa
 		bool loop();
 
 		// Poll events, call subsystems.
+		// @note Executes frame task graph, see buildFrameGraph
 		void frame();
 
+		// Adds CPU task executed every frame on any thread after simulation step and before drawScreen.
+		// Use it for work that doesn't touch OpenGL (culling, animation, asset decoding, e.t.c.)
+		TaskGraph::TaskId addFrameTask(const char* name, Job job);
+
+		// Makes frame task wait for another frame task
+		void addFrameTaskDependency(TaskGraph::TaskId task, TaskGraph::TaskId dependency);
+
+		JobSystem* getJobSystem() const {
+			return m_jobSystem;
+		}
+
+		// Advances simulation by one fixed step, called zero or more times per frame
+		void fixedUpdate(double dt);
+
+		// Registers callback called on every fixed simulation step with step duration in seconds
+		void addFixedUpdate(std::function<void(double)> callback);
+
+		FixedTimestep& getTimestep() {
+			return m_timestep;
+		}
+
+		// Blend factor between two last simulation states, use it to interpolate in drawScreen
+		double getInterpolationAlpha() const {
+			return m_timestep.getAlpha();
+		}
+
+		// Changes swap interval and limiter, may be called at any time on main thread
+		void setPresentMode(PresentMode mode);
+
+		// Present mode, limiter, low latency mode and per-frame timings
+		FramePacer& getFramePacer() {
+			return m_framePacer;
+		}
+
 		// Free media and shut down SDL.
 		bool close();
 
+		// Renders into offscreen framebuffer of given size without display server (CI, render nodes).
+		// @note Must be called before start
+		void setHeadless(int32 width, int32 height);
+
+		bool isHeadless() const {
+			return m_headless;
+		}
+
+		// Stops main loop after given number of frames, zero means no limit
+		void setMaxFrames(uint64 maxFrames) {
+			m_maxFrames = maxFrames;
+		}
+
+		Window* getWindow() const {
+			return m_Window;
+		}
+
 		// Poll and handle SDL events
 		void handleWindowEvents();
 
-		// Draw objects on screen
+		// Records draw commands of objects on screen
 		void drawScreen();
 
+		// Starts recording of frame commands
 		void beforeDraw();
 
+		// Submits recorded frame to render thread or replays it immediately
 		void afterDraw();
 
+		// Replays OpenGL commands on separate thread owning context, so next frame
+		// is simulated while current one is submitted to driver.
+		// @note Must be called before start
+		void setRenderThreadEnabled(bool enabled = true) {
+			m_useRenderThread = enabled;
+		}
+
+		// Recompiles shaders when their source files change, enabled by default in debug builds.
+		// @note Must be called before start
+		void setShaderHotReload(bool enabled) {
+			m_shaderHotReload = enabled;
+		}
+
+		// Command buffer of frame being recorded, valid from beforeDraw till afterDraw
+		RenderCommandBuffer* getCommandBuffer() const {
+			return m_commands;
+		}
+
 		inline bool isRunning() const {
 			return 	!m_quit;
 		}
@@ -156,9 +249,67 @@ namespace exa
 		Exagine(Exagine const&) = delete;
 		Exagine& operator= (Exagine const&) = delete;
 
+		// Creates frame tasks: events -> beforeDraw -> drawScreen -> afterDraw.
+		// Tasks touching SDL or OpenGL are pinned to main thread.
+		void buildFrameGraph();
+
+		// Swaps window, executed on thread owning OpenGL context
+		void present(const FrameSnapshot& snapshot);
+
+		static void presentCallback(void* userData, const FrameSnapshot& snapshot);
+
 		// Main application Window
 		Window* m_Window = nullptr;
 
+		// Work-stealing scheduler used to run frame tasks
+		JobSystem* m_jobSystem = nullptr;
+
+		TaskGraph m_frameGraph;
+
+		TaskGraph::TaskId m_eventsTask = 0;
+		TaskGraph::TaskId m_simulateTask = 0;
+		TaskGraph::TaskId m_drawScreenTask = 0;
+
+		// Present mode and frame timings
+		FramePacer m_framePacer;
+
+		// Simulation clock, decoupled from render rate
+		FixedTimestep m_timestep;
+
+		std::vector<std::function<void(double)>> m_fixedUpdates;
+
+		// Replays command buffers when enabled
+		RenderThread* m_renderThread = nullptr;
+
+		bool m_useRenderThread = false;
+
+		// Watches shader files, nullptr if hot reload is disabled
+		ShaderReloader* m_shaderReloader = nullptr;
+
+#if defined(EXA_DEBUG)
+		bool m_shaderHotReload = true;
+#else
+		bool m_shaderHotReload = false;
+#endif
+
+		// Swap interval requested by last presented frame, render side only
+		int32 m_presentedSwapInterval = 1;
+
+		// Used when rendering on main thread
+		RenderCommandBuffer m_commandBuffer;
+
+		// Buffer being recorded this frame
+		RenderCommandBuffer* m_commands = nullptr;
+
+		// Index of frame in flight given by frame pacer
+		uint64 m_currentFrame = 0;
+
+		bool m_headless = false;
+		int32 m_headlessWidth = 0;
+		int32 m_headlessHeight = 0;
+
+		uint64 m_maxFrames = 0;
+
 		// Main loop flag.
 		bool m_quit = false;
 		StatusCode m_statusCode = StatusCode::EXA_NONE;
@@ -166,6 +317,9 @@ namespace exa
 		// Vertex Buffer Object stores vertex data
 		VertexBuffer* m_VBO = nullptr;
 
+		// Index Buffer Object stores triangles, attached to VAO
+		IndexBuffer* m_IBO = nullptr;
+
 		// Vertex Array Object manages VBO
 		VertexArray* m_VAO = nullptr;
 
@@ -176,5 +330,6 @@ namespace exa
 		Texture* m_texture = nullptr;
 
 		std::vector<Vertex> m_vertices;
+		std::vector<uint32> m_indices;
 	};
 }
\ No newline at end of file
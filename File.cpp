@@ -3,6 +3,15 @@
 
 #include "File.h"
 
+#include <cstdio>
+
+#ifdef _WIN32
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#endif
+
 #include "Memory.h"
 #include "Window.h"
 #include "Log.h"
@@ -11,6 +20,17 @@ namespace exa
 {
 	File::File() {}
 
+	bool File::replace(const char* source, const char* destination)
+	{
+#ifdef _WIN32
+		// rename fails on Windows if destination exists, deleting it first would leave no file on crash
+		return MoveFileExA(source, destination, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		// POSIX rename replaces directory entry atomically
+		return std::rename(source, destination) == 0;
+#endif
+	}
+
 	File::File(const char* filename) {
 		load(filename);
 	}
@@ -51,7 +71,7 @@ namespace exa
 
 		// File does not exist
 		if (rw == nullptr) {
-			log::error("Unable to read file: %s");
+			log::error("Unable to read file: %s", filename);
 			Window::checkSDLError(__LINE__);
 			return false;
 		}
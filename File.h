@@ -38,6 +38,10 @@ namespace exa
 			return (stat(filename, &buffer) == 0);
 		}
 
+		// Moves source over destination in one step, readers see either old or new file, never none.
+		// Returns false if source couldn't be moved, source is kept then
+		static bool replace(const char* source, const char* destination);
+
 	private:
 		int m_fileLen = 0;
 		unsigned char* m_fileBuffer = nullptr;
@@ -0,0 +1,175 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#   include <sys/inotify.h>
+#   include <unistd.h>
+#endif
+
+#include "Clock.h"
+#include "Log.h"
+
+namespace exa
+{
+	namespace
+	{
+		void splitPath(const std::string& path, std::string& directory, std::string& name)
+		{
+			size_t slash = path.find_last_of("/\\");
+			if (slash == std::string::npos) {
+				directory = ".";
+				name = path;
+			}
+			else {
+				directory = path.substr(0, slash);
+				name = path.substr(slash + 1);
+			}
+		}
+
+		void addUnique(std::vector<std::string>& files, const std::string& path)
+		{
+			if (std::find(files.begin(), files.end(), path) == files.end()) {
+				files.push_back(path);
+			}
+		}
+	}
+
+	FileWatcher::FileWatcher()
+	{
+#ifdef __linux__
+		m_notifyHandle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_notifyHandle < 0) {
+			log::warning("inotify is not available, polling file modification times");
+		}
+#endif
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+#ifdef __linux__
+		if (m_notifyHandle >= 0) {
+			close(m_notifyHandle);
+		}
+#endif
+	}
+
+	int64 FileWatcher::getModifiedTime(const std::string& path)
+	{
+		struct stat buffer;
+		if (stat(path.c_str(), &buffer) != 0) {
+			return 0;
+		}
+		return static_cast<int64>(buffer.st_mtime);
+	}
+
+	bool FileWatcher::addFile(const std::string& path)
+	{
+		for (const auto& file : m_files) {
+			if (file.path == path) {
+				return true;
+			}
+		}
+
+		WatchedFile file;
+		file.path = path;
+		splitPath(path, file.directory, file.name);
+		file.modifiedTime = getModifiedTime(path);
+
+#ifdef __linux__
+		if (m_notifyHandle >= 0) {
+			bool watched = false;
+			for (const auto& directory : m_directories) {
+				if (directory.second == file.directory) {
+					watched = true;
+					break;
+				}
+			}
+
+			if (!watched) {
+				int watch = inotify_add_watch(m_notifyHandle, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+				if (watch < 0) {
+					log::error("Unable to watch directory %s", file.directory.c_str());
+					return false;
+				}
+				m_directories[watch] = file.directory;
+			}
+		}
+#endif
+
+		m_files.push_back(std::move(file));
+		return true;
+	}
+
+	void FileWatcher::removeFile(const std::string& path)
+	{
+		m_files.erase(std::remove_if(m_files.begin(), m_files.end(), [&path](const WatchedFile& file) {
+			return file.path == path;
+		}), m_files.end());
+	}
+
+	void FileWatcher::update(std::vector<std::string>& changedFiles)
+	{
+		if (m_notifyHandle >= 0) {
+			readNotifications(changedFiles);
+		}
+		else {
+			pollModifiedTimes(changedFiles);
+		}
+	}
+
+	void FileWatcher::pollModifiedTimes(std::vector<std::string>& changedFiles)
+	{
+		const uint64 now = Clock::now();
+		if (m_lastPoll != 0 && Clock::toSeconds(now - m_lastPoll) < m_pollInterval) {
+			return;
+		}
+		m_lastPoll = now;
+
+		for (auto& file : m_files) {
+			int64 modifiedTime = getModifiedTime(file.path);
+			// Zero while file is being replaced
+			if (modifiedTime != 0 && modifiedTime != file.modifiedTime) {
+				file.modifiedTime = modifiedTime;
+				addUnique(changedFiles, file.path);
+			}
+		}
+	}
+
+	void FileWatcher::readNotifications(std::vector<std::string>& changedFiles)
+	{
+#ifdef __linux__
+		alignas(struct inotify_event) char buffer[4096];
+
+		for (;;) {
+			ssize_t length = read(m_notifyHandle, buffer, sizeof(buffer));
+			// EAGAIN: no more events
+			if (length <= 0) {
+				break;
+			}
+
+			for (char* pointer = buffer; pointer < buffer + length; ) {
+				const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(pointer);
+				pointer += sizeof(struct inotify_event) + event->len;
+
+				auto directory = m_directories.find(event->wd);
+				if (event->len == 0 || directory == m_directories.end()) {
+					continue;
+				}
+
+				for (const auto& file : m_files) {
+					if (file.name == event->name && file.directory == directory->second) {
+						addUnique(changedFiles, file.path);
+					}
+				}
+			}
+		}
+#else
+		(void)changedFiles;
+#endif
+	}
+}
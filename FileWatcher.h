@@ -0,0 +1,64 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	// Reports modified files. Uses inotify on Linux (directories are watched, so editors saving
+	// through rename are handled), elsewhere polls modification times.
+	class FileWatcher
+	{
+	public:
+		FileWatcher();
+		~FileWatcher();
+
+		bool addFile(const std::string& path);
+
+		void removeFile(const std::string& path);
+
+		// Appends files changed since previous call, never blocks
+		void update(std::vector<std::string>& changedFiles);
+
+		// Interval of modification time polling in seconds (used without inotify)
+		void setPollInterval(double seconds) {
+			m_pollInterval = seconds;
+		}
+
+		bool isUsingNotifications() const {
+			return m_notifyHandle >= 0;
+		}
+
+	private:
+		struct WatchedFile
+		{
+			std::string path;
+			std::string directory;
+			std::string name;
+			int64 modifiedTime = 0;
+		};
+
+		static int64 getModifiedTime(const std::string& path);
+
+		void pollModifiedTimes(std::vector<std::string>& changedFiles);
+
+		void readNotifications(std::vector<std::string>& changedFiles);
+
+		std::vector<WatchedFile> m_files;
+
+		// inotify descriptor, -1 if notifications are not available
+		int m_notifyHandle = -1;
+
+		// inotify watch descriptor to directory
+		std::unordered_map<int, std::string> m_directories;
+
+		double m_pollInterval = 0.5;
+		uint64 m_lastPoll = 0;
+	};
+}
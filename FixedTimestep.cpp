@@ -0,0 +1,74 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "FixedTimestep.h"
+
+#include <cmath>
+
+#include "Clock.h"
+#include "Log.h"
+
+namespace exa
+{
+	void FixedTimestep::setStep(double seconds)
+	{
+		if (seconds <= 0.0) {
+			log::error("Fixed timestep must be positive, got %f", seconds);
+			return;
+		}
+		m_step = seconds;
+	}
+
+	void FixedTimestep::setMaxStepsPerFrame(uint32 maxSteps)
+	{
+		if (maxSteps == 0) {
+			log::error("At least one simulation step per frame must be allowed");
+			return;
+		}
+		m_maxStepsPerFrame = maxSteps;
+	}
+
+	void FixedTimestep::reset()
+	{
+		m_accumulator = 0.0;
+		m_alpha = 0.0;
+		m_lastCounter = Clock::now();
+	}
+
+	uint32 FixedTimestep::advance()
+	{
+		uint64 counter = Clock::now();
+		if (m_lastCounter == 0) {
+			m_lastCounter = counter;
+		}
+
+		double elapsed = Clock::toSeconds(counter - m_lastCounter);
+		m_lastCounter = counter;
+
+		return advance(elapsed);
+	}
+
+	uint32 FixedTimestep::advance(double elapsedSeconds)
+	{
+		m_accumulator += elapsedSeconds;
+
+		uint32 steps = 0;
+		while (m_accumulator >= m_step && steps < m_maxStepsPerFrame) {
+			m_accumulator -= m_step;
+			steps++;
+		}
+
+		// Spiral of death protection: drop whole steps we can't afford,
+		// keep fractional part so interpolation stays smooth
+		if (m_accumulator >= m_step) {
+			m_accumulator = std::fmod(m_accumulator, m_step);
+			m_droppedFrames++;
+			log::debug("Simulation is running behind, dropped catch-up steps");
+		}
+
+		m_tick += steps;
+		m_alpha = m_accumulator / m_step;
+
+		return steps;
+	}
+}
@@ -0,0 +1,121 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include "exa.h"
+
+namespace exa
+{
+	// Accumulator based fixed step clock.
+	// Simulation always advances by getStep() seconds, so results don't depend on render rate.
+	// @see https://gafferongames.com/post/fix_your_timestep/
+	class FixedTimestep
+	{
+	public:
+		// Simulation step in seconds, 60 Hz by default
+		void setStep(double seconds);
+
+		double getStep() const {
+			return m_step;
+		}
+
+		// Max number of steps simulated in one frame. After a hitch the rest of accumulated time is dropped
+		// instead of trying to catch up (and making next frame even longer).
+		void setMaxStepsPerFrame(uint32 maxSteps);
+
+		uint32 getMaxStepsPerFrame() const {
+			return m_maxStepsPerFrame;
+		}
+
+		// Restarts clock, must be called before first advance()
+		void reset();
+
+		// Adds elapsed real time to accumulator and returns number of steps to simulate this frame.
+		// @note Also updates interpolation factor
+		uint32 advance();
+
+		// Adds given time to accumulator, used for offline or replayed runs
+		uint32 advance(double elapsedSeconds);
+
+		// Blend factor between previous and current simulation state in [0;1)
+		double getAlpha() const {
+			return m_alpha;
+		}
+
+		// Total number of simulated steps
+		uint64 getTick() const {
+			return m_tick;
+		}
+
+		// Simulated time in seconds
+		double getTime() const {
+			return static_cast<double>(m_tick) * m_step;
+		}
+
+		// Number of frames where catch-up steps were dropped
+		uint64 getDroppedFrames() const {
+			return m_droppedFrames;
+		}
+
+	private:
+		double m_step = 1.0 / 60.0;
+
+		double m_accumulator = 0.0;
+
+		double m_alpha = 0.0;
+
+		uint32 m_maxStepsPerFrame = 5;
+
+		uint64 m_tick = 0;
+
+		uint64 m_droppedFrames = 0;
+
+		uint64 m_lastCounter = 0;
+	};
+
+	// Keeps two last simulation states to render in between them.
+	// Call set() once per fixed step and get() with FixedTimestep::getAlpha() when rendering.
+	template <typename T>
+	class Interpolated
+	{
+	public:
+		Interpolated() = default;
+
+		explicit Interpolated(const T& value)
+			: m_previous(value), m_current(value)
+		{
+		}
+
+		// Stores new simulation state, current becomes previous
+		void set(const T& value)
+		{
+			m_previous = m_current;
+			m_current = value;
+		}
+
+		// Overrides both states, use it on teleports to avoid blending
+		void reset(const T& value)
+		{
+			m_previous = value;
+			m_current = value;
+		}
+
+		const T& getPrevious() const {
+			return m_previous;
+		}
+
+		const T& getCurrent() const {
+			return m_current;
+		}
+
+		T get(double alpha) const
+		{
+			return m_previous + (m_current - m_previous) * static_cast<float>(alpha);
+		}
+
+	private:
+		T m_previous = T();
+		T m_current = T();
+	};
+}
@@ -0,0 +1,232 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "FramePacer.h"
+
+#include <algorithm>
+
+#include "Clock.h"
+#include "Log.h"
+
+namespace exa
+{
+	// Out of line definition, std::min takes it by reference
+	const size_t FramePacer::HISTORY_SIZE;
+
+	// SDL_Delay may oversleep by scheduler quantum, last part is spent spinning
+	static const double SPIN_THRESHOLD_SECONDS = 0.002;
+
+	// Extra time reserved for frame in low latency mode
+	static const double LOW_LATENCY_MARGIN_SECONDS = 0.001;
+
+	void FramePacer::setPresentMode(PresentMode mode)
+	{
+		if (mode == PresentMode::EXA_TOTAL_ITEMS) {
+			log::error("Invalid present mode");
+			return;
+		}
+		m_presentMode = mode;
+	}
+
+	int FramePacer::getSwapInterval() const
+	{
+		switch (m_presentMode) {
+			case PresentMode::EXA_PRESENT_VSYNC:
+				return 1;
+			case PresentMode::EXA_PRESENT_ADAPTIVE_VSYNC:
+				return -1;
+			default:
+				return 0;
+		}
+	}
+
+	void FramePacer::setTargetFrameRate(double framesPerSecond)
+	{
+		if (framesPerSecond <= 0.0) {
+			log::error("Target frame rate must be positive, got %f", framesPerSecond);
+			return;
+		}
+		m_targetFrameRate = framesPerSecond;
+	}
+
+	void FramePacer::sleepUntil(uint64 counter)
+	{
+		uint64 now = Clock::now();
+		if (counter == 0 || now >= counter) {
+			return;
+		}
+
+		double remaining = Clock::toSeconds(counter - now);
+		if (remaining > SPIN_THRESHOLD_SECONDS) {
+			SDL_Delay(static_cast<Uint32>((remaining - SPIN_THRESHOLD_SECONDS) * 1000.0));
+		}
+
+		while (Clock::now() < counter) {
+			// Busy wait for sub-millisecond precision
+		}
+	}
+
+	uint64 FramePacer::predictFrameCost() const
+	{
+		// Worst of recent frames, so spikes don't make us miss retrace.
+		// @note Swap time is left out, in vsync modes it contains wait for retrace and would keep
+		//		 prediction at full interval after single slow frame
+		const size_t frames = std::min<size_t>(8, static_cast<size_t>(m_presentedFrames));
+		double cost = 0.0;
+		for (size_t i = 1; i <= frames; i++) {
+			const FrameStats& stats = m_history[(m_presentedFrames - i) % HISTORY_SIZE];
+			cost = std::max(cost, stats.cpuTime + stats.submitTime);
+		}
+		return Clock::fromSeconds(cost / 1000.0 + LOW_LATENCY_MARGIN_SECONDS);
+	}
+
+	uint64 FramePacer::beginFrame()
+	{
+		uint64 waitStart = Clock::now();
+		uint64 sleepTarget = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const uint64 interval = Clock::fromSeconds(1.0 / m_targetFrameRate);
+
+			if (m_lastSwapEnd != 0) {
+				if (m_lowLatency && m_presentMode != PresentMode::EXA_PRESENT_UNCAPPED) {
+					// Start as late as possible so swap still lands on next interval (retrace).
+					// @note In vsync modes swap (with glFinish) returns right after retrace
+					uint64 cost = predictFrameCost();
+					if (cost < interval) {
+						sleepTarget = m_lastSwapEnd + interval - cost;
+					}
+				}
+				else if (m_presentMode == PresentMode::EXA_PRESENT_LIMITED) {
+					sleepTarget = m_lastFrameStart + interval;
+				}
+			}
+		}
+
+		sleepUntil(sleepTarget);
+
+		uint64 frameStart = Clock::now();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		uint64 frameIndex = m_frameIndex++;
+		const size_t slot = frameIndex % HISTORY_SIZE;
+
+		FrameStats& stats = m_history[slot];
+		stats = FrameStats{};
+		stats.frameIndex = frameIndex;
+		stats.waitTime = Clock::toMilliseconds(frameStart - waitStart);
+		if (m_lastFrameStart != 0) {
+			stats.frameTime = Clock::toMilliseconds(frameStart - m_lastFrameStart);
+		}
+		m_lastFrameStart = frameStart;
+
+		m_timestamps[slot] = FrameTimestamps{};
+		m_timestamps[slot].frameStart = frameStart;
+		m_timestamps[slot].inputSampled = frameStart;
+
+		return frameIndex;
+	}
+
+	void FramePacer::markInputSampled(uint64 frameIndex)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_timestamps[frameIndex % HISTORY_SIZE].inputSampled = Clock::now();
+	}
+
+	void FramePacer::beginSwap(uint64 frameIndex)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const size_t slot = frameIndex % HISTORY_SIZE;
+		FrameTimestamps& timestamps = m_timestamps[slot];
+		timestamps.swapStart = Clock::now();
+		m_history[slot].cpuTime = Clock::toMilliseconds(timestamps.swapStart - timestamps.frameStart);
+	}
+
+	void FramePacer::markSubmitted(uint64 frameIndex)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const size_t slot = frameIndex % HISTORY_SIZE;
+		FrameTimestamps& timestamps = m_timestamps[slot];
+		timestamps.submitted = Clock::now();
+		m_history[slot].submitTime = Clock::toMilliseconds(timestamps.submitted - timestamps.swapStart);
+	}
+
+	void FramePacer::endSwap(uint64 frameIndex)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const size_t slot = frameIndex % HISTORY_SIZE;
+		const FrameTimestamps& timestamps = m_timestamps[slot];
+
+		m_lastSwapEnd = Clock::now();
+		m_history[slot].swapTime = Clock::toMilliseconds(m_lastSwapEnd - timestamps.swapStart);
+		m_history[slot].inputLatency = Clock::toMilliseconds(m_lastSwapEnd - timestamps.inputSampled);
+
+		// Frames are presented in order
+		m_presentedFrames = frameIndex + 1;
+	}
+
+	uint64 FramePacer::getFrameIndex() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_frameIndex;
+	}
+
+	uint64 FramePacer::getPresentedFrames() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_presentedFrames;
+	}
+
+	FrameStats FramePacer::getLastFrameStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_history[(m_presentedFrames + HISTORY_SIZE - 1) % HISTORY_SIZE];
+	}
+
+	size_t FramePacer::getFrameStats(FrameStats* stats, size_t count) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		const size_t available = std::min<size_t>(HISTORY_SIZE, static_cast<size_t>(m_presentedFrames));
+		count = std::min(count, available);
+
+		for (size_t i = 0; i < count; i++) {
+			stats[i] = m_history[(m_presentedFrames - count + i) % HISTORY_SIZE];
+		}
+		return count;
+	}
+
+	FrameStats FramePacer::getAverageFrameStats(size_t count) const
+	{
+		std::array<FrameStats, HISTORY_SIZE> frames;
+		count = getFrameStats(frames.data(), std::min(count, HISTORY_SIZE));
+
+		FrameStats average;
+		if (count == 0) {
+			return average;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			average.frameTime += frames[i].frameTime;
+			average.waitTime += frames[i].waitTime;
+			average.cpuTime += frames[i].cpuTime;
+			average.submitTime += frames[i].submitTime;
+			average.swapTime += frames[i].swapTime;
+			average.inputLatency += frames[i].inputLatency;
+		}
+
+		const double scale = 1.0 / static_cast<double>(count);
+		average.frameIndex = frames[count - 1].frameIndex;
+		average.frameTime *= scale;
+		average.waitTime *= scale;
+		average.cpuTime *= scale;
+		average.submitTime *= scale;
+		average.swapTime *= scale;
+		average.inputLatency *= scale;
+
+		return average;
+	}
+}
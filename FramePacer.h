@@ -0,0 +1,144 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <array>
+#include <mutex>
+
+#include "exa.h"
+
+namespace exa
+{
+	// How frames are presented
+	enum class PresentMode : std::int8_t
+	{
+		// Swap waits for vertical retrace (swap interval 1)
+		EXA_PRESENT_VSYNC,
+		// Late swap tearing (swap interval -1), falls back to vsync if not supported
+		EXA_PRESENT_ADAPTIVE_VSYNC,
+		// No synchronization at all (swap interval 0)
+		EXA_PRESENT_UNCAPPED,
+		// No vsync, CPU sleeps to hit target frame rate
+		EXA_PRESENT_LIMITED,
+		EXA_TOTAL_ITEMS
+	};
+
+	// Timings of one presented frame, all values in milliseconds
+	struct FrameStats
+	{
+		uint64 frameIndex = 0;
+		// Time between two frame starts
+		double frameTime = 0.0;
+		// Time spent by limiter before frame started
+		double waitTime = 0.0;
+		// Time from frame start (after limiter) till swap
+		double cpuTime = 0.0;
+		// Time from swap start till commands of frame were flushed to driver (see markSubmitted)
+		double submitTime = 0.0;
+		// Time spent inside SDL_GL_SwapWindow (and glFinish in low latency mode), includes waiting
+		// for vertical retrace in vsync modes
+		double swapTime = 0.0;
+		// Time from input sampling till swap returned
+		double inputLatency = 0.0;
+	};
+
+	// Controls present mode and frame rate limiter, measures present timings.
+	// @note Frames may overlap when rendering on render thread, so timings are recorded per frame index.
+	//		 All functions are thread safe.
+	class FramePacer
+	{
+	public:
+		static const size_t HISTORY_SIZE = 256;
+
+		void setPresentMode(PresentMode mode);
+
+		PresentMode getPresentMode() const {
+			return m_presentMode;
+		}
+
+		// Swap interval passed to SDL_GL_SetSwapInterval for current present mode
+		int getSwapInterval() const;
+
+		// Frame rate used by EXA_PRESENT_LIMITED and to predict vertical retrace in low latency mode.
+		// @note In vsync modes it should match display refresh rate
+		void setTargetFrameRate(double framesPerSecond);
+
+		double getTargetFrameRate() const {
+			return m_targetFrameRate;
+		}
+
+		// Low latency mode delays frame start (and input sampling) as close to present as possible
+		// and waits for GPU after swap, so driver never queues frames.
+		void setLowLatency(bool enabled = true) {
+			m_lowLatency = enabled;
+		}
+
+		bool isLowLatency() const {
+			return m_lowLatency;
+		}
+
+		// Sleeps if limiter or low latency mode requires it and marks frame start, returns frame index
+		uint64 beginFrame();
+
+		// Called right after input events of frame are polled
+		void markInputSampled(uint64 frameIndex);
+
+		void beginSwap(uint64 frameIndex);
+
+		// Called between beginSwap and swap once commands of frame are flushed
+		void markSubmitted(uint64 frameIndex);
+
+		// Finalizes stats of frame
+		void endSwap(uint64 frameIndex);
+
+		// Stats of last finished frame
+		FrameStats getLastFrameStats() const;
+
+		// Copies up to count last frames stats (oldest first), returns number of copied frames
+		size_t getFrameStats(FrameStats* stats, size_t count) const;
+
+		// Average of up to count last frames
+		FrameStats getAverageFrameStats(size_t count) const;
+
+		// Number of started frames
+		uint64 getFrameIndex() const;
+
+		// Number of presented frames
+		uint64 getPresentedFrames() const;
+
+	private:
+		// Sleeps using SDL_Delay and spins for the last part to hit counter value precisely
+		void sleepUntil(uint64 counter);
+
+		// Expected CPU and submit time of next frame based on recent frames, without retrace wait
+		uint64 predictFrameCost() const;
+
+		PresentMode m_presentMode = PresentMode::EXA_PRESENT_VSYNC;
+
+		double m_targetFrameRate = 60.0;
+
+		bool m_lowLatency = false;
+
+		// Timestamps of frame in flight
+		struct FrameTimestamps
+		{
+			uint64 frameStart = 0;
+			uint64 inputSampled = 0;
+			uint64 swapStart = 0;
+			uint64 submitted = 0;
+		};
+
+		mutable std::mutex m_mutex;
+
+		uint64 m_frameIndex = 0;
+		uint64 m_presentedFrames = 0;
+
+		uint64 m_lastFrameStart = 0;
+		uint64 m_lastSwapEnd = 0;
+
+		std::array<FrameTimestamps, HISTORY_SIZE> m_timestamps;
+
+		std::array<FrameStats, HISTORY_SIZE> m_history;
+	};
+}
@@ -0,0 +1,111 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "Framebuffer.h"
+
+#include "Log.h"
+
+namespace exa
+{
+	Framebuffer::Framebuffer()
+	{
+	}
+
+	Framebuffer::~Framebuffer()
+	{
+		destroy();
+	}
+
+	void Framebuffer::destroy()
+	{
+		if (m_depthStencil != 0) {
+			exaglDeleteRenderbuffers(1, &m_depthStencil);
+			m_depthStencil = 0;
+		}
+
+		if (m_colorTexture != 0) {
+			exaglDeleteTextures(1, &m_colorTexture);
+			m_colorTexture = 0;
+		}
+
+		if (m_FBO != 0) {
+			exaglDeleteFramebuffers(1, &m_FBO);
+			m_FBO = 0;
+		}
+	}
+
+	bool Framebuffer::create(int width, int height)
+	{
+		if (width <= 0 || height <= 0) {
+			log::error("Invalid framebuffer size (%d, %d)", width, height);
+			return false;
+		}
+
+		destroy();
+
+		m_width = width;
+		m_height = height;
+
+		exaglGenFramebuffers(1, &m_FBO);
+		exaglBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+
+		// Color attachment is a texture, so result may be sampled or read back
+		exaglGenTextures(1, &m_colorTexture);
+		exaglBindTexture(GL_TEXTURE_2D, m_colorTexture);
+		exaglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		exaglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		exaglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		exaglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		exaglTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		exaglBindTexture(GL_TEXTURE_2D, 0);
+		exaglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTexture, 0);
+
+		exaglGenRenderbuffers(1, &m_depthStencil);
+		exaglBindRenderbuffer(GL_RENDERBUFFER, m_depthStencil);
+		exaglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		exaglBindRenderbuffer(GL_RENDERBUFFER, 0);
+		exaglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthStencil);
+
+		GLenum status = exaglCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+		exaglBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			log::error("Framebuffer is incomplete, status 0x%x", status);
+			destroy();
+			return false;
+		}
+
+		log::debug("Created framebuffer (%d, %d)", width, height);
+
+		return true;
+	}
+
+	void Framebuffer::bind()
+	{
+		exaglBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+		exaglViewport(0, 0, m_width, m_height);
+	}
+
+	void Framebuffer::unbind()
+	{
+		exaglBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	bool Framebuffer::readPixels(std::vector<unsigned char>& pixels)
+	{
+		if (m_FBO == 0) {
+			log::error("Framebuffer is not created");
+			return false;
+		}
+
+		pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+
+		exaglBindFramebuffer(GL_READ_FRAMEBUFFER, m_FBO);
+		exaglPixelStorei(GL_PACK_ALIGNMENT, 1);
+		exaglReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		exaglBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+		return true;
+	}
+}
@@ -0,0 +1,57 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "RenderPlatforms.h"
+
+namespace exa
+{
+	// Offscreen render target: RGBA8 color texture plus depth-stencil renderbuffer
+	class Framebuffer
+	{
+	public:
+
+		Framebuffer();
+		~Framebuffer();
+
+		// Creates (or recreates) attachments, returns false if framebuffer is incomplete
+		bool create(int width, int height);
+
+		// Binds framebuffer for drawing and sets viewport to its size
+		void bind();
+
+		void unbind();
+
+		// Reads back color attachment as tightly packed RGBA rows (bottom row first)
+		bool readPixels(std::vector<unsigned char>& pixels);
+
+		GLuint get() const {
+			return m_FBO;
+		}
+
+		GLuint getColorTexture() const {
+			return m_colorTexture;
+		}
+
+		int getWidth() const {
+			return m_width;
+		}
+
+		int getHeight() const {
+			return m_height;
+		}
+
+	private:
+		void destroy();
+
+		GLuint m_FBO = 0;
+		GLuint m_colorTexture = 0;
+		GLuint m_depthStencil = 0;
+
+		int m_width = 0;
+		int m_height = 0;
+	};
+}
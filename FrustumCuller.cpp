@@ -0,0 +1,350 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		const uint32 LANES = 4;
+
+		uint32 padded(uint32 count)
+		{
+			return (count + LANES - 1) & ~(LANES - 1);
+		}
+
+		template <typename T>
+		void set(std::vector<T>& values, uint32 slot, T value)
+		{
+			if (values.size() <= slot) {
+				values.resize(slot + 1);
+			}
+			values[slot] = value;
+		}
+
+		template <typename T>
+		void fill(std::vector<T>& values, uint32 count, T value)
+		{
+			values.resize(padded(count));
+			std::fill(values.begin() + count, values.end(), value);
+		}
+	}
+
+	Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+	{
+		// Rows of matrix, glm stores columns
+		const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		Frustum frustum;
+		frustum.planes[static_cast<uint32>(FrustumPlane::EXA_LEFT)] = row3 + row0;
+		frustum.planes[static_cast<uint32>(FrustumPlane::EXA_RIGHT)] = row3 - row0;
+		frustum.planes[static_cast<uint32>(FrustumPlane::EXA_BOTTOM)] = row3 + row1;
+		frustum.planes[static_cast<uint32>(FrustumPlane::EXA_TOP)] = row3 - row1;
+		frustum.planes[static_cast<uint32>(FrustumPlane::EXA_NEAR)] = row3 + row2;
+		frustum.planes[static_cast<uint32>(FrustumPlane::EXA_FAR)] = row3 - row2;
+
+		for (glm::vec4& plane : frustum.planes) {
+			const float length = glm::length(glm::vec3(plane));
+			if (length > 0.0f) {
+				plane /= length;
+			}
+		}
+
+		return frustum;
+	}
+
+	FrustumCuller::FrustumCuller(JobSystem* jobSystem)
+		: m_jobSystem(jobSystem)
+	{
+	}
+
+	void FrustumCuller::clear()
+	{
+		m_spheres.count = 0;
+		m_boxes.count = 0;
+	}
+
+	void FrustumCuller::reserve(uint32 sphereCount, uint32 boxCount)
+	{
+		const uint32 spheres = padded(sphereCount);
+		m_spheres.x.reserve(spheres);
+		m_spheres.y.reserve(spheres);
+		m_spheres.z.reserve(spheres);
+		m_spheres.radius.reserve(spheres);
+		m_spheres.ids.reserve(spheres);
+
+		const uint32 boxes = padded(boxCount);
+		m_boxes.x.reserve(boxes);
+		m_boxes.y.reserve(boxes);
+		m_boxes.z.reserve(boxes);
+		m_boxes.extentX.reserve(boxes);
+		m_boxes.extentY.reserve(boxes);
+		m_boxes.extentZ.reserve(boxes);
+		m_boxes.ids.reserve(boxes);
+	}
+
+	uint32 FrustumCuller::addSphere(const glm::vec3& center, float radius, uint32 id)
+	{
+		const uint32 slot = m_spheres.count++;
+		set(m_spheres.ids, slot, id);
+		updateSphere(slot, center, radius);
+		return slot;
+	}
+
+	uint32 FrustumCuller::addBox(const glm::vec3& min, const glm::vec3& max, uint32 id)
+	{
+		const uint32 slot = m_boxes.count++;
+		set(m_boxes.ids, slot, id);
+		updateBox(slot, min, max);
+		return slot;
+	}
+
+	void FrustumCuller::updateSphere(uint32 slot, const glm::vec3& center, float radius)
+	{
+		set(m_spheres.x, slot, center.x);
+		set(m_spheres.y, slot, center.y);
+		set(m_spheres.z, slot, center.z);
+		set(m_spheres.radius, slot, radius);
+	}
+
+	void FrustumCuller::updateBox(uint32 slot, const glm::vec3& min, const glm::vec3& max)
+	{
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+		set(m_boxes.x, slot, center.x);
+		set(m_boxes.y, slot, center.y);
+		set(m_boxes.z, slot, center.z);
+		set(m_boxes.extentX, slot, extent.x);
+		set(m_boxes.extentY, slot, extent.y);
+		set(m_boxes.extentZ, slot, extent.z);
+	}
+
+	void FrustumCuller::pad(Spheres& spheres)
+	{
+		// Negative radius fails every plane test
+		fill(spheres.x, spheres.count, 0.0f);
+		fill(spheres.y, spheres.count, 0.0f);
+		fill(spheres.z, spheres.count, 0.0f);
+		fill(spheres.radius, spheres.count, -FLT_MAX);
+		fill(spheres.ids, spheres.count, 0u);
+	}
+
+	void FrustumCuller::pad(Boxes& boxes)
+	{
+		fill(boxes.x, boxes.count, 0.0f);
+		fill(boxes.y, boxes.count, 0.0f);
+		fill(boxes.z, boxes.count, 0.0f);
+		fill(boxes.extentX, boxes.count, -FLT_MAX);
+		fill(boxes.extentY, boxes.count, -FLT_MAX);
+		fill(boxes.extentZ, boxes.count, -FLT_MAX);
+		fill(boxes.ids, boxes.count, 0u);
+	}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+	namespace
+	{
+		// Writes ids of set lanes without branches, out must have room for four ids
+		inline uint32 emit(int mask, const uint32* ids, uint32* out)
+		{
+			uint32 written = 0;
+			out[written] = ids[0];
+			written += mask & 1;
+			out[written] = ids[1];
+			written += (mask >> 1) & 1;
+			out[written] = ids[2];
+			written += (mask >> 2) & 1;
+			out[written] = ids[3];
+			written += (mask >> 3) & 1;
+			return written;
+		}
+	}
+
+	uint32 FrustumCuller::cullSpheres(const Spheres& spheres, const Frustum& frustum, uint32 begin, uint32 end, uint32* out)
+	{
+		__m128 planeX[Frustum::PLANE_COUNT], planeY[Frustum::PLANE_COUNT], planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+		for (uint32 plane = 0; plane < Frustum::PLANE_COUNT; plane++) {
+			planeX[plane] = _mm_set1_ps(frustum.planes[plane].x);
+			planeY[plane] = _mm_set1_ps(frustum.planes[plane].y);
+			planeZ[plane] = _mm_set1_ps(frustum.planes[plane].z);
+			planeW[plane] = _mm_set1_ps(frustum.planes[plane].w);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		uint32 written = 0;
+
+		for (uint32 i = begin; i < end; i += LANES) {
+			const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+			const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+			const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+			const __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(&spheres.radius[i]));
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (uint32 plane = 0; plane < Frustum::PLANE_COUNT; plane++) {
+				const __m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(planeX[plane], x), _mm_mul_ps(planeY[plane], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[plane], z), planeW[plane]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			written += emit(_mm_movemask_ps(inside), &spheres.ids[i], out + written);
+		}
+
+		return written;
+	}
+
+	uint32 FrustumCuller::cullBoxes(const Boxes& boxes, const Frustum& frustum, uint32 begin, uint32 end, uint32* out)
+	{
+		__m128 planeX[Frustum::PLANE_COUNT], planeY[Frustum::PLANE_COUNT], planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+		__m128 absX[Frustum::PLANE_COUNT], absY[Frustum::PLANE_COUNT], absZ[Frustum::PLANE_COUNT];
+		for (uint32 plane = 0; plane < Frustum::PLANE_COUNT; plane++) {
+			const glm::vec4& p = frustum.planes[plane];
+			planeX[plane] = _mm_set1_ps(p.x);
+			planeY[plane] = _mm_set1_ps(p.y);
+			planeZ[plane] = _mm_set1_ps(p.z);
+			planeW[plane] = _mm_set1_ps(p.w);
+			absX[plane] = _mm_set1_ps(std::fabs(p.x));
+			absY[plane] = _mm_set1_ps(std::fabs(p.y));
+			absZ[plane] = _mm_set1_ps(std::fabs(p.z));
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		uint32 written = 0;
+
+		for (uint32 i = begin; i < end; i += LANES) {
+			const __m128 x = _mm_loadu_ps(&boxes.x[i]);
+			const __m128 y = _mm_loadu_ps(&boxes.y[i]);
+			const __m128 z = _mm_loadu_ps(&boxes.z[i]);
+			const __m128 extentX = _mm_loadu_ps(&boxes.extentX[i]);
+			const __m128 extentY = _mm_loadu_ps(&boxes.extentY[i]);
+			const __m128 extentZ = _mm_loadu_ps(&boxes.extentZ[i]);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (uint32 plane = 0; plane < Frustum::PLANE_COUNT; plane++) {
+				const __m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(planeX[plane], x), _mm_mul_ps(planeY[plane], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[plane], z), planeW[plane]));
+				const __m128 reach = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(absX[plane], extentX), _mm_mul_ps(absY[plane], extentY)),
+					_mm_mul_ps(absZ[plane], extentZ));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+			}
+
+			written += emit(_mm_movemask_ps(inside), &boxes.ids[i], out + written);
+		}
+
+		return written;
+	}
+
+#else
+
+	uint32 FrustumCuller::cullSpheres(const Spheres& spheres, const Frustum& frustum, uint32 begin, uint32 end, uint32* out)
+	{
+		uint32 written = 0;
+
+		for (uint32 i = begin; i < end; i++) {
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.planes) {
+				const float distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+				inside &= distance >= -spheres.radius[i];
+			}
+
+			out[written] = spheres.ids[i];
+			written += inside ? 1 : 0;
+		}
+
+		return written;
+	}
+
+	uint32 FrustumCuller::cullBoxes(const Boxes& boxes, const Frustum& frustum, uint32 begin, uint32 end, uint32* out)
+	{
+		uint32 written = 0;
+
+		for (uint32 i = begin; i < end; i++) {
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.planes) {
+				const float distance = plane.x * boxes.x[i] + plane.y * boxes.y[i] + plane.z * boxes.z[i] + plane.w;
+				const float reach = std::fabs(plane.x) * boxes.extentX[i] + std::fabs(plane.y) * boxes.extentY[i] + std::fabs(plane.z) * boxes.extentZ[i];
+				inside &= distance + reach >= 0.0f;
+			}
+
+			out[written] = boxes.ids[i];
+			written += inside ? 1 : 0;
+		}
+
+		return written;
+	}
+
+#endif
+
+	void FrustumCuller::cull(const Frustum& frustum, std::vector<uint32>& visible)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		pad(m_spheres);
+		pad(m_boxes);
+
+		const uint32 sphereSlots = padded(m_spheres.count);
+		const uint32 boxSlots = padded(m_boxes.count);
+
+		const bool parallel = m_jobSystem != nullptr && m_jobSystem->getNumThreads() > 1
+			&& sphereSlots + boxSlots > CHUNK_SIZE;
+
+		if (!parallel) {
+			visible.resize(sphereSlots + boxSlots);
+			uint32 written = cullSpheres(m_spheres, frustum, 0, sphereSlots, visible.data());
+			written += cullBoxes(m_boxes, frustum, 0, boxSlots, visible.data() + written);
+			visible.resize(written);
+			return;
+		}
+
+		// Chunks never mix spheres and boxes, CHUNK_SIZE is multiple of four so chunks start at full lanes
+		const uint32 sphereChunks = (sphereSlots + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		const uint32 boxChunks = (boxSlots + CHUNK_SIZE - 1) / CHUNK_SIZE;
+		const uint32 chunkCount = sphereChunks + boxChunks;
+
+		m_chunkVisible.resize(chunkCount * CHUNK_SIZE);
+		m_chunkCounts.resize(chunkCount);
+
+		m_jobSystem->parallelFor(chunkCount, 1, [&](uint32 begin, uint32 end) {
+			for (uint32 chunk = begin; chunk < end; chunk++) {
+				uint32* out = &m_chunkVisible[chunk * CHUNK_SIZE];
+				if (chunk < sphereChunks) {
+					const uint32 first = chunk * CHUNK_SIZE;
+					m_chunkCounts[chunk] = cullSpheres(m_spheres, frustum, first, std::min(first + CHUNK_SIZE, sphereSlots), out);
+				}
+				else {
+					const uint32 first = (chunk - sphereChunks) * CHUNK_SIZE;
+					m_chunkCounts[chunk] = cullBoxes(m_boxes, frustum, first, std::min(first + CHUNK_SIZE, boxSlots), out);
+				}
+			}
+		});
+
+		uint32 total = 0;
+		for (uint32 chunk = 0; chunk < chunkCount; chunk++) {
+			total += m_chunkCounts[chunk];
+		}
+
+		visible.resize(total);
+
+		uint32 offset = 0;
+		for (uint32 chunk = 0; chunk < chunkCount; chunk++) {
+			if (m_chunkCounts[chunk] > 0) {
+				memcpy(&visible[offset], &m_chunkVisible[chunk * CHUNK_SIZE], m_chunkCounts[chunk] * sizeof(uint32));
+				offset += m_chunkCounts[chunk];
+			}
+		}
+	}
+}
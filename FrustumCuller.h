@@ -0,0 +1,110 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	class JobSystem;
+
+	enum class FrustumPlane : std::int8_t
+	{
+		EXA_LEFT,
+		EXA_RIGHT,
+		EXA_BOTTOM,
+		EXA_TOP,
+		EXA_NEAR,
+		EXA_FAR,
+		EXA_TOTAL_ITEMS
+	};
+
+	// Six planes with normals pointing inside, normalized so that plane distance is in world units
+	struct Frustum
+	{
+		static const uint32 PLANE_COUNT = static_cast<uint32>(FrustumPlane::EXA_TOTAL_ITEMS);
+
+		// xyz normal, w distance, indexed by FrustumPlane
+		glm::vec4 planes[PLANE_COUNT];
+
+		// Planes of OpenGL clip volume (-w <= z <= w) in space viewProjection transforms from
+		static Frustum fromMatrix(const glm::mat4& viewProjection);
+	};
+
+	// Bounds of objects kept as structure of arrays (x, y, z, radius of all spheres one after another)
+	// and tested against frustum four at once with SSE, scalar code is used where SSE is not available.
+	// Visible objects are written as compact list of ids given when bounds were added. Large sets are
+	// split into chunks culled in parallel, chunk results are concatenated in slot order.
+	//
+	// Bounds are conservative: object is culled only when it is fully outside of some plane.
+	class FrustumCuller
+	{
+	public:
+		// Objects per parallel job, also smallest set culled in parallel
+		static const uint32 CHUNK_SIZE = 16 * 1024;
+
+		// @param jobSystem nullptr culls on calling thread only
+		explicit FrustumCuller(JobSystem* jobSystem = nullptr);
+
+		// Drops all bounds, keeps memory
+		void clear();
+
+		void reserve(uint32 sphereCount, uint32 boxCount);
+
+		// @return Slot to update bounds, slots are dense and valid until clear
+		uint32 addSphere(const glm::vec3& center, float radius, uint32 id);
+
+		uint32 addBox(const glm::vec3& min, const glm::vec3& max, uint32 id);
+
+		void updateSphere(uint32 slot, const glm::vec3& center, float radius);
+
+		void updateBox(uint32 slot, const glm::vec3& min, const glm::vec3& max);
+
+		// Replaces content of visible with ids of spheres followed by ids of boxes inside frustum
+		void cull(const Frustum& frustum, std::vector<uint32>& visible);
+
+		uint32 getSphereCount() const {
+			return m_spheres.count;
+		}
+
+		uint32 getBoxCount() const {
+			return m_boxes.count;
+		}
+
+	private:
+		// Arrays are padded to multiple of four with bounds outside of every frustum
+		struct Spheres
+		{
+			std::vector<float> x, y, z, radius;
+			std::vector<uint32> ids;
+			uint32 count = 0;
+		};
+
+		// Center and half size, box is inside plane when its most inside corner is
+		struct Boxes
+		{
+			std::vector<float> x, y, z, extentX, extentY, extentZ;
+			std::vector<uint32> ids;
+			uint32 count = 0;
+		};
+
+		static void pad(Spheres& spheres);
+		static void pad(Boxes& boxes);
+
+		// Test range [begin, end) of padded arrays, write visible ids to out and return their number
+		static uint32 cullSpheres(const Spheres& spheres, const Frustum& frustum, uint32 begin, uint32 end, uint32* out);
+		static uint32 cullBoxes(const Boxes& boxes, const Frustum& frustum, uint32 begin, uint32 end, uint32* out);
+
+		JobSystem* m_jobSystem = nullptr;
+
+		Spheres m_spheres;
+		Boxes m_boxes;
+
+		// Per-chunk results of parallel cull, chunk i writes from i * CHUNK_SIZE
+		std::vector<uint32> m_chunkVisible;
+		std::vector<uint32> m_chunkCounts;
+	};
+}
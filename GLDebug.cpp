@@ -0,0 +1,107 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "GLDebug.h"
+
+#include "exagl.h"
+#include "Log.h"
+
+namespace exa
+{
+	std::atomic<bool> GLDebug::s_enabled{ true };
+
+	namespace
+	{
+		const char* getErrorName(GLenum error)
+		{
+			switch (error) {
+				case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
+				case GL_INVALID_VALUE: return "GL_INVALID_VALUE";
+				case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION";
+				case GL_INVALID_FRAMEBUFFER_OPERATION: return "GL_INVALID_FRAMEBUFFER_OPERATION";
+				case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY";
+				case GL_STACK_OVERFLOW: return "GL_STACK_OVERFLOW";
+				case GL_STACK_UNDERFLOW: return "GL_STACK_UNDERFLOW";
+				default: return "unknown error";
+			}
+		}
+
+		const char* getSourceName(GLenum source)
+		{
+			switch (source) {
+				case GL_DEBUG_SOURCE_API: return "API";
+				case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+				case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+				case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+				case GL_DEBUG_SOURCE_APPLICATION: return "application";
+				default: return "other";
+			}
+		}
+
+		const char* getTypeName(GLenum type)
+		{
+			switch (type) {
+				case GL_DEBUG_TYPE_ERROR: return "error";
+				case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behavior";
+				case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+				case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+				case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+				default: return "other";
+			}
+		}
+
+		void APIENTRY debugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+			GLsizei /*length*/, const GLchar* message, const void* /*userParam*/)
+		{
+			if (severity == GL_DEBUG_SEVERITY_HIGH || type == GL_DEBUG_TYPE_ERROR) {
+				log::error("OpenGL %s %s [%u]: %s", getSourceName(source), getTypeName(type), id, message);
+			}
+			else {
+				log::warning("OpenGL %s %s [%u]: %s", getSourceName(source), getTypeName(type), id, message);
+			}
+		}
+	}
+
+	bool GLDebug::init()
+	{
+		if (!isEnabled()) {
+			return false;
+		}
+
+		if (!GLAD_GL_KHR_debug) {
+			log::warning("KHR_debug is not supported, only glGetError checks are done");
+			return false;
+		}
+
+		DECLARE_GL_EXT(glEnable)(GL_DEBUG_OUTPUT);
+
+		// Callback is called from the same thread right inside faulty call, so breakpoint in it shows the caller
+		DECLARE_GL_EXT(glEnable)(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+		DECLARE_GL_EXT(glDebugMessageCallback)(debugMessageCallback, nullptr);
+
+		// Notifications (buffer placement, e.t.c.) are too noisy
+		DECLARE_GL_EXT(glDebugMessageControl)(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+
+		log::debug("OpenGL debug output enabled");
+
+		return true;
+	}
+
+	bool GLDebug::checkError(const char* call, const char* file, int line)
+	{
+		bool success = true;
+
+		// Several error flags may be set, loop is bounded in case context is lost
+		for (int i = 0; i < 8; i++) {
+			GLenum error = DECLARE_GL_EXT(glGetError)();
+			if (error == GL_NO_ERROR) {
+				break;
+			}
+			log::error("%s (0x%04X) after %s at %s:%d", getErrorName(error), error, call, file, line);
+			success = false;
+		}
+
+		return success;
+	}
+}
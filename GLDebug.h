@@ -0,0 +1,98 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <atomic>
+
+#include "glad/glad.h"
+
+namespace exa
+{
+	// OpenGL debug layer: KHR_debug message callback and glGetError checks after every exagl* call.
+	// Compiled in only with EXA_GL_DEBUG (see exagl.h), may be switched off at runtime.
+	class GLDebug
+	{
+	public:
+		// Cheap check used by every wrapped call
+		static inline bool isEnabled() {
+			return s_enabled.load(std::memory_order_relaxed);
+		}
+
+		// @note Debug context is requested on window creation, disable before Window::init to get regular context
+		static void setEnabled(bool enabled) {
+			s_enabled.store(enabled, std::memory_order_relaxed);
+		}
+
+		// Installs KHR_debug message callback, must be called with OpenGL context current.
+		// Returns false if debug output is not supported by driver
+		static bool init();
+
+		// Logs all pending OpenGL errors with call site, returns false if there were any
+		static bool checkError(const char* call, const char* file, int line);
+
+	private:
+		static std::atomic<bool> s_enabled;
+	};
+
+	// Calls OpenGL function and checks glGetError after it, created by EXA_GL_CALL
+	template <typename R, typename... Args>
+	class GLCheckedCall
+	{
+	public:
+		using Function = R(APIENTRYP)(Args...);
+
+		GLCheckedCall(Function func, const char* name, const char* file, int line)
+			: m_func(func), m_name(name), m_file(file), m_line(line)
+		{
+		}
+
+		// Arguments are converted at call site exactly as for plain function pointer
+		R operator()(Args... args) const
+		{
+			R result = m_func(args...);
+			if (GLDebug::isEnabled()) {
+				GLDebug::checkError(m_name, m_file, m_line);
+			}
+			return result;
+		}
+
+	private:
+		Function m_func;
+		const char* m_name;
+		const char* m_file;
+		int m_line;
+	};
+
+	template <typename... Args>
+	class GLCheckedCall<void, Args...>
+	{
+	public:
+		using Function = void(APIENTRYP)(Args...);
+
+		GLCheckedCall(Function func, const char* name, const char* file, int line)
+			: m_func(func), m_name(name), m_file(file), m_line(line)
+		{
+		}
+
+		void operator()(Args... args) const
+		{
+			m_func(args...);
+			if (GLDebug::isEnabled()) {
+				GLDebug::checkError(m_name, m_file, m_line);
+			}
+		}
+
+	private:
+		Function m_func;
+		const char* m_name;
+		const char* m_file;
+		int m_line;
+	};
+
+	template <typename R, typename... Args>
+	inline GLCheckedCall<R, Args...> makeGLCheckedCall(R(APIENTRYP func)(Args...), const char* name, const char* file, int line)
+	{
+		return GLCheckedCall<R, Args...>(func, name, file, line);
+	}
+}
@@ -0,0 +1,408 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "exagl.h"
+
+// Calls below go straight to driver, exagl* macros of cached functions lead back here.
+// Errors are attributed to call site of exagl* macro
+#if EXA_GL_DEBUG
+#   define GL_CALL(func) ::exa::makeGLCheckedCall(DECLARE_GL_EXT(func), #func, m_callFile, m_callLine)
+#else
+#   define GL_CALL(func) DECLARE_GL_EXT(func)
+#endif
+
+namespace exa
+{
+	// Out of line definition, std::fill takes it by reference
+	const GLuint GLStateCache::UNKNOWN;
+
+	GLStateCache::GLStateCache()
+		: m_callFile(__FILE__), m_callLine(__LINE__)
+	{
+		invalidate();
+	}
+
+	void GLStateCache::invalidate()
+	{
+		m_program = UNKNOWN;
+		m_vertexArray = UNKNOWN;
+		std::fill(std::begin(m_buffers), std::end(m_buffers), UNKNOWN);
+		m_drawFramebuffer = UNKNOWN;
+		m_readFramebuffer = UNKNOWN;
+		m_renderbuffer = UNKNOWN;
+
+		m_activeTexture = UNKNOWN;
+		for (auto& unit : m_textures) {
+			std::fill(std::begin(unit), std::end(unit), UNKNOWN);
+		}
+
+		std::fill(std::begin(m_capabilities), std::end(m_capabilities), static_cast<int8>(-1));
+
+		m_blendFuncKnown = false;
+		m_blendEquation = 0;
+
+		m_depthFunc = 0;
+		m_depthMask = -1;
+
+		m_viewportKnown = false;
+		m_clearColorKnown = false;
+	}
+
+	int GLStateCache::getBufferTargetIndex(GLenum target)
+	{
+		switch (target) {
+			case GL_ARRAY_BUFFER: return EXA_ARRAY_BUFFER;
+			case GL_ELEMENT_ARRAY_BUFFER: return EXA_ELEMENT_ARRAY_BUFFER;
+			case GL_UNIFORM_BUFFER: return EXA_UNIFORM_BUFFER;
+			case GL_COPY_READ_BUFFER: return EXA_COPY_READ_BUFFER;
+			case GL_COPY_WRITE_BUFFER: return EXA_COPY_WRITE_BUFFER;
+			case GL_PIXEL_PACK_BUFFER: return EXA_PIXEL_PACK_BUFFER;
+			case GL_PIXEL_UNPACK_BUFFER: return EXA_PIXEL_UNPACK_BUFFER;
+			case GL_TEXTURE_BUFFER: return EXA_TEXTURE_BUFFER;
+			case GL_DRAW_INDIRECT_BUFFER: return EXA_DRAW_INDIRECT_BUFFER;
+			default: return -1;
+		}
+	}
+
+	int GLStateCache::getTextureTargetIndex(GLenum target)
+	{
+		switch (target) {
+			case GL_TEXTURE_2D: return EXA_TEXTURE_2D;
+			case GL_TEXTURE_CUBE_MAP: return EXA_TEXTURE_CUBE_MAP;
+			case GL_TEXTURE_2D_ARRAY: return EXA_TEXTURE_2D_ARRAY;
+			case GL_TEXTURE_3D: return EXA_TEXTURE_3D;
+			case GL_TEXTURE_2D_MULTISAMPLE: return EXA_TEXTURE_2D_MULTISAMPLE;
+			case GL_TEXTURE_BUFFER: return EXA_TEXTURE_BUFFER_TARGET;
+			default: return -1;
+		}
+	}
+
+	int GLStateCache::getCapabilityIndex(GLenum capability)
+	{
+		switch (capability) {
+			case GL_BLEND: return EXA_CAP_BLEND;
+			case GL_DEPTH_TEST: return EXA_CAP_DEPTH_TEST;
+			case GL_CULL_FACE: return EXA_CAP_CULL_FACE;
+			case GL_SCISSOR_TEST: return EXA_CAP_SCISSOR_TEST;
+			case GL_STENCIL_TEST: return EXA_CAP_STENCIL_TEST;
+			case GL_MULTISAMPLE: return EXA_CAP_MULTISAMPLE;
+			case GL_FRAMEBUFFER_SRGB: return EXA_CAP_FRAMEBUFFER_SRGB;
+			default: return -1;
+		}
+	}
+
+	void GLStateCache::useProgram(GLuint program)
+	{
+		if (change(m_program != program)) {
+			m_program = program;
+			GL_CALL(glUseProgram)(program);
+		}
+	}
+
+	void GLStateCache::bindVertexArray(GLuint vertexArray)
+	{
+		if (change(m_vertexArray != vertexArray)) {
+			m_vertexArray = vertexArray;
+			m_buffers[EXA_ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+			GL_CALL(glBindVertexArray)(vertexArray);
+		}
+	}
+
+	void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+	{
+		int index = getBufferTargetIndex(target);
+		if (index < 0) {
+			m_stats.issued++;
+			GL_CALL(glBindBuffer)(target, buffer);
+			return;
+		}
+
+		if (change(m_buffers[index] != buffer)) {
+			m_buffers[index] = buffer;
+			GL_CALL(glBindBuffer)(target, buffer);
+		}
+	}
+
+	void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+	{
+		bool changed = false;
+		switch (target) {
+			case GL_FRAMEBUFFER:
+				changed = m_drawFramebuffer != framebuffer || m_readFramebuffer != framebuffer;
+				break;
+			case GL_DRAW_FRAMEBUFFER:
+				changed = m_drawFramebuffer != framebuffer;
+				break;
+			case GL_READ_FRAMEBUFFER:
+				changed = m_readFramebuffer != framebuffer;
+				break;
+			default:
+				changed = true;
+				break;
+		}
+
+		if (!change(changed)) {
+			return;
+		}
+
+		if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER) {
+			m_drawFramebuffer = framebuffer;
+		}
+		if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER) {
+			m_readFramebuffer = framebuffer;
+		}
+		GL_CALL(glBindFramebuffer)(target, framebuffer);
+	}
+
+	void GLStateCache::bindRenderbuffer(GLenum target, GLuint renderbuffer)
+	{
+		if (change(m_renderbuffer != renderbuffer)) {
+			m_renderbuffer = renderbuffer;
+			GL_CALL(glBindRenderbuffer)(target, renderbuffer);
+		}
+	}
+
+	void GLStateCache::activeTexture(GLenum unit)
+	{
+		const GLuint index = unit - GL_TEXTURE0;
+		if (change(m_activeTexture != index)) {
+			m_activeTexture = index;
+			GL_CALL(glActiveTexture)(unit);
+		}
+	}
+
+	void GLStateCache::bindTexture(GLenum target, GLuint texture)
+	{
+		int index = getTextureTargetIndex(target);
+		if (index < 0 || m_activeTexture >= MAX_TEXTURE_UNITS) {
+			m_stats.issued++;
+			GL_CALL(glBindTexture)(target, texture);
+			return;
+		}
+
+		GLuint& bound = m_textures[m_activeTexture][index];
+		if (change(bound != texture)) {
+			bound = texture;
+			GL_CALL(glBindTexture)(target, texture);
+		}
+	}
+
+	void GLStateCache::setCapability(GLenum capability, bool enabled)
+	{
+		int index = getCapabilityIndex(capability);
+		const int8 value = enabled ? 1 : 0;
+
+		if (index >= 0 && !change(m_capabilities[index] != value)) {
+			return;
+		}
+
+		if (index >= 0) {
+			m_capabilities[index] = value;
+		}
+		else {
+			m_stats.issued++;
+		}
+
+		if (enabled) {
+			GL_CALL(glEnable)(capability);
+		}
+		else {
+			GL_CALL(glDisable)(capability);
+		}
+	}
+
+	void GLStateCache::enable(GLenum capability)
+	{
+		setCapability(capability, true);
+	}
+
+	void GLStateCache::disable(GLenum capability)
+	{
+		setCapability(capability, false);
+	}
+
+	void GLStateCache::blendFunc(GLenum sourceFactor, GLenum destinationFactor)
+	{
+		blendFuncSeparate(sourceFactor, destinationFactor, sourceFactor, destinationFactor);
+	}
+
+	void GLStateCache::blendFuncSeparate(GLenum sourceRgb, GLenum destinationRgb, GLenum sourceAlpha, GLenum destinationAlpha)
+	{
+		const bool changed = !m_blendFuncKnown ||
+			m_blendFunc[0] != sourceRgb || m_blendFunc[1] != destinationRgb ||
+			m_blendFunc[2] != sourceAlpha || m_blendFunc[3] != destinationAlpha;
+
+		if (change(changed)) {
+			m_blendFuncKnown = true;
+			m_blendFunc[0] = sourceRgb;
+			m_blendFunc[1] = destinationRgb;
+			m_blendFunc[2] = sourceAlpha;
+			m_blendFunc[3] = destinationAlpha;
+			GL_CALL(glBlendFuncSeparate)(sourceRgb, destinationRgb, sourceAlpha, destinationAlpha);
+		}
+	}
+
+	void GLStateCache::blendEquation(GLenum mode)
+	{
+		if (change(m_blendEquation != mode)) {
+			m_blendEquation = mode;
+			GL_CALL(glBlendEquation)(mode);
+		}
+	}
+
+	void GLStateCache::depthFunc(GLenum func)
+	{
+		if (change(m_depthFunc != func)) {
+			m_depthFunc = func;
+			GL_CALL(glDepthFunc)(func);
+		}
+	}
+
+	void GLStateCache::depthMask(GLboolean flag)
+	{
+		const int8 value = flag ? 1 : 0;
+		if (change(m_depthMask != value)) {
+			m_depthMask = value;
+			GL_CALL(glDepthMask)(flag);
+		}
+	}
+
+	void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		const bool changed = !m_viewportKnown ||
+			m_viewport[0] != x || m_viewport[1] != y || m_viewport[2] != width || m_viewport[3] != height;
+
+		if (change(changed)) {
+			m_viewportKnown = true;
+			m_viewport[0] = x;
+			m_viewport[1] = y;
+			m_viewport[2] = width;
+			m_viewport[3] = height;
+			GL_CALL(glViewport)(x, y, width, height);
+		}
+	}
+
+	void GLStateCache::clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+	{
+		const bool changed = !m_clearColorKnown ||
+			m_clearColor[0] != red || m_clearColor[1] != green || m_clearColor[2] != blue || m_clearColor[3] != alpha;
+
+		if (change(changed)) {
+			m_clearColorKnown = true;
+			m_clearColor[0] = red;
+			m_clearColor[1] = green;
+			m_clearColor[2] = blue;
+			m_clearColor[3] = alpha;
+			GL_CALL(glClearColor)(red, green, blue, alpha);
+		}
+	}
+
+	void GLStateCache::deleteProgram(GLuint program)
+	{
+		// Program in use is deleted only after it is unbound, but treat it as unknown anyway
+		if (program != 0 && m_program == program) {
+			m_program = UNKNOWN;
+		}
+		m_stats.issued++;
+		GL_CALL(glDeleteProgram)(program);
+	}
+
+	void GLStateCache::deleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+	{
+		for (GLsizei i = 0; i < count; i++) {
+			if (vertexArrays[i] != 0 && m_vertexArray == vertexArrays[i]) {
+				m_vertexArray = 0;
+				m_buffers[EXA_ELEMENT_ARRAY_BUFFER] = UNKNOWN;
+			}
+		}
+		m_stats.issued++;
+		GL_CALL(glDeleteVertexArrays)(count, vertexArrays);
+	}
+
+	void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		int targetIndex = getBufferTargetIndex(target);
+		if (targetIndex >= 0) {
+			m_buffers[targetIndex] = buffer;
+		}
+		m_stats.issued++;
+		GL_CALL(glBindBufferBase)(target, index, buffer);
+	}
+
+	void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		int targetIndex = getBufferTargetIndex(target);
+		if (targetIndex >= 0) {
+			m_buffers[targetIndex] = buffer;
+		}
+		m_stats.issued++;
+		GL_CALL(glBindBufferRange)(target, index, buffer, offset, size);
+	}
+
+	void GLStateCache::deleteBuffers(GLsizei count, const GLuint* buffers)
+	{
+		for (GLsizei i = 0; i < count; i++) {
+			if (buffers[i] == 0) {
+				continue;
+			}
+			for (auto& bound : m_buffers) {
+				if (bound == buffers[i]) {
+					bound = 0;
+				}
+			}
+		}
+		m_stats.issued++;
+		GL_CALL(glDeleteBuffers)(count, buffers);
+	}
+
+	void GLStateCache::deleteTextures(GLsizei count, const GLuint* textures)
+	{
+		for (GLsizei i = 0; i < count; i++) {
+			if (textures[i] == 0) {
+				continue;
+			}
+			for (auto& unit : m_textures) {
+				for (auto& bound : unit) {
+					if (bound == textures[i]) {
+						bound = 0;
+					}
+				}
+			}
+		}
+		m_stats.issued++;
+		GL_CALL(glDeleteTextures)(count, textures);
+	}
+
+	void GLStateCache::deleteFramebuffers(GLsizei count, const GLuint* framebuffers)
+	{
+		for (GLsizei i = 0; i < count; i++) {
+			if (framebuffers[i] == 0) {
+				continue;
+			}
+			if (m_drawFramebuffer == framebuffers[i]) {
+				m_drawFramebuffer = 0;
+			}
+			if (m_readFramebuffer == framebuffers[i]) {
+				m_readFramebuffer = 0;
+			}
+		}
+		m_stats.issued++;
+		GL_CALL(glDeleteFramebuffers)(count, framebuffers);
+	}
+
+	void GLStateCache::deleteRenderbuffers(GLsizei count, const GLuint* renderbuffers)
+	{
+		for (GLsizei i = 0; i < count; i++) {
+			if (renderbuffers[i] != 0 && m_renderbuffer == renderbuffers[i]) {
+				m_renderbuffer = 0;
+			}
+		}
+		m_stats.issued++;
+		GL_CALL(glDeleteRenderbuffers)(count, renderbuffers);
+	}
+}
@@ -0,0 +1,212 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include "glad/glad.h"
+
+#include "Types.h"
+
+#define GLSTATE() ::exa::GLStateCache::Instance()
+
+namespace exa
+{
+	struct GLStateStats
+	{
+		// Calls passed to driver
+		uint64 issued = 0;
+		// Calls dropped because state was already set
+		uint64 skipped = 0;
+	};
+
+	// Shadow copy of OpenGL context state. Cached exagl* calls (see exagl.h) are routed here
+	// and dropped when they would not change anything.
+	// @note Must be used only by thread owning OpenGL context. Code changing state bypassing exagl* macros must call invalidate()
+	class GLStateCache
+	{
+	public:
+		static const uint32 MAX_TEXTURE_UNITS = 32;
+
+		// Singleton in Lazy-thread-safe style.
+		static GLStateCache& Instance()
+		{
+			static GLStateCache s;
+			return s;
+		}
+
+		// Forgets all shadowed state, next call of every kind reaches driver
+		void invalidate();
+
+		// Remembers source location of exagl* call being forwarded, see EXA_GL_STATE_CALL in exagl.h
+		GLStateCache& setCallSite(const char* file, int line) {
+			m_callFile = file;
+			m_callLine = line;
+			return *this;
+		}
+
+		void useProgram(GLuint program);
+
+		// Element array buffer binding is part of vertex array state and is forgotten on change
+		void bindVertexArray(GLuint vertexArray);
+
+		void bindBuffer(GLenum target, GLuint buffer);
+
+		// Indexed bindings are not shadowed, but these calls also bind generic target
+		void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+		void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+		// GL_FRAMEBUFFER sets both draw and read bindings
+		void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+		void bindRenderbuffer(GLenum target, GLuint renderbuffer);
+
+		void activeTexture(GLenum unit);
+
+		// Binds to active texture unit
+		void bindTexture(GLenum target, GLuint texture);
+
+		void enable(GLenum capability);
+
+		void disable(GLenum capability);
+
+		void blendFunc(GLenum sourceFactor, GLenum destinationFactor);
+
+		void blendFuncSeparate(GLenum sourceRgb, GLenum destinationRgb, GLenum sourceAlpha, GLenum destinationAlpha);
+
+		void blendEquation(GLenum mode);
+
+		void depthFunc(GLenum func);
+
+		void depthMask(GLboolean flag);
+
+		void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+		void clearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+
+		// Deleted objects are unbound by driver, shadowed bindings are reset accordingly
+		void deleteProgram(GLuint program);
+
+		void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+
+		void deleteBuffers(GLsizei count, const GLuint* buffers);
+
+		void deleteTextures(GLsizei count, const GLuint* textures);
+
+		void deleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+
+		void deleteRenderbuffers(GLsizei count, const GLuint* renderbuffers);
+
+		const GLStateStats& getStats() const {
+			return m_stats;
+		}
+
+		void resetStats() {
+			m_stats = GLStateStats();
+		}
+
+	private:
+		GLStateCache();
+		~GLStateCache() {}
+
+		GLStateCache(GLStateCache const&) = delete;
+		GLStateCache& operator= (GLStateCache const&) = delete;
+
+		// Value never returned by glGen*, marks binding as unknown
+		static const GLuint UNKNOWN = ~0u;
+
+		enum BufferTarget : int8
+		{
+			EXA_ARRAY_BUFFER,
+			EXA_ELEMENT_ARRAY_BUFFER,
+			EXA_UNIFORM_BUFFER,
+			EXA_COPY_READ_BUFFER,
+			EXA_COPY_WRITE_BUFFER,
+			EXA_PIXEL_PACK_BUFFER,
+			EXA_PIXEL_UNPACK_BUFFER,
+			EXA_TEXTURE_BUFFER,
+			EXA_DRAW_INDIRECT_BUFFER,
+			EXA_BUFFER_TARGETS
+		};
+
+		enum TextureTarget : int8
+		{
+			EXA_TEXTURE_2D,
+			EXA_TEXTURE_CUBE_MAP,
+			EXA_TEXTURE_2D_ARRAY,
+			EXA_TEXTURE_3D,
+			EXA_TEXTURE_2D_MULTISAMPLE,
+			EXA_TEXTURE_BUFFER_TARGET,
+			EXA_TEXTURE_TARGETS
+		};
+
+		enum Capability : int8
+		{
+			EXA_CAP_BLEND,
+			EXA_CAP_DEPTH_TEST,
+			EXA_CAP_CULL_FACE,
+			EXA_CAP_SCISSOR_TEST,
+			EXA_CAP_STENCIL_TEST,
+			EXA_CAP_MULTISAMPLE,
+			EXA_CAP_FRAMEBUFFER_SRGB,
+			EXA_CAPABILITIES
+		};
+
+		// Returns -1 for targets not tracked by cache
+		static int getBufferTargetIndex(GLenum target);
+
+		static int getTextureTargetIndex(GLenum target);
+
+		static int getCapabilityIndex(GLenum capability);
+
+		void setCapability(GLenum capability, bool enabled);
+
+		// Returns true if call must be issued, updates counters
+		bool change(bool changed) {
+			if (changed) {
+				m_stats.issued++;
+			}
+			else {
+				m_stats.skipped++;
+			}
+			return changed;
+		}
+
+		GLuint m_program;
+		GLuint m_vertexArray;
+		GLuint m_buffers[EXA_BUFFER_TARGETS];
+		GLuint m_drawFramebuffer;
+		GLuint m_readFramebuffer;
+		GLuint m_renderbuffer;
+
+		// Index of active unit, UNKNOWN if not known
+		GLuint m_activeTexture;
+		GLuint m_textures[MAX_TEXTURE_UNITS][EXA_TEXTURE_TARGETS];
+
+		// -1 unknown, 0 disabled, 1 enabled
+		int8 m_capabilities[EXA_CAPABILITIES];
+
+		// GL_ZERO is valid blend factor, so known flag is needed
+		bool m_blendFuncKnown;
+		GLenum m_blendFunc[4];
+		// Zero if unknown
+		GLenum m_blendEquation;
+
+		// Zero if unknown
+		GLenum m_depthFunc;
+		// -1 unknown, 0 disabled, 1 enabled
+		int8 m_depthMask;
+
+		bool m_viewportKnown;
+		GLint m_viewport[4];
+
+		bool m_clearColorKnown;
+		GLfloat m_clearColor[4];
+
+		GLStateStats m_stats;
+
+		// Reported by debug layer for errors of forwarded calls
+		const char* m_callFile;
+		int m_callLine;
+	};
+}
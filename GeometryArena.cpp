@@ -0,0 +1,283 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "Log.h"
+#include "Profiler.h"
+#include "RenderCommandBuffer.h"
+#include "VertexArray.h"
+
+namespace exa
+{
+	namespace
+	{
+		// Uploads and copies don't touch GL_ELEMENT_ARRAY_BUFFER, its binding is state of bound vertex array
+		const GLenum UPLOAD_TARGET = GL_COPY_WRITE_BUFFER;
+		const GLenum COPY_SOURCE_TARGET = GL_COPY_READ_BUFFER;
+
+		const uint32 MAX_CAPACITY = std::numeric_limits<int32>::max();
+
+		uint32 grow(uint32 capacity, uint32 required)
+		{
+			const uint64 doubled = static_cast<uint64>(capacity) * 2;
+			return static_cast<uint32>(std::min<uint64>(std::max<uint64>(doubled, required), MAX_CAPACITY));
+		}
+
+		GLuint createBuffer(size_t size)
+		{
+			GLuint buffer = 0;
+			exaglGenBuffers(1, &buffer);
+			exaglBindBuffer(UPLOAD_TARGET, buffer);
+			exaglBufferData(UPLOAD_TARGET, static_cast<GLsizeiptr>(size), nullptr, GL_STATIC_DRAW);
+			return buffer;
+		}
+
+		float fragmentation(const OffsetAllocator& allocator)
+		{
+			const uint32 free = allocator.getFree();
+			if (free == 0) {
+				return 0.0f;
+			}
+			return 1.0f - static_cast<float>(allocator.getLargestFree()) / free;
+		}
+	}
+
+	GeometryArena::GeometryArena(GLsizei vertexStride, ApplyLayout applyLayout, uint32 vertexCapacity, uint32 indexCapacity, GLenum indexType)
+		: m_vertexStride(vertexStride)
+		, m_applyLayout(applyLayout)
+		, m_indexType(indexType)
+		, m_vertexAllocator(0)
+		, m_indexAllocator(0)
+	{
+		m_vertexArray = exanew VertexArray();
+		relocate(std::min(vertexCapacity, MAX_CAPACITY), std::min(indexCapacity, MAX_CAPACITY));
+	}
+
+	GeometryArena::~GeometryArena()
+	{
+		SafeDelete(m_vertexArray);
+		exaglDeleteBuffers(1, &m_vertexBuffer);
+		exaglDeleteBuffers(1, &m_indexBuffer);
+	}
+
+	void GeometryArena::setupVertexArray()
+	{
+		m_vertexArray->bind();
+		exaglBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+		m_applyLayout(0, 0);
+		exaglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+		m_vertexArray->unbind();
+	}
+
+	void GeometryArena::updateRange(Mesh& mesh)
+	{
+		mesh.range.indexOffset = mesh.indices.offset * getIndexSize();
+		mesh.range.baseVertex = static_cast<GLint>(mesh.vertices.offset);
+	}
+
+	void GeometryArena::relocate(uint32 vertexCapacity, uint32 indexCapacity)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		const GLuint oldVertexBuffer = m_vertexBuffer;
+		const GLuint oldIndexBuffer = m_indexBuffer;
+
+		m_vertexBuffer = createBuffer(static_cast<size_t>(vertexCapacity) * m_vertexStride);
+		m_indexBuffer = createBuffer(static_cast<size_t>(indexCapacity) * getIndexSize());
+
+		m_vertexAllocator.reset(vertexCapacity);
+		m_indexAllocator.reset(indexCapacity);
+
+		std::vector<Handle> live;
+		live.reserve(m_meshCount);
+		for (Handle handle = 0; handle < m_meshes.size(); handle++) {
+			if (m_meshes[handle].used) {
+				live.push_back(handle);
+			}
+		}
+
+		// Allocating in address order into empty allocator packs meshes without holes
+		std::sort(live.begin(), live.end(), [this](Handle a, Handle b) {
+			return m_meshes[a].vertices.offset < m_meshes[b].vertices.offset;
+		});
+
+		exaglBindBuffer(COPY_SOURCE_TARGET, oldVertexBuffer);
+		exaglBindBuffer(UPLOAD_TARGET, m_vertexBuffer);
+		for (Handle handle : live) {
+			Mesh& mesh = m_meshes[handle];
+			const OffsetAllocation allocation = m_vertexAllocator.allocate(mesh.range.vertexCount);
+			exaglCopyBufferSubData(COPY_SOURCE_TARGET, UPLOAD_TARGET,
+				static_cast<GLintptr>(mesh.vertices.offset) * m_vertexStride,
+				static_cast<GLintptr>(allocation.offset) * m_vertexStride,
+				static_cast<GLsizeiptr>(mesh.range.vertexCount) * m_vertexStride);
+			mesh.vertices = allocation;
+		}
+
+		std::sort(live.begin(), live.end(), [this](Handle a, Handle b) {
+			return m_meshes[a].indices.offset < m_meshes[b].indices.offset;
+		});
+
+		const GLsizeiptr indexSize = static_cast<GLsizeiptr>(getIndexSize());
+
+		exaglBindBuffer(COPY_SOURCE_TARGET, oldIndexBuffer);
+		exaglBindBuffer(UPLOAD_TARGET, m_indexBuffer);
+		for (Handle handle : live) {
+			Mesh& mesh = m_meshes[handle];
+			const OffsetAllocation allocation = m_indexAllocator.allocate(mesh.range.indexCount);
+			exaglCopyBufferSubData(COPY_SOURCE_TARGET, UPLOAD_TARGET,
+				static_cast<GLintptr>(mesh.indices.offset) * indexSize,
+				static_cast<GLintptr>(allocation.offset) * indexSize,
+				static_cast<GLsizeiptr>(mesh.range.indexCount) * indexSize);
+			mesh.indices = allocation;
+
+			updateRange(mesh);
+		}
+
+		if (oldVertexBuffer != 0) {
+			exaglDeleteBuffers(1, &oldVertexBuffer);
+			exaglDeleteBuffers(1, &oldIndexBuffer);
+			m_generation++;
+		}
+
+		setupVertexArray();
+
+		log::debug("Geometry arena: %u meshes, %u/%u vertices, %u/%u indices",
+			m_meshCount, m_vertexAllocator.getUsed(), vertexCapacity, m_indexAllocator.getUsed(), indexCapacity);
+	}
+
+	bool GeometryArena::reserve(uint32 vertexCount, uint32 indexCount)
+	{
+		const bool verticesFit = m_vertexAllocator.getLargestFree() >= vertexCount;
+		const bool indicesFit = m_indexAllocator.getLargestFree() >= indexCount;
+		if (verticesFit && indicesFit) {
+			return true;
+		}
+
+		const uint64 requiredVertices = static_cast<uint64>(m_vertexAllocator.getUsed()) + vertexCount;
+		const uint64 requiredIndices = static_cast<uint64>(m_indexAllocator.getUsed()) + indexCount;
+		if (requiredVertices > MAX_CAPACITY || requiredIndices > MAX_CAPACITY) {
+			return false;
+		}
+
+		// Compacting is enough if free space is only fragmented
+		uint32 vertexCapacity = m_vertexAllocator.getSize();
+		uint32 indexCapacity = m_indexAllocator.getSize();
+		if (requiredVertices > vertexCapacity) {
+			vertexCapacity = grow(vertexCapacity, static_cast<uint32>(requiredVertices));
+		}
+		if (requiredIndices > indexCapacity) {
+			indexCapacity = grow(indexCapacity, static_cast<uint32>(requiredIndices));
+		}
+
+		relocate(vertexCapacity, indexCapacity);
+		return true;
+	}
+
+	GeometryArena::Handle GeometryArena::add(const void* vertices, uint32 vertexCount, const uint32* indices, uint32 indexCount)
+	{
+		if (vertexCount == 0 || indexCount == 0) {
+			log::warning("Adding empty mesh to geometry arena");
+			return INVALID_HANDLE;
+		}
+
+		if (m_indexType == GL_UNSIGNED_SHORT && vertexCount > std::numeric_limits<uint16>::max() + 1u) {
+			log::error("Mesh of %u vertices doesn't fit 16 bit indices of geometry arena", vertexCount);
+			return INVALID_HANDLE;
+		}
+
+		if (!reserve(vertexCount, indexCount)) {
+			log::error("Geometry arena can't hold %u more vertices and %u more indices", vertexCount, indexCount);
+			return INVALID_HANDLE;
+		}
+
+		Mesh mesh;
+		mesh.vertices = m_vertexAllocator.allocate(vertexCount);
+		mesh.indices = m_indexAllocator.allocate(indexCount);
+		mesh.range.vertexCount = vertexCount;
+		mesh.range.indexCount = indexCount;
+		mesh.used = true;
+		updateRange(mesh);
+
+		exaglBindBuffer(UPLOAD_TARGET, m_vertexBuffer);
+		exaglBufferSubData(UPLOAD_TARGET, static_cast<GLintptr>(mesh.vertices.offset) * m_vertexStride,
+			static_cast<GLsizeiptr>(vertexCount) * m_vertexStride, vertices);
+
+		const void* indexData = indices;
+		if (m_indexType == GL_UNSIGNED_SHORT) {
+			m_indices16.assign(indices, indices + indexCount);
+			indexData = m_indices16.data();
+		}
+
+		exaglBindBuffer(UPLOAD_TARGET, m_indexBuffer);
+		exaglBufferSubData(UPLOAD_TARGET, static_cast<GLintptr>(mesh.range.indexOffset),
+			static_cast<GLsizeiptr>(indexCount * getIndexSize()), indexData);
+
+		Handle handle = INVALID_HANDLE;
+		if (!m_freeHandles.empty()) {
+			handle = m_freeHandles.back();
+			m_freeHandles.pop_back();
+			m_meshes[handle] = mesh;
+		}
+		else {
+			handle = static_cast<Handle>(m_meshes.size());
+			m_meshes.push_back(mesh);
+		}
+
+		m_meshCount++;
+		return handle;
+	}
+
+	void GeometryArena::remove(Handle handle)
+	{
+		if (!isValid(handle)) {
+			log::warning("Removing invalid mesh %u from geometry arena", handle);
+			return;
+		}
+
+		Mesh& mesh = m_meshes[handle];
+		m_vertexAllocator.free(mesh.vertices);
+		m_indexAllocator.free(mesh.indices);
+		mesh = Mesh();
+
+		m_freeHandles.push_back(handle);
+		m_meshCount--;
+	}
+
+	void GeometryArena::defragment()
+	{
+		relocate(m_vertexAllocator.getSize(), m_indexAllocator.getSize());
+	}
+
+	float GeometryArena::getFragmentation() const
+	{
+		return std::max(fragmentation(m_vertexAllocator), fragmentation(m_indexAllocator));
+	}
+
+	void GeometryArena::bind()
+	{
+		m_vertexArray->bind();
+	}
+
+	void GeometryArena::draw(Handle handle, GLenum mode)
+	{
+		const GeometryRange& range = m_meshes[handle].range;
+		exaglDrawElementsBaseVertex(mode, static_cast<GLsizei>(range.indexCount), m_indexType,
+			reinterpret_cast<const GLvoid*>(range.indexOffset), range.baseVertex);
+	}
+
+	void GeometryArena::draw(RenderCommandBuffer& commands, Handle handle, GLenum mode) const
+	{
+		const GeometryRange& range = m_meshes[handle].range;
+		commands.drawElementsBaseVertex(mode, static_cast<GLsizei>(range.indexCount), m_indexType, range.indexOffset, range.baseVertex);
+	}
+
+	void GeometryArena::drawInstanced(RenderCommandBuffer& commands, Handle handle, GLsizei instanceCount, GLenum mode) const
+	{
+		const GeometryRange& range = m_meshes[handle].range;
+		commands.drawElementsInstanced(mode, static_cast<GLsizei>(range.indexCount), m_indexType, range.indexOffset, instanceCount, range.baseVertex);
+	}
+}
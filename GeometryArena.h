@@ -0,0 +1,167 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "exa.h"
+#include "Memory.h"
+#include "OffsetAllocator.h"
+#include "RenderPlatforms.h"
+
+namespace exa
+{
+	class RenderCommandBuffer;
+	class VertexArray;
+
+	// Arguments of glDrawElementsBaseVertex for one mesh of arena
+	struct GeometryRange
+	{
+		uint32 indexCount = 0;
+		// Bytes from start of arena index buffer
+		size_t indexOffset = 0;
+		// Added to every index, meshes keep indices relative to their first vertex
+		GLint baseVertex = 0;
+		uint32 vertexCount = 0;
+	};
+
+	// Vertices and indices of many meshes of one vertex format in one vertex buffer and one index buffer,
+	// sub-allocated by OffsetAllocator. All meshes are drawn through single vertex array, so switching
+	// mesh is only a different draw call.
+	// Buffers grow when full; defragment compacts live meshes, which changes their ranges.
+	//
+	// GeometryArena* arena = GeometryArena::create<CookedVertexLayout>(1 << 20, 3 << 20);
+	// GeometryArena::Handle mesh = arena->add(vertices.data(), vertexCount, indices.data(), indexCount);
+	// arena->bind();
+	// arena->draw(mesh);
+	//
+	// @note Attributes get locations in layout order, shaders need layout(location = N) inputs.
+	//		 Must be used on thread owning OpenGL context
+	class GeometryArena
+	{
+	public:
+		using Handle = uint32;
+		static const Handle INVALID_HANDLE = ~0u;
+
+		// VertexLayout::applyLocations of arena format
+		using ApplyLayout = void(*)(GLuint firstLocation, size_t baseOffset);
+
+		// @param indexType GL_UNSIGNED_SHORT halves index memory, meshes are then limited to 65536 vertices
+		GeometryArena(GLsizei vertexStride, ApplyLayout applyLayout, uint32 vertexCapacity, uint32 indexCapacity,
+			GLenum indexType = GL_UNSIGNED_INT);
+		~GeometryArena();
+
+		template <class Layout>
+		static GeometryArena* create(uint32 vertexCapacity, uint32 indexCapacity, GLenum indexType = GL_UNSIGNED_INT)
+		{
+			return exanew GeometryArena(Layout::stride(), &Layout::applyLocations, vertexCapacity, indexCapacity, indexType);
+		}
+
+		// Copies mesh to arena, indices are relative to first vertex of mesh.
+		// Returns INVALID_HANDLE if mesh doesn't fit index type
+		Handle add(const void* vertices, uint32 vertexCount, const uint32* indices, uint32 indexCount);
+
+		template <typename Vertex>
+		Handle add(const std::vector<Vertex>& vertices, const std::vector<uint32>& indices)
+		{
+			return add(vertices.data(), static_cast<uint32>(vertices.size()), indices.data(), static_cast<uint32>(indices.size()));
+		}
+
+		// Frees space of mesh, handle may be reused by next add
+		void remove(Handle handle);
+
+		bool isValid(Handle handle) const {
+			return handle < m_meshes.size() && m_meshes[handle].used;
+		}
+
+		// @note Valid until next add, remove or defragment
+		const GeometryRange& getRange(Handle handle) const {
+			return m_meshes[handle].range;
+		}
+
+		// Moves all meshes to start of buffers, removing holes left by removed meshes
+		void defragment();
+
+		// Share of free space not usable by single allocation, 0 means no fragmentation
+		float getFragmentation() const;
+
+		void bind();
+
+		void draw(Handle handle, GLenum mode = GL_TRIANGLES);
+
+		void draw(RenderCommandBuffer& commands, Handle handle, GLenum mode = GL_TRIANGLES) const;
+
+		// Instance attributes are added to getVertexArray() by VertexArray::setInstanceLayout
+		void drawInstanced(RenderCommandBuffer& commands, Handle handle, GLsizei instanceCount, GLenum mode = GL_TRIANGLES) const;
+
+		VertexArray* getVertexArray() const {
+			return m_vertexArray;
+		}
+
+		GLenum getIndexType() const {
+			return m_indexType;
+		}
+
+		uint32 getMeshCount() const {
+			return m_meshCount;
+		}
+
+		// Incremented when mesh ranges move (defragment or growth), cached ranges must be refreshed
+		uint32 getGeneration() const {
+			return m_generation;
+		}
+
+		const OffsetAllocator& getVertexAllocator() const {
+			return m_vertexAllocator;
+		}
+
+		const OffsetAllocator& getIndexAllocator() const {
+			return m_indexAllocator;
+		}
+
+	private:
+		struct Mesh
+		{
+			OffsetAllocation vertices;
+			OffsetAllocation indices;
+			GeometryRange range;
+			bool used = false;
+		};
+
+		size_t getIndexSize() const {
+			return m_indexType == GL_UNSIGNED_SHORT ? sizeof(uint16) : sizeof(uint32);
+		}
+
+		void updateRange(Mesh& mesh);
+
+		// Recreates buffers with given capacity and copies live meshes to them, packed in current order
+		void relocate(uint32 vertexCapacity, uint32 indexCapacity);
+
+		// Makes room for mesh by defragmenting or growing
+		bool reserve(uint32 vertexCount, uint32 indexCount);
+
+		// Points vertex array to current buffers
+		void setupVertexArray();
+
+		GLsizei m_vertexStride = 0;
+		ApplyLayout m_applyLayout = nullptr;
+		GLenum m_indexType = GL_UNSIGNED_INT;
+
+		GLuint m_vertexBuffer = 0;
+		GLuint m_indexBuffer = 0;
+		VertexArray* m_vertexArray = nullptr;
+
+		OffsetAllocator m_vertexAllocator;
+		OffsetAllocator m_indexAllocator;
+
+		std::vector<Mesh> m_meshes;
+		std::vector<Handle> m_freeHandles;
+		uint32 m_meshCount = 0;
+
+		uint32 m_generation = 0;
+
+		// Conversion buffer for 16 bit indices
+		std::vector<uint16> m_indices16;
+	};
+}
@@ -0,0 +1,37 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <cstddef>
+
+#include "Types.h"
+
+namespace exa
+{
+	// FNV-1a, fast non-cryptographic hash for names and cache keys
+	const uint32 FNV1A32_OFFSET = 2166136261u;
+	const uint32 FNV1A32_PRIME = 16777619u;
+	const uint64 FNV1A64_OFFSET = 14695981039346656037ull;
+	const uint64 FNV1A64_PRIME = 1099511628211ull;
+
+	inline uint32 hashFnv1a32(const char* string, uint32 hash = FNV1A32_OFFSET)
+	{
+		for (; *string != '\0'; string++) {
+			hash ^= static_cast<unsigned char>(*string);
+			hash *= FNV1A32_PRIME;
+		}
+		return hash;
+	}
+
+	// Pass previous result as hash to continue hashing (several strings, e.t.c.)
+	inline uint64 hashFnv1a64(const void* data, size_t size, uint64 hash = FNV1A64_OFFSET)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= FNV1A64_PRIME;
+		}
+		return hash;
+	}
+}
@@ -0,0 +1,57 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "IndexBuffer.h"
+
+#include <algorithm>
+
+namespace exa
+{
+	IndexBuffer::IndexBuffer()
+	{
+		exaglGenBuffers(1, &m_IBO);
+	}
+
+	IndexBuffer::~IndexBuffer()
+	{
+		exaglDeleteBuffers(1, &m_IBO);
+	}
+
+	void IndexBuffer::upload(const void* data, size_t size, GLuint usage)
+	{
+		bind();
+
+		exaglBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, usage);
+	}
+
+	void IndexBuffer::setData(const uint16* indices, size_t count, GLuint usage)
+	{
+		m_type = GL_UNSIGNED_SHORT;
+		m_count = static_cast<GLsizei>(count);
+		upload(indices, count * sizeof(uint16), usage);
+	}
+
+	void IndexBuffer::setData(const uint32* indices, size_t count, GLuint usage)
+	{
+		m_type = GL_UNSIGNED_INT;
+		m_count = static_cast<GLsizei>(count);
+		upload(indices, count * sizeof(uint32), usage);
+	}
+
+	void IndexBuffer::setData(const std::vector<uint32>& indices, GLuint usage)
+	{
+		const uint32 maxIndex = indices.empty() ? 0 : *std::max_element(indices.begin(), indices.end());
+		if (maxIndex > 0xFFFF) {
+			setData(indices.data(), indices.size(), usage);
+			return;
+		}
+
+		std::vector<uint16> shortIndices(indices.begin(), indices.end());
+		setData(shortIndices.data(), shortIndices.size(), usage);
+	}
+
+	void IndexBuffer::bind()
+	{
+		exaglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBO);
+	}
+}
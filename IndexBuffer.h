@@ -0,0 +1,52 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "RenderPlatforms.h"
+#include "Types.h"
+
+namespace exa
+{
+	// Element array buffer with 16 or 32 bit indices.
+	// @note Binding is part of vertex array state, vertex array must be bound before bind or setData
+	class IndexBuffer
+	{
+	private:
+
+	public:
+
+		IndexBuffer();
+		~IndexBuffer();
+
+		void setData(const uint16* indices, size_t count, GLuint usage);
+		void setData(const uint32* indices, size_t count, GLuint usage);
+
+		// Stored as 16 bit indices if all of them fit, halving index fetch bandwidth
+		void setData(const std::vector<uint32>& indices, GLuint usage);
+
+		void bind();
+
+		// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, argument of glDrawElements
+		GLenum getType() const {
+			return m_type;
+		}
+
+		GLsizei getCount() const {
+			return m_count;
+		}
+
+		size_t getIndexSize() const {
+			return m_type == GL_UNSIGNED_SHORT ? sizeof(uint16) : sizeof(uint32);
+		}
+
+	private:
+		void upload(const void* data, size_t size, GLuint usage);
+
+		GLuint m_IBO = 0;
+		GLenum m_type = GL_UNSIGNED_SHORT;
+		GLsizei m_count = 0;
+	};
+}
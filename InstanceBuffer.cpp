@@ -0,0 +1,61 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "InstanceBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glm/gtc/packing.hpp>
+
+namespace exa
+{
+	InstanceData InstanceData::pack(const glm::mat4& transform, const glm::vec4& color, const glm::vec4& uvRect)
+	{
+		const glm::mat4x3 affine(transform);
+
+		InstanceData instance;
+		memcpy(instance.Transform, &affine[0][0], sizeof(instance.Transform));
+		instance.Color = glm::packUnorm4x8(color);
+
+		const glm::u16vec4 packedUvRect = glm::packUnorm<uint16>(uvRect);
+		for (int i = 0; i < 4; i++) {
+			instance.UvRect[i] = packedUvRect[i];
+		}
+		return instance;
+	}
+
+	InstanceBuffer::InstanceBuffer()
+	{
+		exaglGenBuffers(1, &m_buffer);
+	}
+
+	InstanceBuffer::~InstanceBuffer()
+	{
+		exaglDeleteBuffers(1, &m_buffer);
+	}
+
+	void InstanceBuffer::setData(const void* instances, uint32 count, size_t stride)
+	{
+		const size_t size = count * stride;
+
+		bind();
+
+		// Grows by doubling, so buffer size settles after few frames
+		if (size > m_capacity) {
+			m_capacity = std::max(size, m_capacity * 2);
+		}
+
+		exaglBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_capacity), nullptr, GL_STREAM_DRAW);
+		if (size > 0) {
+			exaglBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(size), instances);
+		}
+
+		m_count = static_cast<GLsizei>(count);
+	}
+
+	void InstanceBuffer::bind()
+	{
+		exaglBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+	}
+}
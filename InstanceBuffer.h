@@ -0,0 +1,75 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "exa.h"
+#include "VertexLayout.h"
+
+namespace exa
+{
+	EXA_VERTEX_ATTRIBUTE(InstanceTransformAttribute, "instanceTransform")
+	EXA_VERTEX_ATTRIBUTE(InstanceColorAttribute, "instanceColor")
+	EXA_VERTEX_ATTRIBUTE(InstanceUvRectAttribute, "instanceUvRect")
+
+	// Per-instance data of common case, 60 bytes:
+	// in mat4x3 instanceTransform; in vec4 instanceColor; in vec4 instanceUvRect;
+	struct InstanceData {
+		// Affine transform, column major glm::mat4x3
+		float Transform[12];
+		// 8 bit normalized RGBA
+		uint32 Color;
+		// Offset and size in texture, 16 bit normalized, selects sprite of atlas
+		uint16 UvRect[4];
+
+		static InstanceData pack(const glm::mat4& transform, const glm::vec4& color, const glm::vec4& uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+	};
+
+	using InstanceDataLayout = InstanceLayout<
+		VertexAttribute<InstanceTransformAttribute, float4x3>,
+		VertexAttribute<InstanceColorAttribute, unorm8x4>,
+		VertexAttribute<InstanceUvRectAttribute, unorm16x4>>;
+
+	static_assert(sizeof(InstanceData) == InstanceDataLayout::stride(), "Instance data doesn't match its layout");
+
+	// Per-instance attribute stream. Instances are uploaded from contiguous array and drawn together
+	// with one instanced call, storage is orphaned on every upload so GPU reading previous data doesn't stall.
+	//
+	// instances.setData(data);
+	// vertexArray.setInstanceLayout<InstanceDataLayout>(instances, shader.getReflection());
+	// commands.drawElementsInstanced(GL_TRIANGLES, indices.getCount(), indices.getType(), 0, instances.getCount());
+	class InstanceBuffer
+	{
+	private:
+
+	public:
+
+		InstanceBuffer();
+		~InstanceBuffer();
+
+		void setData(const void* instances, uint32 count, size_t stride);
+
+		template <typename Instance>
+		void setData(const std::vector<Instance>& instances)
+		{
+			setData(instances.data(), static_cast<uint32>(instances.size()), sizeof(Instance));
+		}
+
+		void bind();
+
+		GLuint getBuffer() const {
+			return m_buffer;
+		}
+
+		GLsizei getCount() const {
+			return m_count;
+		}
+
+	private:
+		GLuint m_buffer = 0;
+		size_t m_capacity = 0;
+		GLsizei m_count = 0;
+	};
+}
@@ -0,0 +1,355 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include "Log.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		// Main thread keeps 0, workers set their own index on start
+		thread_local uint32 s_threadIndex = 0;
+	}
+
+	void WorkStealingQueue::push(Job&& job)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+
+	bool WorkStealingQueue::pop(Job& job)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_jobs.empty()) {
+			return false;
+		}
+		job = std::move(m_jobs.back());
+		m_jobs.pop_back();
+		return true;
+	}
+
+	bool WorkStealingQueue::steal(Job& job)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_jobs.empty()) {
+			return false;
+		}
+		job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		return true;
+	}
+
+	TaskGraph::TaskId TaskGraph::addTask(const char* name, Job job, TaskAffinity affinity)
+	{
+		Task task;
+		task.name = name;
+		task.job = std::move(job);
+		task.affinity = affinity;
+		m_tasks.push_back(std::move(task));
+		m_checked = false;
+		return static_cast<TaskId>(m_tasks.size() - 1);
+	}
+
+	void TaskGraph::addDependency(TaskId task, TaskId dependency)
+	{
+		if (task >= m_tasks.size() || dependency >= m_tasks.size() || task == dependency) {
+			log::error("Invalid task dependency %u -> %u", dependency, task);
+			return;
+		}
+		m_tasks[dependency].successors.push_back(task);
+		m_tasks[task].numDependencies++;
+		m_checked = false;
+	}
+
+	void TaskGraph::clear()
+	{
+		m_tasks.clear();
+		m_checked = false;
+	}
+
+	uint32 TaskGraph::getBlockedTaskCount() const
+	{
+		if (m_checked) {
+			return m_blockedTasks;
+		}
+
+		// Kahn's algorithm: every task must be reachable from roots, otherwise some cycle never starts
+		const size_t numTasks = m_tasks.size();
+		std::vector<uint32> dependencies(numTasks);
+		std::vector<TaskId> ready;
+		for (size_t i = 0; i < numTasks; i++) {
+			dependencies[i] = m_tasks[i].numDependencies;
+			if (dependencies[i] == 0) {
+				ready.push_back(static_cast<TaskId>(i));
+			}
+		}
+
+		size_t visited = 0;
+		while (!ready.empty()) {
+			const TaskId id = ready.back();
+			ready.pop_back();
+			visited++;
+
+			for (auto successor : m_tasks[id].successors) {
+				if (--dependencies[successor] == 0) {
+					ready.push_back(successor);
+				}
+			}
+		}
+
+		m_blockedTasks = static_cast<uint32>(numTasks - visited);
+		m_checked = true;
+		return m_blockedTasks;
+	}
+
+	JobSystem::JobSystem()
+	{
+	}
+
+	JobSystem::~JobSystem()
+	{
+		shutdown();
+	}
+
+	bool JobSystem::init(uint32 numWorkers)
+	{
+		if (m_running) {
+			log::warning("Job system already initialized");
+			return true;
+		}
+
+		if (numWorkers == 0) {
+			int cpuCount = SDL_GetCPUCount();
+			numWorkers = cpuCount > 1 ? static_cast<uint32>(cpuCount - 1) : 0;
+		}
+
+		m_queues.clear();
+		for (uint32 i = 0; i < numWorkers + 1; i++) {
+			m_queues.emplace_back(new WorkStealingQueue());
+		}
+
+		m_running = true;
+
+		for (uint32 i = 1; i <= numWorkers; i++) {
+			m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+		}
+
+		log::debug("Job system started with %u worker threads", numWorkers);
+
+		return true;
+	}
+
+	void JobSystem::shutdown()
+	{
+		if (!m_running) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_running = false;
+		}
+		m_sleepCondition.notify_all();
+
+		for (auto& worker : m_workers) {
+			if (worker.joinable()) {
+				worker.join();
+			}
+		}
+		m_workers.clear();
+		m_queues.clear();
+	}
+
+	uint32 JobSystem::getThreadIndex()
+	{
+		return s_threadIndex;
+	}
+
+	void JobSystem::push(uint32 threadIndex, Job&& job)
+	{
+		// No workers: everything is executed by main thread while it waits
+		if (m_queues.empty()) {
+			m_mainThreadQueue.push(std::move(job));
+			return;
+		}
+
+		// Counted before job becomes visible, so that pop of it never drops counter below zero
+		m_stealableJobs.fetch_add(1);
+		m_queues[threadIndex]->push(std::move(job));
+		wakeWorkers();
+	}
+
+	void JobSystem::submit(Job job)
+	{
+		push(getThreadIndex(), std::move(job));
+	}
+
+	void JobSystem::submitToMainThread(Job job)
+	{
+		m_mainThreadQueue.push(std::move(job));
+	}
+
+	void JobSystem::wakeWorkers()
+	{
+		// Lock makes sure sleeping worker either sees new job or gets notification
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_sleepCondition.notify_one();
+	}
+
+	bool JobSystem::executeNext(uint32 threadIndex)
+	{
+		Job job;
+
+		bool found = false;
+
+		if (!m_queues.empty() && m_queues[threadIndex]->pop(job)) {
+			m_stealableJobs.fetch_sub(1);
+			found = true;
+		}
+		else if (threadIndex == 0 && m_mainThreadQueue.pop(job)) {
+			found = true;
+		}
+		else {
+			// Try other queues starting from neighbour to spread contention
+			const uint32 numQueues = static_cast<uint32>(m_queues.size());
+			for (uint32 i = 1; i < numQueues; i++) {
+				uint32 victim = (threadIndex + i) % numQueues;
+				if (m_queues[victim]->steal(job)) {
+					m_stealableJobs.fetch_sub(1);
+					found = true;
+					break;
+				}
+			}
+		}
+
+		if (!found) {
+			return false;
+		}
+
+		job();
+		return true;
+	}
+
+	void JobSystem::workerLoop(uint32 threadIndex)
+	{
+		s_threadIndex = threadIndex;
+
+		EXA_PROFILE_THREAD("Worker");
+
+		while (m_running) {
+			if (executeNext(threadIndex)) {
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_sleepCondition.wait(lock, [this] {
+				return m_stealableJobs.load() > 0 || !m_running;
+			});
+		}
+	}
+
+	void JobSystem::wait(const std::atomic<uint32>& counter)
+	{
+		const uint32 threadIndex = getThreadIndex();
+		while (counter.load() > 0) {
+			if (!executeNext(threadIndex)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void JobSystem::run(const TaskGraph& graph)
+	{
+		const size_t numTasks = graph.m_tasks.size();
+		if (numTasks == 0) {
+			return;
+		}
+
+		if (getThreadIndex() != 0) {
+			log::error("Task graph must be executed from main thread");
+			return;
+		}
+
+		// Tasks of cycle never start and wait below would spin forever
+		const uint32 blockedTasks = graph.getBlockedTaskCount();
+		if (blockedTasks > 0) {
+			log::error("Task graph has dependency cycle, %u of %u tasks can't run", blockedTasks, static_cast<uint32>(numTasks));
+			return;
+		}
+
+		std::vector<std::atomic<uint32>> pendingDependencies(numTasks);
+		for (size_t i = 0; i < numTasks; i++) {
+			pendingDependencies[i].store(graph.m_tasks[i].numDependencies);
+		}
+
+		std::atomic<uint32> remaining(static_cast<uint32>(numTasks));
+
+		std::function<void(TaskGraph::TaskId)> schedule = [&](TaskGraph::TaskId id) {
+			Job job = [&, id]() {
+				const auto& task = graph.m_tasks[id];
+				if (task.job) {
+					EXA_PROFILE_SCOPE(task.name);
+					task.job();
+				}
+				for (auto successor : task.successors) {
+					if (pendingDependencies[successor].fetch_sub(1) == 1) {
+						schedule(successor);
+					}
+				}
+				// @note Must be last access to graph state, run() may return right after it
+				remaining.fetch_sub(1);
+			};
+
+			if (graph.m_tasks[id].affinity == TaskAffinity::EXA_MAIN_THREAD) {
+				submitToMainThread(std::move(job));
+			}
+			else {
+				submit(std::move(job));
+			}
+		};
+
+		for (size_t i = 0; i < numTasks; i++) {
+			if (graph.m_tasks[i].numDependencies == 0) {
+				schedule(static_cast<TaskGraph::TaskId>(i));
+			}
+		}
+
+		wait(remaining);
+	}
+
+	void JobSystem::parallelFor(uint32 count, uint32 chunkSize, const std::function<void(uint32 begin, uint32 end)>& func)
+	{
+		if (count == 0) {
+			return;
+		}
+
+		chunkSize = std::max<uint32>(chunkSize, 1);
+		const uint32 numChunks = (count + chunkSize - 1) / chunkSize;
+
+		// Not worth scheduling
+		if (numChunks == 1 || getNumWorkers() == 0) {
+			func(0, count);
+			return;
+		}
+
+		std::atomic<uint32> remaining(numChunks);
+
+		for (uint32 chunk = 0; chunk < numChunks; chunk++) {
+			uint32 begin = chunk * chunkSize;
+			uint32 end = std::min(begin + chunkSize, count);
+			submit([&func, &remaining, begin, end]() {
+				func(begin, end);
+				remaining.fetch_sub(1);
+			});
+		}
+
+		wait(remaining);
+	}
+}
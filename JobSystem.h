@@ -0,0 +1,161 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	using Job = std::function<void()>;
+
+	// Threads a task is allowed to run on
+	enum class TaskAffinity : std::int8_t
+	{
+		// Any worker thread or the main thread
+		EXA_ANY_THREAD,
+		// Only the main thread (owns SDL window and OpenGL context)
+		EXA_MAIN_THREAD,
+		EXA_TOTAL_ITEMS
+	};
+
+	// Double-ended job queue owned by one thread.
+	// Owner pushes and pops at the back (LIFO, cache-warm), other threads steal from the front (FIFO).
+	class WorkStealingQueue
+	{
+	public:
+		void push(Job&& job);
+
+		// Called by owner thread only
+		bool pop(Job& job);
+
+		// Called by any other thread
+		bool steal(Job& job);
+
+	private:
+		std::mutex m_mutex;
+		std::deque<Job> m_jobs;
+	};
+
+	// Dependency graph of tasks executed by JobSystem::run.
+	// Graph may be built once and executed every frame.
+	class TaskGraph
+	{
+	public:
+		using TaskId = uint32;
+
+		TaskId addTask(const char* name, Job job, TaskAffinity affinity = TaskAffinity::EXA_ANY_THREAD);
+
+		// Task will be started only after dependency finished
+		void addDependency(TaskId task, TaskId dependency);
+
+		void clear();
+
+		size_t getTaskCount() const {
+			return m_tasks.size();
+		}
+
+		const char* getTaskName(TaskId task) const {
+			return m_tasks[task].name;
+		}
+
+	private:
+		friend class JobSystem;
+
+		struct Task
+		{
+			const char* name = nullptr;
+			Job job;
+			TaskAffinity affinity = TaskAffinity::EXA_ANY_THREAD;
+			uint32 numDependencies = 0;
+			std::vector<TaskId> successors;
+		};
+
+		// Tasks never started because of dependency cycle, checked once after graph changes
+		uint32 getBlockedTaskCount() const;
+
+		std::vector<Task> m_tasks;
+
+		// Cache of getBlockedTaskCount, graph is usually built once and run every frame
+		mutable bool m_checked = false;
+		mutable uint32 m_blockedTasks = 0;
+	};
+
+	// Work-stealing scheduler with one job queue per thread.
+	// Thread index 0 is always the main thread, workers use indices 1..N.
+	class JobSystem
+	{
+	public:
+		JobSystem();
+		~JobSystem();
+
+		// Spawns worker threads. Zero means one worker per CPU core except main thread (SDL_GetCPUCount() - 1)
+		bool init(uint32 numWorkers = 0);
+
+		// Waits for workers and joins them
+		void shutdown();
+
+		// Queues job for any thread
+		void submit(Job job);
+
+		// Queues job for main thread, it will be executed while main thread waits in run/wait/parallelFor
+		void submitToMainThread(Job job);
+
+		// Executes all tasks of graph respecting dependencies, blocks until all tasks are done.
+		// @note Must be called from main thread
+		void run(const TaskGraph& graph);
+
+		// Splits [0, count) into chunks of chunkSize and processes them on all threads, blocks until done
+		void parallelFor(uint32 count, uint32 chunkSize, const std::function<void(uint32 begin, uint32 end)>& func);
+
+		// Executes queued jobs until counter reaches zero
+		void wait(const std::atomic<uint32>& counter);
+
+		uint32 getNumWorkers() const {
+			return static_cast<uint32>(m_workers.size());
+		}
+
+		// Workers plus main thread
+		uint32 getNumThreads() const {
+			return getNumWorkers() + 1;
+		}
+
+		// Index of calling thread: 0 for main thread, 1..N for workers
+		static uint32 getThreadIndex();
+
+	private:
+		void workerLoop(uint32 threadIndex);
+
+		// Pops own job, then main thread job (main thread only), then steals. Returns false if nothing found.
+		bool executeNext(uint32 threadIndex);
+
+		void push(uint32 threadIndex, Job&& job);
+
+		void wakeWorkers();
+
+		std::vector<std::thread> m_workers;
+
+		// One queue per thread, index 0 is main thread queue
+		std::vector<std::unique_ptr<WorkStealingQueue>> m_queues;
+
+		// Jobs pinned to main thread
+		WorkStealingQueue m_mainThreadQueue;
+
+		// Jobs that workers may pick up, used to put idle workers to sleep
+		std::atomic<uint32> m_stealableJobs{ 0 };
+
+		std::atomic<bool> m_running{ false };
+
+		std::mutex m_sleepMutex;
+		std::condition_variable m_sleepCondition;
+	};
+}
@@ -0,0 +1,297 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "MeshCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
+#include <glm/gtc/packing.hpp>
+
+#include "File.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
+#include "Log.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		// "EXMC"
+		const uint32 MESH_MAGIC = 0x434D5845;
+		// Increase when file layout or CookedVertex changes
+		const uint32 MESH_VERSION = 1;
+
+		struct MeshHeader
+		{
+			uint32 magic;
+			uint32 version;
+			uint32 vertexCount;
+			uint32 indexCount;
+			float positionOffset[3];
+			float positionScale[3];
+		};
+
+		struct ChunkBounds
+		{
+			glm::vec3 min{ std::numeric_limits<float>::max() };
+			glm::vec3 max{ -std::numeric_limits<float>::max() };
+		};
+
+		glm::vec2 signNotZero(const glm::vec2& v)
+		{
+			return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		float angleDegrees(const glm::vec3& a, const glm::vec3& b)
+		{
+			const float cosine = glm::clamp(glm::dot(a, b), -1.0f, 1.0f);
+			return glm::degrees(std::acos(cosine));
+		}
+
+		glm::vec3 safeNormalize(const glm::vec3& v)
+		{
+			const float length = glm::length(v);
+			return length > 0.0f ? v / length : glm::vec3(0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	uint32 MeshCooker::encodeOctahedral(const glm::vec3& direction)
+	{
+		glm::vec3 n = direction / (std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z));
+		glm::vec2 p(n.x, n.y);
+		if (n.z < 0.0f) {
+			p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * signNotZero(p);
+		}
+		return glm::packSnorm2x16(p);
+	}
+
+	glm::vec3 MeshCooker::decodeOctahedral(uint32 packed)
+	{
+		const glm::vec2 p = glm::unpackSnorm2x16(packed);
+		glm::vec3 n(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+		if (n.z < 0.0f) {
+			const glm::vec2 folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * signNotZero(glm::vec2(n.x, n.y));
+			n.x = folded.x;
+			n.y = folded.y;
+		}
+		return glm::normalize(n);
+	}
+
+	MeshCooker::MeshCooker(JobSystem* jobSystem)
+		: m_jobSystem(jobSystem)
+	{
+	}
+
+	void MeshCooker::parallelFor(uint32 count, const std::function<void(uint32 begin, uint32 end)>& func) const
+	{
+		if (m_jobSystem != nullptr && count > CHUNK_SIZE) {
+			m_jobSystem->parallelFor(count, CHUNK_SIZE, func);
+			return;
+		}
+
+		for (uint32 begin = 0; begin < count; begin += CHUNK_SIZE) {
+			func(begin, std::min(begin + CHUNK_SIZE, count));
+		}
+	}
+
+	bool MeshCooker::cook(const MeshSource& source, CookedMesh& result) const
+	{
+		EXA_PROFILE_FUNCTION();
+
+		const size_t vertexCount = source.positions.size();
+		if ((!source.normals.empty() && source.normals.size() != vertexCount) ||
+			(!source.tangents.empty() && source.tangents.size() != vertexCount) ||
+			(!source.texCoords.empty() && source.texCoords.size() != vertexCount)) {
+			log::error("Mesh %s has streams of different sizes", source.name.c_str());
+			return false;
+		}
+
+		if (vertexCount > std::numeric_limits<uint32>::max()) {
+			log::error("Mesh %s has too many vertices", source.name.c_str());
+			return false;
+		}
+
+		// Optimizer indexes per vertex tables with them and works on whole triangles,
+		// non-indexed meshes get one index per vertex
+		const size_t indexCount = source.indices.empty() ? vertexCount : source.indices.size();
+		if (indexCount % 3 != 0) {
+			log::error("Mesh %s has %u indices, not a triangle list", source.name.c_str(), static_cast<unsigned int>(indexCount));
+			return false;
+		}
+
+		for (uint32 index : source.indices) {
+			if (index >= vertexCount) {
+				log::error("Mesh %s has index %u out of %u vertices", source.name.c_str(), index, static_cast<unsigned int>(vertexCount));
+				return false;
+			}
+		}
+
+		const uint32 count = static_cast<uint32>(vertexCount);
+		const uint32 chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+		// Bounds, reduced per chunk so that threads never share data
+		std::vector<ChunkBounds> bounds(chunkCount);
+		parallelFor(count, [&](uint32 begin, uint32 end) {
+			ChunkBounds& chunk = bounds[begin / CHUNK_SIZE];
+			for (uint32 i = begin; i < end; i++) {
+				chunk.min = glm::min(chunk.min, source.positions[i]);
+				chunk.max = glm::max(chunk.max, source.positions[i]);
+			}
+		});
+
+		ChunkBounds total;
+		for (const auto& chunk : bounds) {
+			total.min = glm::min(total.min, chunk.min);
+			total.max = glm::max(total.max, chunk.max);
+		}
+
+		if (count == 0) {
+			total.min = total.max = glm::vec3(0.0f);
+		}
+
+		result.positionOffset = total.min;
+		result.positionScale = total.max - total.min;
+
+		// Flat axes quantize to zero
+		glm::vec3 inverseScale;
+		for (int axis = 0; axis < 3; axis++) {
+			inverseScale[axis] = result.positionScale[axis] > 0.0f ? 1.0f / result.positionScale[axis] : 0.0f;
+		}
+
+		result.vertices.resize(vertexCount);
+		result.indices = source.indices;
+
+		const bool hasNormals = !source.normals.empty();
+		const bool hasTangents = !source.tangents.empty();
+		const bool hasTexCoords = !source.texCoords.empty();
+
+		std::vector<MeshCookingError> errors(chunkCount);
+		parallelFor(count, [&](uint32 begin, uint32 end) {
+			MeshCookingError& error = errors[begin / CHUNK_SIZE];
+
+			for (uint32 i = begin; i < end; i++) {
+				CookedVertex& vertex = result.vertices[i];
+
+				const glm::vec3 relative = (source.positions[i] - result.positionOffset) * inverseScale;
+				const glm::u16vec3 position = glm::packUnorm<uint16>(relative);
+				vertex.position[0] = position.x;
+				vertex.position[1] = position.y;
+				vertex.position[2] = position.z;
+				vertex.position[3] = (hasTangents && source.tangents[i].w < 0.0f) ? 0 : 0xFFFF;
+
+				const glm::vec3 decoded = result.positionOffset + glm::unpackUnorm<uint16, float>(position) * result.positionScale;
+				error.position = std::max(error.position, glm::length(decoded - source.positions[i]));
+
+				const glm::vec3 normal = hasNormals ? safeNormalize(source.normals[i]) : glm::vec3(0.0f, 0.0f, 1.0f);
+				vertex.normal = encodeOctahedral(normal);
+				error.normal = std::max(error.normal, angleDegrees(normal, decodeOctahedral(vertex.normal)));
+
+				const glm::vec3 tangent = hasTangents ? safeNormalize(glm::vec3(source.tangents[i])) : glm::vec3(1.0f, 0.0f, 0.0f);
+				vertex.tangent = encodeOctahedral(tangent);
+				error.tangent = std::max(error.tangent, angleDegrees(tangent, decodeOctahedral(vertex.tangent)));
+
+				const glm::vec2 texCoord = hasTexCoords ? source.texCoords[i] : glm::vec2(0.0f);
+				const uint32 packedTexCoord = glm::packHalf2x16(texCoord);
+				vertex.texCoord[0] = static_cast<uint16>(packedTexCoord & 0xFFFF);
+				vertex.texCoord[1] = static_cast<uint16>(packedTexCoord >> 16);
+
+				const glm::vec2 texCoordError = glm::abs(glm::unpackHalf2x16(packedTexCoord) - texCoord);
+				error.texCoord = std::max(error.texCoord, std::max(texCoordError.x, texCoordError.y));
+			}
+		});
+
+		result.error = MeshCookingError();
+		for (const auto& error : errors) {
+			result.error.position = std::max(result.error.position, error.position);
+			result.error.normal = std::max(result.error.normal, error.normal);
+			result.error.tangent = std::max(result.error.tangent, error.tangent);
+			result.error.texCoord = std::max(result.error.texCoord, error.texCoord);
+		}
+
+		// Quantization makes more vertices bitwise equal, so they are deduplicated after it
+		MeshOptimizer::optimize(result.vertices, result.indices, source.name, m_jobSystem);
+
+		const double megabyte = 1024.0 * 1024.0;
+		log::message("Cooked mesh %s: %u -> %u vertices, %.2f -> %.2f MB, max error: position %g, normal %g deg, tangent %g deg, uv %g",
+			source.name.c_str(), count, static_cast<unsigned int>(result.vertices.size()),
+			vertexCount * (sizeof(glm::vec3) * 2 + sizeof(glm::vec4) + sizeof(glm::vec2)) / megabyte,
+			result.vertices.size() * sizeof(CookedVertex) / megabyte,
+			result.error.position, result.error.normal, result.error.tangent, result.error.texCoord);
+
+		return true;
+	}
+
+	bool CookedMesh::save(const char* path) const
+	{
+		MeshHeader header;
+		header.magic = MESH_MAGIC;
+		header.version = MESH_VERSION;
+		header.vertexCount = static_cast<uint32>(vertices.size());
+		header.indexCount = static_cast<uint32>(indices.size());
+		for (int axis = 0; axis < 3; axis++) {
+			header.positionOffset[axis] = positionOffset[axis];
+			header.positionScale[axis] = positionScale[axis];
+		}
+
+		const std::string temporaryPath = std::string(path) + ".tmp";
+
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+				!file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(CookedVertex)) ||
+				!file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32))) {
+				log::error("Unable to write mesh file %s", temporaryPath.c_str());
+				file.close();
+				std::remove(temporaryPath.c_str());
+				return false;
+			}
+		}
+
+		if (!File::replace(temporaryPath.c_str(), path)) {
+			log::error("Unable to rename %s to %s", temporaryPath.c_str(), path);
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	bool CookedMesh::load(const char* path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			log::error("Unable to open mesh file %s", path);
+			return false;
+		}
+
+		MeshHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			header.magic != MESH_MAGIC || header.version != MESH_VERSION) {
+			log::error("Mesh file %s is not cooked with this version", path);
+			return false;
+		}
+
+		vertices.resize(header.vertexCount);
+		indices.resize(header.indexCount);
+		if (!file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(CookedVertex)) ||
+			!file.read(reinterpret_cast<char*>(indices.data()), indices.size() * sizeof(uint32))) {
+			log::error("Mesh file %s is truncated", path);
+			vertices.clear();
+			indices.clear();
+			return false;
+		}
+
+		for (int axis = 0; axis < 3; axis++) {
+			positionOffset[axis] = header.positionOffset[axis];
+			positionScale[axis] = header.positionScale[axis];
+		}
+		error = MeshCookingError();
+
+		return true;
+	}
+}
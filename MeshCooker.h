@@ -0,0 +1,108 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "exa.h"
+#include "RenderPlatforms.h"
+#include "VertexLayout.h"
+
+namespace exa
+{
+	class JobSystem;
+
+	// Mesh as produced by importers, optional streams are empty or have one element per position
+	struct MeshSource
+	{
+		std::string name;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		// w is handedness of bitangent (+1 or -1)
+		std::vector<glm::vec4> tangents;
+		std::vector<glm::vec2> texCoords;
+		std::vector<uint32> indices;
+	};
+
+	EXA_VERTEX_ATTRIBUTE(MeshPositionAttribute, "vPosition")
+	EXA_VERTEX_ATTRIBUTE(MeshNormalAttribute, "vNormal")
+	EXA_VERTEX_ATTRIBUTE(MeshTangentAttribute, "vTangent")
+	EXA_VERTEX_ATTRIBUTE(MeshTexCoordAttribute, "texCoord")
+
+	// 20 bytes instead of 48 of uncompressed vertex. Decoding in vertex shader:
+	//   position = positionOffset + vPosition.xyz * positionScale
+	//   bitangent sign = vPosition.w * 2.0 - 1.0
+	//   normal, tangent: octahedral, n = vec3(v.xy, 1.0 - abs(v.x) - abs(v.y)),
+	//                    if n.z < 0 then n.xy = (1.0 - abs(n.yx)) * sign(n.xy), normalize(n)
+	struct CookedVertex
+	{
+		// unorm16 relative to mesh bounds, w is bitangent sign (0 or 1)
+		uint16 position[4];
+		// Octahedral snorm16x2
+		uint32 normal;
+		uint32 tangent;
+		// half2, texture coordinates may be outside of [0;1] when tiled
+		uint16 texCoord[2];
+	};
+
+	using CookedVertexLayout = VertexLayout<
+		VertexAttribute<MeshPositionAttribute, unorm16x4>,
+		VertexAttribute<MeshNormalAttribute, snorm16x2>,
+		VertexAttribute<MeshTangentAttribute, snorm16x2>,
+		VertexAttribute<MeshTexCoordAttribute, half2>>;
+
+	static_assert(sizeof(CookedVertex) == CookedVertexLayout::stride(), "Cooked vertex doesn't match its layout");
+
+	// Largest difference between source and decoded cooked data
+	struct MeshCookingError
+	{
+		// In mesh units
+		float position = 0.0f;
+		// In degrees
+		float normal = 0.0f;
+		float tangent = 0.0f;
+		float texCoord = 0.0f;
+	};
+
+	struct CookedMesh
+	{
+		std::vector<CookedVertex> vertices;
+		std::vector<uint32> indices;
+
+		// Dequantization of positions
+		glm::vec3 positionOffset{ 0.0f };
+		glm::vec3 positionScale{ 0.0f };
+
+		MeshCookingError error;
+
+		// Binary file with header, written to temporary file first
+		bool save(const char* path) const;
+		bool load(const char* path);
+	};
+
+	// Quantizes meshes into CookedVertex format, vertices are processed in chunks on all threads.
+	// Result is deduplicated and reordered for vertex cache and fetch by MeshOptimizer, large meshes in chunks on all threads
+	class MeshCooker
+	{
+	public:
+		static const uint32 CHUNK_SIZE = 64 * 1024;
+
+		// Without job system mesh is cooked on calling thread
+		explicit MeshCooker(JobSystem* jobSystem = nullptr);
+
+		// Returns false if streams of source have different sizes or indices are not valid triangle list
+		bool cook(const MeshSource& source, CookedMesh& result) const;
+
+		// Unit vector to octahedral snorm16x2
+		static uint32 encodeOctahedral(const glm::vec3& direction);
+		static glm::vec3 decodeOctahedral(uint32 packed);
+
+	private:
+		void parallelFor(uint32 count, const std::function<void(uint32 begin, uint32 end)>& func) const;
+
+		JobSystem* m_jobSystem = nullptr;
+	};
+}
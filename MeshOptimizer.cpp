@@ -0,0 +1,378 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Hash.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	// Out of line definition, std::min takes it by reference
+	const uint32 MeshOptimizer::CACHE_SIZE;
+
+	namespace
+	{
+		const uint32 INVALID_INDEX = ~0u;
+
+		// Forsyth's scoring, see "Linear-Speed Vertex Cache Optimisation" by Tom Forsyth
+		const float CACHE_DECAY_POWER = 1.5f;
+		const float LAST_TRIANGLE_SCORE = 0.75f;
+		const float VALENCE_BOOST_SCALE = 2.0f;
+		const float VALENCE_BOOST_POWER = 0.5f;
+
+		// Scores are tabulated, valence beyond table gets score of last entry
+		const uint32 MAX_VALENCE = 32;
+
+		struct ScoreTable
+		{
+			float cache[MeshOptimizer::CACHE_SIZE];
+			float valence[MAX_VALENCE + 1];
+
+			ScoreTable()
+			{
+				for (uint32 i = 0; i < MeshOptimizer::CACHE_SIZE; i++) {
+					if (i < 3) {
+						// Vertices of last triangle, same score so that strips aren't favored over fans
+						cache[i] = LAST_TRIANGLE_SCORE;
+					}
+					else {
+						const float scaler = 1.0f / (MeshOptimizer::CACHE_SIZE - 3);
+						cache[i] = std::pow(1.0f - (i - 3) * scaler, CACHE_DECAY_POWER);
+					}
+				}
+
+				valence[0] = 0.0f;
+				for (uint32 i = 1; i <= MAX_VALENCE; i++) {
+					valence[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+				}
+			}
+
+			float score(int32 cachePosition, uint32 remainingTriangles) const
+			{
+				if (remainingTriangles == 0) {
+					return -1.0f;
+				}
+
+				float result = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+				return result + valence[std::min(remainingTriangles, MAX_VALENCE)];
+			}
+		};
+
+		uint32 nextPowerOfTwo(uint32 value)
+		{
+			uint32 result = 1;
+			while (result < value) {
+				result <<= 1;
+			}
+			return result;
+		}
+	}
+
+	uint32 MeshOptimizer::generateRemap(const void* vertices, uint32 vertexCount, size_t stride, std::vector<uint32>& remap)
+	{
+		const unsigned char* data = static_cast<const unsigned char*>(vertices);
+
+		remap.assign(vertexCount, INVALID_INDEX);
+
+		// Open addressing, table holds first vertex of every unique value
+		const uint32 tableSize = nextPowerOfTwo(std::max(vertexCount * 2, 16u));
+		std::vector<uint32> table(tableSize, INVALID_INDEX);
+
+		uint32 uniqueCount = 0;
+		for (uint32 i = 0; i < vertexCount; i++) {
+			const unsigned char* vertex = data + i * stride;
+			uint32 slot = static_cast<uint32>(hashFnv1a64(vertex, stride)) & (tableSize - 1);
+
+			for (;;) {
+				const uint32 existing = table[slot];
+				if (existing == INVALID_INDEX) {
+					table[slot] = i;
+					remap[i] = uniqueCount++;
+					break;
+				}
+
+				if (memcmp(data + existing * stride, vertex, stride) == 0) {
+					remap[i] = remap[existing];
+					break;
+				}
+
+				slot = (slot + 1) & (tableSize - 1);
+			}
+		}
+
+		return uniqueCount;
+	}
+
+	void MeshOptimizer::applyRemap(void* vertices, uint32 vertexCount, size_t stride, const std::vector<uint32>& remap, uint32 uniqueCount, std::vector<uint32>& indices)
+	{
+		unsigned char* data = static_cast<unsigned char*>(vertices);
+
+		std::vector<unsigned char> result(uniqueCount * stride);
+		for (uint32 i = 0; i < vertexCount; i++) {
+			if (remap[i] != INVALID_INDEX) {
+				memcpy(&result[remap[i] * stride], data + i * stride, stride);
+			}
+		}
+		memcpy(data, result.data(), result.size());
+
+		for (auto& index : indices) {
+			index = remap[index];
+		}
+	}
+
+	void MeshOptimizer::optimizeVertexCache(std::vector<uint32>& indices, uint32 vertexCount)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		static const ScoreTable scores;
+
+		const uint32 triangleCount = static_cast<uint32>(indices.size() / 3);
+		if (triangleCount == 0) {
+			return;
+		}
+
+		// Triangles of every vertex as offsets into flat adjacency array
+		std::vector<uint32> remaining(vertexCount, 0);
+		for (uint32 index : indices) {
+			remaining[index]++;
+		}
+
+		std::vector<uint32> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32 i = 0; i < vertexCount; i++) {
+			adjacencyOffsets[i + 1] = adjacencyOffsets[i] + remaining[i];
+		}
+
+		std::vector<uint32> adjacency(indices.size());
+		std::vector<uint32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32 triangle = 0; triangle < triangleCount; triangle++) {
+			for (uint32 corner = 0; corner < 3; corner++) {
+				const uint32 vertex = indices[triangle * 3 + corner];
+				adjacency[fill[vertex]++] = triangle;
+			}
+		}
+
+		std::vector<int32> cachePositions(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (uint32 i = 0; i < vertexCount; i++) {
+			vertexScores[i] = scores.score(-1, remaining[i]);
+		}
+
+		std::vector<float> triangleScores(triangleCount);
+		for (uint32 triangle = 0; triangle < triangleCount; triangle++) {
+			triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+		}
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32> result;
+		result.reserve(indices.size());
+
+		// LRU cache, 3 extra entries hold vertices pushed out by last triangle
+		uint32 cache[CACHE_SIZE + 3];
+		uint32 cacheSize = 0;
+
+		uint32 bestTriangle = 0;
+		uint32 scanPosition = 0;
+
+		for (uint32 emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+			if (bestTriangle == INVALID_INDEX) {
+				// Nothing useful in cache, continue with next triangle in original order
+				while (emitted[scanPosition]) {
+					scanPosition++;
+				}
+				bestTriangle = scanPosition;
+			}
+
+			emitted[bestTriangle] = true;
+
+			uint32 newCache[CACHE_SIZE + 3];
+			uint32 newCacheSize = 0;
+
+			for (uint32 corner = 0; corner < 3; corner++) {
+				const uint32 vertex = indices[bestTriangle * 3 + corner];
+				result.push_back(vertex);
+				newCache[newCacheSize++] = vertex;
+
+				// Remove triangle from adjacency of vertex
+				uint32* begin = adjacency.data() + adjacencyOffsets[vertex];
+				uint32* end = begin + remaining[vertex];
+				uint32* found = std::find(begin, end, bestTriangle);
+				if (found != end) {
+					*found = *(end - 1);
+					remaining[vertex]--;
+				}
+			}
+
+			for (uint32 i = 0; i < cacheSize; i++) {
+				const uint32 vertex = cache[i];
+				if (vertex != newCache[0] && vertex != newCache[1] && vertex != newCache[2]) {
+					newCache[newCacheSize++] = vertex;
+				}
+			}
+
+			// Vertices falling out of cache lose their position score
+			for (uint32 i = CACHE_SIZE; i < newCacheSize; i++) {
+				cachePositions[newCache[i]] = -1;
+			}
+
+			cacheSize = std::min(newCacheSize, CACHE_SIZE);
+			memcpy(cache, newCache, cacheSize * sizeof(uint32));
+
+			// Rescore vertices whose cache position changed, including ones pushed out of cache
+			for (uint32 i = 0; i < cacheSize; i++) {
+				cachePositions[cache[i]] = static_cast<int32>(i);
+			}
+
+			for (uint32 i = 0; i < newCacheSize; i++) {
+				const uint32 vertex = newCache[i];
+				const float score = scores.score(cachePositions[vertex], remaining[vertex]);
+				const float delta = score - vertexScores[vertex];
+				vertexScores[vertex] = score;
+
+				const uint32* adjacent = adjacency.data() + adjacencyOffsets[vertex];
+				for (uint32 j = 0; j < remaining[vertex]; j++) {
+					triangleScores[adjacent[j]] += delta;
+				}
+			}
+
+			// Best triangle using cached vertices
+			bestTriangle = INVALID_INDEX;
+			float bestScore = -1.0f;
+
+			for (uint32 i = 0; i < cacheSize; i++) {
+				const uint32 vertex = cache[i];
+				const uint32* adjacent = adjacency.data() + adjacencyOffsets[vertex];
+				for (uint32 j = 0; j < remaining[vertex]; j++) {
+					const uint32 triangle = adjacent[j];
+					if (triangleScores[triangle] > bestScore) {
+						bestScore = triangleScores[triangle];
+						bestTriangle = triangle;
+					}
+				}
+			}
+		}
+
+		indices.swap(result);
+	}
+
+	void MeshOptimizer::optimizeVertexCacheChunked(std::vector<uint32>& indices, JobSystem* jobSystem)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		const uint32 triangleCount = static_cast<uint32>(indices.size() / 3);
+
+		// Job system may pass range of several chunks, they are still split the same way
+		auto optimizeChunks = [&indices](uint32 begin, uint32 end) {
+			std::vector<uint32> chunk;
+			std::vector<uint32> chunkVertices;
+
+			for (uint32 first = begin; first < end; first += CACHE_CHUNK_TRIANGLES) {
+				const uint32 last = std::min(first + CACHE_CHUNK_TRIANGLES, end);
+				chunk.assign(indices.begin() + first * 3, indices.begin() + last * 3);
+
+				// Vertices are renumbered within chunk, so per vertex data of optimization is chunk sized
+				chunkVertices = chunk;
+				std::sort(chunkVertices.begin(), chunkVertices.end());
+				chunkVertices.erase(std::unique(chunkVertices.begin(), chunkVertices.end()), chunkVertices.end());
+				for (auto& index : chunk) {
+					index = static_cast<uint32>(std::lower_bound(chunkVertices.begin(), chunkVertices.end(), index) - chunkVertices.begin());
+				}
+
+				optimizeVertexCache(chunk, static_cast<uint32>(chunkVertices.size()));
+
+				for (size_t i = 0; i < chunk.size(); i++) {
+					indices[first * 3 + i] = chunkVertices[chunk[i]];
+				}
+			}
+		};
+
+		if (jobSystem != nullptr) {
+			jobSystem->parallelFor(triangleCount, CACHE_CHUNK_TRIANGLES, optimizeChunks);
+		}
+		else {
+			optimizeChunks(0, triangleCount);
+		}
+	}
+
+	uint32 MeshOptimizer::optimizeVertexFetch(void* vertices, uint32 vertexCount, size_t stride, std::vector<uint32>& indices)
+	{
+		std::vector<uint32> remap(vertexCount, INVALID_INDEX);
+
+		uint32 nextVertex = 0;
+		for (uint32 index : indices) {
+			if (remap[index] == INVALID_INDEX) {
+				remap[index] = nextVertex++;
+			}
+		}
+
+		// Unreferenced vertices are dropped
+		applyRemap(vertices, vertexCount, stride, remap, nextVertex, indices);
+		return nextVertex;
+	}
+
+	float MeshOptimizer::computeACMR(const std::vector<uint32>& indices, uint32 vertexCount, uint32 cacheSize)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) {
+			return 0.0f;
+		}
+
+		// Timestamp of entering cache, vertex is hit if it entered less than cacheSize misses ago
+		std::vector<uint32> timestamps(vertexCount, 0);
+		uint32 time = cacheSize + 1;
+		uint32 misses = 0;
+
+		for (uint32 index : indices) {
+			if (time - timestamps[index] > cacheSize) {
+				timestamps[index] = time++;
+				misses++;
+			}
+		}
+
+		return static_cast<float>(misses) / triangleCount;
+	}
+
+	MeshOptimizerStats MeshOptimizer::optimize(void* vertices, uint32 vertexCount, size_t stride, std::vector<uint32>& indices, const std::string& name, JobSystem* jobSystem)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		MeshOptimizerStats stats;
+		stats.verticesBefore = vertexCount;
+
+		if (indices.empty()) {
+			indices.resize(vertexCount);
+			for (uint32 i = 0; i < vertexCount; i++) {
+				indices[i] = i;
+			}
+		}
+
+		stats.acmrBefore = computeACMR(indices, vertexCount);
+
+		std::vector<uint32> remap;
+		const uint32 uniqueCount = generateRemap(vertices, vertexCount, stride, remap);
+		applyRemap(vertices, vertexCount, stride, remap, uniqueCount, indices);
+
+		// Whole mesh gives slightly better order, chunks scale with threads
+		if (jobSystem != nullptr && indices.size() / 3 > CACHE_CHUNK_TRIANGLES) {
+			optimizeVertexCacheChunked(indices, jobSystem);
+		}
+		else {
+			optimizeVertexCache(indices, uniqueCount);
+		}
+		stats.verticesAfter = optimizeVertexFetch(vertices, uniqueCount, stride, indices);
+
+		stats.acmrAfter = computeACMR(indices, stats.verticesAfter);
+
+		log::debug("Optimized mesh %s: %u -> %u vertices, %u triangles, ACMR %.3f -> %.3f",
+			name.c_str(), stats.verticesBefore, stats.verticesAfter, static_cast<unsigned int>(indices.size() / 3),
+			stats.acmrBefore, stats.acmrAfter);
+
+		return stats;
+	}
+}
@@ -0,0 +1,68 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	class JobSystem;
+
+	struct MeshOptimizerStats
+	{
+		uint32 verticesBefore = 0;
+		uint32 verticesAfter = 0;
+		// Average cache miss ratio: transformed vertices per triangle, 0.5 is ideal for regular grids, 3 is worst
+		float acmrBefore = 0.0f;
+		float acmrAfter = 0.0f;
+	};
+
+	// Triangle list optimizations, usable offline (cooker) and at load.
+	// Vertices are opaque blocks of stride bytes, so any vertex format works.
+	class MeshOptimizer
+	{
+	public:
+		// Post-transform cache size assumed by optimization and ACMR
+		static const uint32 CACHE_SIZE = 32;
+
+		// Triangles per chunk of optimizeVertexCacheChunked
+		static const uint32 CACHE_CHUNK_TRIANGLES = 16 * 1024;
+
+		// Fills remap (old index -> new index) so that bitwise equal vertices share one index, returns unique count
+		static uint32 generateRemap(const void* vertices, uint32 vertexCount, size_t stride, std::vector<uint32>& remap);
+
+		// Applies remap to vertices (in place, result has uniqueCount vertices) and to indices
+		static void applyRemap(void* vertices, uint32 vertexCount, size_t stride, const std::vector<uint32>& remap, uint32 uniqueCount, std::vector<uint32>& indices);
+
+		// Reorders triangles for post-transform cache hits (Forsyth's linear-speed vertex cache optimization)
+		static void optimizeVertexCache(std::vector<uint32>& indices, uint32 vertexCount);
+
+		// Same as optimizeVertexCache, but consecutive chunks of CACHE_CHUNK_TRIANGLES are reordered independently
+		// on all threads of job system. Cache state isn't carried between chunks, result doesn't depend on thread count
+		static void optimizeVertexCacheChunked(std::vector<uint32>& indices, JobSystem* jobSystem);
+
+		// Reorders vertices in order of first use, so vertex fetch reads memory linearly. Returns used vertex count
+		static uint32 optimizeVertexFetch(void* vertices, uint32 vertexCount, size_t stride, std::vector<uint32>& indices);
+
+		// Simulates FIFO post-transform cache of cacheSize entries
+		static float computeACMR(const std::vector<uint32>& indices, uint32 vertexCount, uint32 cacheSize = CACHE_SIZE);
+
+		// Deduplicates, optimizes cache and fetch order, logs ACMR before and after.
+		// Non-indexed meshes pass empty indices, they are generated.
+		// With job system meshes larger than one chunk are optimized by optimizeVertexCacheChunked
+		template <typename Vertex>
+		static MeshOptimizerStats optimize(std::vector<Vertex>& vertices, std::vector<uint32>& indices, const std::string& name = std::string(), JobSystem* jobSystem = nullptr)
+		{
+			MeshOptimizerStats stats = optimize(vertices.data(), static_cast<uint32>(vertices.size()), sizeof(Vertex), indices, name, jobSystem);
+			vertices.resize(stats.verticesAfter);
+			return stats;
+		}
+
+		// Vertex count is reduced to verticesAfter of result
+		static MeshOptimizerStats optimize(void* vertices, uint32 vertexCount, size_t stride, std::vector<uint32>& indices, const std::string& name, JobSystem* jobSystem = nullptr);
+	};
+}
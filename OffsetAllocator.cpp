@@ -0,0 +1,298 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "OffsetAllocator.h"
+
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#endif
+
+#include "Log.h"
+
+namespace exa
+{
+	namespace
+	{
+		// @note Value must not be 0
+		uint32 highestBit(uint32 value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index = 0;
+			_BitScanReverse(&index, value);
+			return static_cast<uint32>(index);
+#else
+			return 31 - static_cast<uint32>(__builtin_clz(value));
+#endif
+		}
+
+		// @note Value must not be 0
+		uint32 lowestBit(uint32 value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index = 0;
+			_BitScanForward(&index, value);
+			return static_cast<uint32>(index);
+#else
+			return static_cast<uint32>(__builtin_ctz(value));
+#endif
+		}
+	}
+
+	OffsetAllocator::OffsetAllocator(uint32 size)
+	{
+		reset(size);
+	}
+
+	void OffsetAllocator::reset(uint32 size)
+	{
+		m_nodes.clear();
+		m_unusedNodes.clear();
+
+		m_flBitmap = 0;
+		for (auto& bitmap : m_slBitmaps) {
+			bitmap = 0;
+		}
+		for (auto& bin : m_bins) {
+			bin = NO_NODE;
+		}
+
+		m_size = size;
+		m_used = 0;
+
+		if (size > 0) {
+			const uint32 node = createNode();
+			m_nodes[node].offset = 0;
+			m_nodes[node].size = size;
+			insertFree(node);
+		}
+	}
+
+	void OffsetAllocator::mapping(uint32 size, uint32& fl, uint32& sl)
+	{
+		if (size < SL_COUNT) {
+			// Small sizes get exact bins
+			fl = 0;
+			sl = size;
+			return;
+		}
+
+		const uint32 log = highestBit(size);
+		fl = log - SL_BITS + 1;
+		sl = (size >> (log - SL_BITS)) - SL_COUNT;
+	}
+
+	uint32 OffsetAllocator::createNode()
+	{
+		if (!m_unusedNodes.empty()) {
+			const uint32 node = m_unusedNodes.back();
+			m_unusedNodes.pop_back();
+			m_nodes[node] = Node();
+			return node;
+		}
+
+		m_nodes.emplace_back();
+		return static_cast<uint32>(m_nodes.size() - 1);
+	}
+
+	void OffsetAllocator::releaseNode(uint32 node)
+	{
+		m_unusedNodes.push_back(node);
+	}
+
+	void OffsetAllocator::insertFree(uint32 node)
+	{
+		uint32 fl = 0;
+		uint32 sl = 0;
+		mapping(m_nodes[node].size, fl, sl);
+
+		uint32& head = m_bins[fl * SL_COUNT + sl];
+		m_nodes[node].used = false;
+		m_nodes[node].prevFree = NO_NODE;
+		m_nodes[node].nextFree = head;
+		if (head != NO_NODE) {
+			m_nodes[head].prevFree = node;
+		}
+		head = node;
+
+		m_flBitmap |= 1u << fl;
+		m_slBitmaps[fl] |= 1u << sl;
+	}
+
+	void OffsetAllocator::removeFree(uint32 node)
+	{
+		Node& block = m_nodes[node];
+
+		if (block.prevFree != NO_NODE) {
+			m_nodes[block.prevFree].nextFree = block.nextFree;
+		}
+		else {
+			uint32 fl = 0;
+			uint32 sl = 0;
+			mapping(block.size, fl, sl);
+
+			m_bins[fl * SL_COUNT + sl] = block.nextFree;
+			if (block.nextFree == NO_NODE) {
+				m_slBitmaps[fl] &= ~(1u << sl);
+				if (m_slBitmaps[fl] == 0) {
+					m_flBitmap &= ~(1u << fl);
+				}
+			}
+		}
+
+		if (block.nextFree != NO_NODE) {
+			m_nodes[block.nextFree].prevFree = block.prevFree;
+		}
+
+		block.prevFree = NO_NODE;
+		block.nextFree = NO_NODE;
+	}
+
+	OffsetAllocation OffsetAllocator::allocate(uint32 size)
+	{
+		OffsetAllocation allocation;
+		if (size == 0 || size > m_size - m_used) {
+			return allocation;
+		}
+
+		// Round up to start of next bin, so that any block of found bin fits
+		uint32 rounded = size;
+		if (size >= SL_COUNT) {
+			rounded += (1u << (highestBit(size) - SL_BITS)) - 1;
+		}
+
+		uint32 fl = 0;
+		uint32 sl = 0;
+		mapping(rounded, fl, sl);
+
+		uint32 node = NO_NODE;
+
+		uint32 slBitmap = fl < FL_COUNT ? m_slBitmaps[fl] & (~0u << sl) : 0;
+		if (slBitmap == 0) {
+			const uint32 flBitmap = fl + 1 < FL_COUNT ? m_flBitmap & (~0u << (fl + 1)) : 0;
+			if (flBitmap != 0) {
+				fl = lowestBit(flBitmap);
+				slBitmap = m_slBitmaps[fl];
+			}
+		}
+
+		if (slBitmap != 0) {
+			sl = lowestBit(slBitmap);
+			node = m_bins[fl * SL_COUNT + sl];
+		}
+		else {
+			// Bin of exact size may still have block big enough
+			mapping(size, fl, sl);
+			for (uint32 candidate = m_bins[fl * SL_COUNT + sl]; candidate != NO_NODE; candidate = m_nodes[candidate].nextFree) {
+				if (m_nodes[candidate].size >= size) {
+					node = candidate;
+					break;
+				}
+			}
+		}
+
+		if (node == NO_NODE) {
+			return allocation;
+		}
+
+		removeFree(node);
+
+		// Rest of block goes back to free bins
+		if (m_nodes[node].size > size) {
+			const uint32 remainder = createNode();
+			Node& block = m_nodes[node];
+			Node& rest = m_nodes[remainder];
+
+			rest.offset = block.offset + size;
+			rest.size = block.size - size;
+			rest.prevPhysical = node;
+			rest.nextPhysical = block.nextPhysical;
+			if (block.nextPhysical != NO_NODE) {
+				m_nodes[block.nextPhysical].prevPhysical = remainder;
+			}
+
+			block.nextPhysical = remainder;
+			block.size = size;
+
+			insertFree(remainder);
+		}
+
+		m_nodes[node].used = true;
+		m_used += size;
+
+		allocation.offset = m_nodes[node].offset;
+		allocation.node = node;
+		return allocation;
+	}
+
+	void OffsetAllocator::free(const OffsetAllocation& allocation)
+	{
+		if (!allocation.isValid()) {
+			return;
+		}
+
+		uint32 node = allocation.node;
+		if (node >= m_nodes.size() || !m_nodes[node].used) {
+			log::error("Freeing offset %u which is not allocated", allocation.offset);
+			return;
+		}
+
+		m_used -= m_nodes[node].size;
+		m_nodes[node].used = false;
+
+		// Merge with free neighbours
+		const uint32 prev = m_nodes[node].prevPhysical;
+		if (prev != NO_NODE && !m_nodes[prev].used) {
+			removeFree(prev);
+
+			m_nodes[prev].size += m_nodes[node].size;
+			m_nodes[prev].nextPhysical = m_nodes[node].nextPhysical;
+			if (m_nodes[node].nextPhysical != NO_NODE) {
+				m_nodes[m_nodes[node].nextPhysical].prevPhysical = prev;
+			}
+
+			releaseNode(node);
+			node = prev;
+		}
+
+		const uint32 next = m_nodes[node].nextPhysical;
+		if (next != NO_NODE && !m_nodes[next].used) {
+			removeFree(next);
+
+			m_nodes[node].size += m_nodes[next].size;
+			m_nodes[node].nextPhysical = m_nodes[next].nextPhysical;
+			if (m_nodes[next].nextPhysical != NO_NODE) {
+				m_nodes[m_nodes[next].nextPhysical].prevPhysical = node;
+			}
+
+			releaseNode(next);
+		}
+
+		insertFree(node);
+	}
+
+	uint32 OffsetAllocator::getAllocationSize(const OffsetAllocation& allocation) const
+	{
+		if (!allocation.isValid() || allocation.node >= m_nodes.size()) {
+			return 0;
+		}
+		return m_nodes[allocation.node].size;
+	}
+
+	uint32 OffsetAllocator::getLargestFree() const
+	{
+		if (m_flBitmap == 0) {
+			return 0;
+		}
+
+		const uint32 fl = highestBit(m_flBitmap);
+		const uint32 sl = highestBit(m_slBitmaps[fl]);
+
+		uint32 largest = 0;
+		for (uint32 node = m_bins[fl * SL_COUNT + sl]; node != NO_NODE; node = m_nodes[node].nextFree) {
+			if (m_nodes[node].size > largest) {
+				largest = m_nodes[node].size;
+			}
+		}
+		return largest;
+	}
+}
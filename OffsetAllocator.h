@@ -0,0 +1,99 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	struct OffsetAllocation
+	{
+		static const uint32 INVALID = ~0u;
+
+		uint32 offset = INVALID;
+		// Internal block, needed by free
+		uint32 node = INVALID;
+
+		bool isValid() const {
+			return offset != INVALID;
+		}
+	};
+
+	// Two level segregated fit (TLSF) allocator of ranges in [0, size), memory itself lives elsewhere
+	// (GPU buffer). Allocation and free are O(1): free blocks are kept in bins found through two bitmaps,
+	// neighbours are merged when freed.
+	// Units are up to user (bytes, vertices, indices).
+	class OffsetAllocator
+	{
+	public:
+		explicit OffsetAllocator(uint32 size);
+
+		// Returns invalid allocation if there is no free block big enough
+		OffsetAllocation allocate(uint32 size);
+
+		void free(const OffsetAllocation& allocation);
+
+		// Forgets all allocations, size may change
+		void reset(uint32 size);
+
+		uint32 getAllocationSize(const OffsetAllocation& allocation) const;
+
+		uint32 getSize() const {
+			return m_size;
+		}
+
+		uint32 getUsed() const {
+			return m_used;
+		}
+
+		uint32 getFree() const {
+			return m_size - m_used;
+		}
+
+		// Biggest allocation that would succeed now
+		uint32 getLargestFree() const;
+
+	private:
+		// Second level splits every power of two range into 2^SL_BITS bins
+		static const uint32 SL_BITS = 3;
+		static const uint32 SL_COUNT = 1 << SL_BITS;
+		static const uint32 FL_COUNT = 32;
+		static const uint32 NO_NODE = ~0u;
+
+		struct Node
+		{
+			uint32 offset = 0;
+			uint32 size = 0;
+			// Neighbours in address order
+			uint32 prevPhysical = NO_NODE;
+			uint32 nextPhysical = NO_NODE;
+			// Links in free list of bin
+			uint32 prevFree = NO_NODE;
+			uint32 nextFree = NO_NODE;
+			bool used = false;
+		};
+
+		// Bin holding blocks of given size
+		static void mapping(uint32 size, uint32& fl, uint32& sl);
+
+		uint32 createNode();
+		void releaseNode(uint32 node);
+
+		void insertFree(uint32 node);
+		void removeFree(uint32 node);
+
+		std::vector<Node> m_nodes;
+		std::vector<uint32> m_unusedNodes;
+
+		// Bit per first level with non empty bins, bit per non empty bin of every first level
+		uint32 m_flBitmap = 0;
+		uint32 m_slBitmaps[FL_COUNT] = {};
+		uint32 m_bins[FL_COUNT * SL_COUNT];
+
+		uint32 m_size = 0;
+		uint32 m_used = 0;
+	};
+}
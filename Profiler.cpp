@@ -0,0 +1,410 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "Log.h"
+
+namespace exa
+{
+	std::atomic<bool> Profiler::s_enabled{ EXA_PROFILER_ENABLED != 0 };
+
+	namespace
+	{
+		thread_local ProfileEventRing* s_threadRing = nullptr;
+
+		// Trace viewers expect microseconds
+		double toMicroseconds(uint64 ticks)
+		{
+			return Clock::toSeconds(ticks) * 1000000.0;
+		}
+
+		// GPU events are shown as separate thread in trace
+		const uint32 GPU_TRACK_INDEX = 1000;
+
+		// Writes string as JSON string literal
+		void writeJsonString(std::ostream& stream, const char* text)
+		{
+			stream << '"';
+			for (const char* c = text; *c != '\0'; c++) {
+				switch (*c) {
+					case '"':
+						stream << "\\\"";
+						break;
+					case '\\':
+						stream << "\\\\";
+						break;
+					case '\n':
+						stream << "\\n";
+						break;
+					case '\t':
+						stream << "\\t";
+						break;
+					default:
+						if (static_cast<unsigned char>(*c) < 0x20) {
+							char escaped[8];
+							snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(*c));
+							stream << escaped;
+						}
+						else {
+							stream << *c;
+						}
+						break;
+				}
+			}
+			stream << '"';
+		}
+	}
+
+	ProfileEventRing::ProfileEventRing(uint32 threadIndex)
+		: m_events(CAPACITY), m_threadIndex(threadIndex)
+	{
+	}
+
+	bool ProfileEventRing::push(const ProfileEvent& event)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		const size_t next = (head + 1) % CAPACITY;
+
+		if (next == m_tail.load(std::memory_order_acquire)) {
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		m_events[head] = event;
+		m_head.store(next, std::memory_order_release);
+		return true;
+	}
+
+	void ProfileEventRing::drain(std::vector<ProfileEvent>& events)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		const size_t head = m_head.load(std::memory_order_acquire);
+
+		while (tail != head) {
+			events.push_back(m_events[tail]);
+			tail = (tail + 1) % CAPACITY;
+		}
+
+		m_tail.store(tail, std::memory_order_release);
+	}
+
+	ProfileEventRing* Profiler::getThreadRing()
+	{
+		if (s_threadRing == nullptr) {
+			// Once per thread
+			std::lock_guard<std::mutex> lock(m_ringsMutex);
+			m_rings.emplace_back(new ProfileEventRing(static_cast<uint32>(m_rings.size())));
+			s_threadRing = m_rings.back().get();
+		}
+		return s_threadRing;
+	}
+
+	void Profiler::setThreadName(const char* name)
+	{
+		ProfileEventRing* ring = getThreadRing();
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		ring->name = name;
+	}
+
+	void Profiler::setHistorySize(size_t frames)
+	{
+		std::lock_guard<std::mutex> lock(m_framesMutex);
+		m_historySize = std::max<size_t>(frames, 1);
+		while (m_frames.size() > m_historySize) {
+			m_frames.pop_front();
+		}
+	}
+
+	void Profiler::record(const char* name, uint64 start, uint64 end)
+	{
+		ProfileEventRing* ring = getThreadRing();
+
+		ProfileEvent event;
+		event.name = name;
+		event.start = start;
+		event.end = end;
+		event.threadIndex = ring->getThreadIndex();
+
+		ring->push(event);
+	}
+
+	void Profiler::beginFrame(uint64 frameIndex)
+	{
+		const uint64 now = Clock::now();
+
+		if (m_frameStarted) {
+			m_currentFrame.end = now;
+
+			{
+				std::lock_guard<std::mutex> lock(m_ringsMutex);
+				for (auto& ring : m_rings) {
+					ring->drain(m_currentFrame.cpuEvents);
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(m_framesMutex);
+			m_frames.push_back(std::move(m_currentFrame));
+			while (m_frames.size() > m_historySize) {
+				m_frames.pop_front();
+			}
+		}
+
+		m_currentFrame = ProfileFrame{};
+		m_currentFrame.frameIndex = frameIndex;
+		m_currentFrame.start = now;
+		m_frameStarted = isEnabled();
+	}
+
+	void Profiler::beginGpuFrame(uint64 frameIndex)
+	{
+		if (!isEnabled()) {
+			m_gpuFrameActive = false;
+			return;
+		}
+
+		// Synchronous query, done once instead of every frame
+		if (!m_gpuClockSynced) {
+			exaglGetInteger64v(GL_TIMESTAMP, &m_gpuClockBase);
+			m_cpuClockBase = Clock::now();
+			m_gpuClockSynced = true;
+		}
+
+		// Frames finish in order, first one not available ends resolving, nothing waits for GPU
+		while (!m_gpuFrames.empty() && resolveGpuFrame(m_gpuFrames.front())) {
+			m_gpuFrames.pop_front();
+		}
+
+		while (m_gpuFrames.size() >= MAX_PENDING_GPU_FRAMES) {
+			for (const auto& scope : m_gpuFrames.front().scopes) {
+				m_freeQueries.push_back(scope.startQuery);
+				m_freeQueries.push_back(scope.endQuery);
+			}
+			m_gpuFrames.pop_front();
+		}
+
+		m_gpuFrames.emplace_back();
+		m_gpuFrames.back().frameIndex = frameIndex;
+
+		m_gpuFrameActive = true;
+	}
+
+	bool Profiler::resolveGpuFrame(GpuFrame& frame)
+	{
+		// Nested scopes end in reverse order, so every end query is checked, none of the checks blocks
+		for (const auto& scope : frame.scopes) {
+			GLuint64 available = 0;
+			exaglGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == 0) {
+				return false;
+			}
+		}
+
+		std::vector<ProfileEvent> events;
+		events.reserve(frame.scopes.size());
+
+		const double ticksPerNanosecond = static_cast<double>(Clock::frequency()) / 1000000000.0;
+
+		for (const auto& scope : frame.scopes) {
+			GLuint64 start = 0;
+			GLuint64 end = 0;
+			exaglGetQueryObjectui64v(scope.startQuery, GL_QUERY_RESULT, &start);
+			exaglGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &end);
+
+			ProfileEvent event;
+			event.name = scope.name;
+			event.start = m_cpuClockBase + static_cast<uint64>(static_cast<double>(static_cast<GLint64>(start) - m_gpuClockBase) * ticksPerNanosecond);
+			event.end = event.start + static_cast<uint64>(static_cast<double>(end - start) * ticksPerNanosecond);
+			event.threadIndex = GPU_TRACK_INDEX;
+			events.push_back(event);
+
+			m_freeQueries.push_back(scope.startQuery);
+			m_freeQueries.push_back(scope.endQuery);
+		}
+
+		frame.scopes.clear();
+
+		std::lock_guard<std::mutex> lock(m_framesMutex);
+		for (auto& historyFrame : m_frames) {
+			if (historyFrame.frameIndex == frame.frameIndex) {
+				historyFrame.gpuEvents = std::move(events);
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	int Profiler::beginGpuScope(const char* name)
+	{
+		if (!m_gpuFrameActive) {
+			return -1;
+		}
+
+		GpuScope scope;
+		scope.name = name;
+
+		GLuint queries[2] = { 0, 0 };
+		for (GLuint& query : queries) {
+			if (m_freeQueries.empty()) {
+				exaglGenQueries(1, &query);
+			}
+			else {
+				query = m_freeQueries.back();
+				m_freeQueries.pop_back();
+			}
+		}
+
+		scope.startQuery = queries[0];
+		scope.endQuery = queries[1];
+
+		// Timestamps (unlike GL_TIME_ELAPSED) may be nested
+		exaglQueryCounter(scope.startQuery, GL_TIMESTAMP);
+
+		GpuFrame& frame = m_gpuFrames.back();
+		frame.scopes.push_back(scope);
+		return static_cast<int>(frame.scopes.size() - 1);
+	}
+
+	void Profiler::endGpuScope(int scope)
+	{
+		if (!m_gpuFrameActive) {
+			return;
+		}
+
+		GpuFrame& frame = m_gpuFrames.back();
+		if (scope < 0 || static_cast<size_t>(scope) >= frame.scopes.size()) {
+			return;
+		}
+		exaglQueryCounter(frame.scopes[scope].endQuery, GL_TIMESTAMP);
+	}
+
+	void Profiler::releaseGpuResources()
+	{
+		for (auto& frame : m_gpuFrames) {
+			for (const auto& scope : frame.scopes) {
+				m_freeQueries.push_back(scope.startQuery);
+				m_freeQueries.push_back(scope.endQuery);
+			}
+		}
+		m_gpuFrames.clear();
+
+		if (!m_freeQueries.empty()) {
+			exaglDeleteQueries(static_cast<GLsizei>(m_freeQueries.size()), m_freeQueries.data());
+			m_freeQueries.clear();
+		}
+
+		m_gpuFrameActive = false;
+		m_gpuClockSynced = false;
+	}
+
+	size_t Profiler::getFrames(std::vector<ProfileFrame>& frames, size_t count) const
+	{
+		std::lock_guard<std::mutex> lock(m_framesMutex);
+
+		count = std::min(count, m_frames.size());
+		frames.assign(m_frames.end() - count, m_frames.end());
+		return count;
+	}
+
+	double Profiler::getAverageTime(const char* name, size_t frames) const
+	{
+		std::lock_guard<std::mutex> lock(m_framesMutex);
+
+		frames = std::min(frames, m_frames.size());
+		if (frames == 0) {
+			return 0.0;
+		}
+
+		uint64 total = 0;
+		for (auto it = m_frames.end() - frames; it != m_frames.end(); ++it) {
+			for (const auto& event : it->cpuEvents) {
+				if (event.name == name || strcmp(event.name, name) == 0) {
+					total += event.end - event.start;
+				}
+			}
+		}
+
+		return Clock::toMilliseconds(total) / static_cast<double>(frames);
+	}
+
+	bool Profiler::exportChromeTrace(const char* filename) const
+	{
+		std::ofstream file(filename);
+		if (!file.is_open()) {
+			log::error("Unable to write trace %s", filename);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_framesMutex);
+
+		if (m_frames.empty()) {
+			log::warning("No profiled frames to export");
+		}
+
+		const uint64 origin = m_frames.empty() ? 0 : m_frames.front().start;
+
+		auto writeEvent = [&](const char* name, uint64 start, uint64 end, uint32 thread, bool& first) {
+			file << (first ? "" : ",\n");
+			file << "{\"name\":";
+			writeJsonString(file, name);
+			file << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread
+				<< ",\"ts\":" << toMicroseconds(start - origin)
+				<< ",\"dur\":" << toMicroseconds(end - start) << "}";
+			first = false;
+		};
+
+		bool first = true;
+
+		file << "{\"traceEvents\":[\n";
+
+		{
+			std::lock_guard<std::mutex> ringsLock(m_ringsMutex);
+			for (const auto& ring : m_rings) {
+				if (!ring->name.empty()) {
+					file << (first ? "" : ",\n");
+					file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->getThreadIndex()
+						<< ",\"args\":{\"name\":";
+					writeJsonString(file, ring->name.c_str());
+					file << "}}";
+					first = false;
+				}
+			}
+		}
+
+		file << (first ? "" : ",\n");
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_TRACK_INDEX
+			<< ",\"args\":{\"name\":\"GPU\"}}";
+		first = false;
+
+		for (const auto& frame : m_frames) {
+			writeEvent("frame", frame.start, frame.end, 0, first);
+
+			for (const auto& event : frame.cpuEvents) {
+				// Events recorded before first kept frame
+				if (event.start < origin) {
+					continue;
+				}
+				writeEvent(event.name, event.start, event.end, event.threadIndex, first);
+			}
+
+			for (const auto& event : frame.gpuEvents) {
+				if (event.start < origin) {
+					continue;
+				}
+				writeEvent(event.name, event.start, event.end, event.threadIndex, first);
+			}
+		}
+
+		file << "\n]}\n";
+
+		log::message("Exported %u profiled frames to %s", static_cast<unsigned int>(m_frames.size()), filename);
+
+		return true;
+	}
+}
@@ -0,0 +1,244 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "exa.h"
+#include "Clock.h"
+
+// Set to 0 to compile all profiling markers out
+#ifndef EXA_PROFILER
+#   define EXA_PROFILER 1
+#endif
+
+// Set to 1 to record from start, otherwise recording starts with Profiler::setEnabled(true)
+#ifndef EXA_PROFILER_ENABLED
+#   define EXA_PROFILER_ENABLED 0
+#endif
+
+#define PROFILER() Profiler::Instance()
+
+#if EXA_PROFILER
+#   define EXA_PROFILE_SCOPE(name) ::exa::ProfileScope EVALUATOR(exaProfileScope, __LINE__)(name)
+#   define EXA_PROFILE_FUNCTION() EXA_PROFILE_SCOPE(__FUNCTION__)
+#   define EXA_PROFILE_GPU_SCOPE(name) ::exa::GpuProfileScope EVALUATOR(exaGpuProfileScope, __LINE__)(name)
+#   define EXA_PROFILE_FRAME(frameIndex) ::exa::Profiler::Instance().beginFrame(frameIndex)
+#   define EXA_PROFILE_GPU_FRAME(frameIndex) ::exa::Profiler::Instance().beginGpuFrame(frameIndex)
+#   define EXA_PROFILE_THREAD(name) ::exa::Profiler::Instance().setThreadName(name)
+#else
+#   define EXA_PROFILE_SCOPE(name)
+#   define EXA_PROFILE_FUNCTION()
+#   define EXA_PROFILE_GPU_SCOPE(name)
+#   define EXA_PROFILE_FRAME(frameIndex)
+#   define EXA_PROFILE_GPU_FRAME(frameIndex)
+#   define EXA_PROFILE_THREAD(name)
+#endif
+
+namespace exa
+{
+	// Timed scope, timestamps are in Clock ticks (GPU timestamps are converted to CPU timeline)
+	struct ProfileEvent
+	{
+		// @note Must be string literal
+		const char* name = nullptr;
+		uint64 start = 0;
+		uint64 end = 0;
+		uint32 threadIndex = 0;
+	};
+
+	struct ProfileFrame
+	{
+		uint64 frameIndex = 0;
+		uint64 start = 0;
+		uint64 end = 0;
+		std::vector<ProfileEvent> cpuEvents;
+		std::vector<ProfileEvent> gpuEvents;
+	};
+
+	// Single producer single consumer lock-free ring of events, one per thread
+	class ProfileEventRing
+	{
+	public:
+		static const size_t CAPACITY = 16384;
+
+		ProfileEventRing(uint32 threadIndex);
+
+		// Called by owner thread only, returns false and drops event if ring is full
+		bool push(const ProfileEvent& event);
+
+		// Called by collecting thread only
+		void drain(std::vector<ProfileEvent>& events);
+
+		uint32 getThreadIndex() const {
+			return m_threadIndex;
+		}
+
+		uint64 getDroppedCount() const {
+			return m_dropped.load(std::memory_order_relaxed);
+		}
+
+		std::string name;
+
+	private:
+		std::vector<ProfileEvent> m_events;
+		std::atomic<size_t> m_head{ 0 };
+		std::atomic<size_t> m_tail{ 0 };
+		std::atomic<uint64> m_dropped{ 0 };
+		uint32 m_threadIndex = 0;
+	};
+
+	// Collects CPU scopes from all threads and GPU timestamp queries, keeps last frames
+	class Profiler
+	{
+	public:
+		// Frames of GPU queries waiting for results, results of older frames are dropped instead of waiting
+		static const size_t MAX_PENDING_GPU_FRAMES = 8;
+
+		// Singleton in Lazy-thread-safe style.
+		static Profiler& Instance()
+		{
+			static Profiler s;
+			return s;
+		}
+
+		// Cheap check used by every marker
+		static inline bool isEnabled() {
+			return s_enabled.load(std::memory_order_relaxed);
+		}
+
+		void setEnabled(bool enabled) {
+			s_enabled.store(enabled, std::memory_order_relaxed);
+		}
+
+		// Number of frames kept for queries and export
+		void setHistorySize(size_t frames);
+
+		// Names calling thread in exported trace
+		void setThreadName(const char* name);
+
+		// Records finished CPU scope of calling thread
+		void record(const char* name, uint64 start, uint64 end);
+
+		// Closes previous frame (collects events of all threads) and starts new one.
+		// @note Must be called from main thread
+		void beginFrame(uint64 frameIndex);
+
+		// Reads back timestamp queries of old frames whose results are available and starts queries for new one.
+		// @note Must be called from thread owning OpenGL context
+		void beginGpuFrame(uint64 frameIndex);
+
+		// Returns scope index or -1 if GPU profiling is not active
+		int beginGpuScope(const char* name);
+
+		void endGpuScope(int scope);
+
+		// Deletes query objects, must be called while OpenGL context is current
+		void releaseGpuResources();
+
+		// Copies up to count last finished frames (oldest first)
+		size_t getFrames(std::vector<ProfileFrame>& frames, size_t count) const;
+
+		// Average duration of named CPU scope over last frames in milliseconds
+		double getAverageTime(const char* name, size_t frames) const;
+
+		// Writes kept frames in Chrome trace event format (chrome://tracing, ui.perfetto.dev)
+		bool exportChromeTrace(const char* filename) const;
+
+	private:
+		Profiler() {}
+		~Profiler() {}
+
+		Profiler(Profiler const&) = delete;
+		Profiler& operator= (Profiler const&) = delete;
+
+		ProfileEventRing* getThreadRing();
+
+
+		static std::atomic<bool> s_enabled;
+
+		// Rings of all threads that recorded something
+		mutable std::mutex m_ringsMutex;
+		std::vector<std::unique_ptr<ProfileEventRing>> m_rings;
+
+		mutable std::mutex m_framesMutex;
+		std::deque<ProfileFrame> m_frames;
+		size_t m_historySize = 120;
+
+		ProfileFrame m_currentFrame;
+		bool m_frameStarted = false;
+
+		struct GpuScope
+		{
+			const char* name;
+			GLuint startQuery;
+			GLuint endQuery;
+		};
+
+		struct GpuFrame
+		{
+			uint64 frameIndex = 0;
+			std::vector<GpuScope> scopes;
+		};
+
+		// Oldest first, last one is recorded
+		std::deque<GpuFrame> m_gpuFrames;
+		bool m_gpuFrameActive = false;
+		std::vector<GLuint> m_freeQueries;
+
+		// GPU and CPU time taken at the same moment once, used to put GPU events on CPU timeline
+		bool m_gpuClockSynced = false;
+		GLint64 m_gpuClockBase = 0;
+		uint64 m_cpuClockBase = 0;
+
+		// Returns false if results of frame are not available yet
+		bool resolveGpuFrame(GpuFrame& frame);
+	};
+
+	// Records CPU time of enclosing scope, use EXA_PROFILE_SCOPE
+	class ProfileScope
+	{
+	public:
+		explicit ProfileScope(const char* name)
+			: m_name(name), m_start(Profiler::isEnabled() ? Clock::now() : 0)
+		{
+		}
+
+		~ProfileScope()
+		{
+			if (m_start != 0) {
+				Profiler::Instance().record(m_name, m_start, Clock::now());
+			}
+		}
+
+	private:
+		const char* m_name;
+		uint64 m_start;
+	};
+
+	// Records GPU time of commands issued in enclosing scope, use EXA_PROFILE_GPU_SCOPE
+	class GpuProfileScope
+	{
+	public:
+		explicit GpuProfileScope(const char* name)
+			: m_scope(Profiler::isEnabled() ? Profiler::Instance().beginGpuScope(name) : -1)
+		{
+		}
+
+		~GpuProfileScope()
+		{
+			if (m_scope >= 0) {
+				Profiler::Instance().endGpuScope(m_scope);
+			}
+		}
+
+	private:
+		int m_scope;
+	};
+}
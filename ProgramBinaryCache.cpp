@@ -0,0 +1,224 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "ProgramBinaryCache.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#   include <direct.h>
+#else
+#   include <sys/stat.h>
+#endif
+
+#include "File.h"
+#include "Hash.h"
+#include "Log.h"
+
+namespace exa
+{
+	namespace
+	{
+		// "EXPB"
+		const uint32 CACHE_MAGIC = 0x42505845;
+		// Increase when file layout changes
+		const uint32 CACHE_VERSION = 1;
+
+		struct CacheHeader
+		{
+			uint32 magic;
+			uint32 version;
+			uint64 key;
+			uint32 format;
+			uint32 size;
+		};
+
+		// Creates every missing directory of path
+		bool createDirectories(const std::string& path)
+		{
+			for (size_t i = 1; i <= path.size(); i++) {
+				if (i != path.size() && path[i] != '/' && path[i] != '\\') {
+					continue;
+				}
+				std::string directory = path.substr(0, i);
+#ifdef _WIN32
+				int result = _mkdir(directory.c_str());
+#else
+				int result = mkdir(directory.c_str(), 0755);
+#endif
+				if (result != 0 && errno != EEXIST) {
+					log::error("Unable to create directory %s", directory.c_str());
+					return false;
+				}
+			}
+			return true;
+		}
+
+		uint64 hashString(const GLubyte* string, uint64 hash)
+		{
+			const char* text = reinterpret_cast<const char*>(string);
+			if (text == nullptr) {
+				return hash;
+			}
+			return hashFnv1a64(text, strlen(text) + 1, hash);
+		}
+	}
+
+	void ProgramBinaryCache::setDirectory(const char* directory)
+	{
+		m_directory = directory;
+		if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\') {
+			m_directory += '/';
+		}
+	}
+
+	void ProgramBinaryCache::init()
+	{
+		m_initialized = true;
+
+		GLint numFormats = 0;
+		if (GLAD_GL_ARB_get_program_binary || GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1)) {
+			exaglGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+		}
+
+		// Some drivers expose extension without any format
+		m_supported = numFormats > 0;
+
+		m_driverHash = FNV1A64_OFFSET;
+		m_driverHash = hashString(exaglGetString(GL_VENDOR), m_driverHash);
+		m_driverHash = hashString(exaglGetString(GL_RENDERER), m_driverHash);
+		m_driverHash = hashString(exaglGetString(GL_VERSION), m_driverHash);
+
+		if (m_supported) {
+			log::debug("Program binary cache in %s", m_directory.c_str());
+		}
+		else {
+			log::debug("Program binaries are not supported by driver, shaders are compiled on every start");
+		}
+	}
+
+	bool ProgramBinaryCache::isAvailable()
+	{
+		if (!m_initialized) {
+			init();
+		}
+		return m_enabled && m_supported;
+	}
+
+	uint64 ProgramBinaryCache::computeKey(const GLenum* types, const std::string* sources, size_t count)
+	{
+		if (!m_initialized) {
+			init();
+		}
+
+		uint64 hash = hashFnv1a64(&m_driverHash, sizeof(m_driverHash));
+		for (size_t i = 0; i < count; i++) {
+			hash = hashFnv1a64(&types[i], sizeof(GLenum), hash);
+			hash = hashFnv1a64(sources[i].data(), sources[i].size(), hash);
+		}
+		return hash;
+	}
+
+	std::string ProgramBinaryCache::getPath(uint64 key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016" PRIx64 ".bin", key);
+		return m_directory + name;
+	}
+
+	bool ProgramBinaryCache::load(uint64 key, GLuint program)
+	{
+		const std::string path = getPath(key);
+
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			m_misses++;
+			return false;
+		}
+
+		CacheHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key || header.size == 0) {
+			log::warning("Ignoring invalid program cache file %s", path.c_str());
+			m_misses++;
+			return false;
+		}
+
+		std::vector<char> binary(header.size);
+		if (!file.read(binary.data(), binary.size())) {
+			log::warning("Ignoring truncated program cache file %s", path.c_str());
+			m_misses++;
+			return false;
+		}
+
+		exaglProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+		// Driver may reject binary after update even if identity strings didn't change
+		GLint success = GL_FALSE;
+		exaglGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (success == GL_FALSE) {
+			log::debug("Program binary %s rejected by driver", path.c_str());
+			m_misses++;
+			return false;
+		}
+
+		m_hits++;
+		return true;
+	}
+
+	bool ProgramBinaryCache::store(uint64 key, GLuint program)
+	{
+		GLint length = 0;
+		exaglGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return false;
+		}
+
+		std::vector<char> binary(static_cast<size_t>(length));
+		GLenum format = 0;
+		GLsizei written = 0;
+		exaglGetProgramBinary(program, length, &written, &format, binary.data());
+		if (written <= 0) {
+			return false;
+		}
+
+		if (!createDirectories(m_directory)) {
+			return false;
+		}
+
+		CacheHeader header;
+		header.magic = CACHE_MAGIC;
+		header.version = CACHE_VERSION;
+		header.key = key;
+		header.format = format;
+		header.size = static_cast<uint32>(written);
+
+		const std::string path = getPath(key);
+		const std::string temporaryPath = path + ".tmp";
+
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+				!file.write(binary.data(), written)) {
+				log::error("Unable to write program cache file %s", temporaryPath.c_str());
+				file.close();
+				std::remove(temporaryPath.c_str());
+				return false;
+			}
+		}
+
+		// Readers never see partially written file, entry is replaced atomically
+		if (!File::replace(temporaryPath.c_str(), path.c_str())) {
+			log::error("Unable to rename %s to %s", temporaryPath.c_str(), path.c_str());
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,78 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <string>
+
+#include "exa.h"
+
+#define PROGRAMCACHE() ProgramBinaryCache::Instance()
+
+namespace exa
+{
+	// On-disk cache of linked programs (ARB_get_program_binary).
+	// Binaries are valid only for the driver that produced them, so driver identity is part of the key.
+	class ProgramBinaryCache
+	{
+	public:
+		// Singleton in Lazy-thread-safe style.
+		static ProgramBinaryCache& Instance()
+		{
+			static ProgramBinaryCache s;
+			return s;
+		}
+
+		void setEnabled(bool enabled) {
+			m_enabled = enabled;
+		}
+
+		// Directory for cache files, created on first store (PROJECT_SHADER_CACHE_DIR by default)
+		void setDirectory(const char* directory);
+
+		// True if enabled and driver supports at least one binary format.
+		// @note Must be called with OpenGL context current
+		bool isAvailable();
+
+		// Hashes stage sources (injected defines are part of source) together with driver vendor, renderer and version
+		uint64 computeKey(const GLenum* types, const std::string* sources, size_t count);
+
+		// Returns true if cached binary was accepted by driver and program is linked
+		bool load(uint64 key, GLuint program);
+
+		// Writes binary of linked program to temporary file and renames it over cache entry
+		bool store(uint64 key, GLuint program);
+
+		uint32 getHits() const {
+			return m_hits;
+		}
+
+		uint32 getMisses() const {
+			return m_misses;
+		}
+
+	private:
+		ProgramBinaryCache() {}
+		~ProgramBinaryCache() {}
+
+		ProgramBinaryCache(ProgramBinaryCache const&) = delete;
+		ProgramBinaryCache& operator= (ProgramBinaryCache const&) = delete;
+
+		// Queries driver support and identity, done once
+		void init();
+
+		std::string getPath(uint64 key) const;
+
+		bool m_initialized = false;
+		bool m_supported = false;
+		bool m_enabled = true;
+
+		std::string m_directory = PROJECT_SHADER_CACHE_DIR;
+
+		// Hash of GL_VENDOR, GL_RENDERER and GL_VERSION
+		uint64 m_driverHash = 0;
+
+		uint32 m_hits = 0;
+		uint32 m_misses = 0;
+	};
+}
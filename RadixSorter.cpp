@@ -0,0 +1,192 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "RadixSorter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		const uint32 DIGIT_BITS = 8;
+		const uint32 BUCKETS = 1 << DIGIT_BITS;
+		const uint32 PASSES = 64 / DIGIT_BITS;
+
+		inline uint32 digit(uint64 key, uint32 shift)
+		{
+			return static_cast<uint32>(key >> shift) & (BUCKETS - 1);
+		}
+	}
+
+	void RadixSorter::sort(uint64* keys, uint32* values, uint32 count)
+	{
+		if (count < 2) {
+			return;
+		}
+
+		if (m_jobSystem != nullptr && m_jobSystem->getNumThreads() > 1 && count >= PARALLEL_THRESHOLD) {
+			sortParallel(keys, values, count);
+			return;
+		}
+
+		EXA_PROFILE_FUNCTION();
+
+		m_tempKeys.resize(count);
+		m_tempValues.resize(count);
+
+		// Histograms of all passes in one read
+		uint32 histograms[PASSES][BUCKETS] = {};
+		for (uint32 i = 0; i < count; i++) {
+			const uint64 key = keys[i];
+			for (uint32 pass = 0; pass < PASSES; pass++) {
+				histograms[pass][digit(key, pass * DIGIT_BITS)]++;
+			}
+		}
+
+		uint64* sourceKeys = keys;
+		uint32* sourceValues = values;
+		uint64* targetKeys = m_tempKeys.data();
+		uint32* targetValues = m_tempValues.data();
+
+		for (uint32 pass = 0; pass < PASSES; pass++) {
+			const uint32 shift = pass * DIGIT_BITS;
+			uint32* histogram = histograms[pass];
+
+			if (histogram[digit(sourceKeys[0], shift)] == count) {
+				continue;
+			}
+
+			uint32 offset = 0;
+			for (uint32 bucket = 0; bucket < BUCKETS; bucket++) {
+				const uint32 bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+
+			for (uint32 i = 0; i < count; i++) {
+				const uint32 target = histogram[digit(sourceKeys[i], shift)]++;
+				targetKeys[target] = sourceKeys[i];
+				targetValues[target] = sourceValues[i];
+			}
+
+			std::swap(sourceKeys, targetKeys);
+			std::swap(sourceValues, targetValues);
+		}
+
+		if (sourceKeys != keys) {
+			memcpy(keys, sourceKeys, count * sizeof(uint64));
+			memcpy(values, sourceValues, count * sizeof(uint32));
+		}
+	}
+
+	void RadixSorter::sortParallel(uint64* keys, uint32* values, uint32 count)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		m_tempKeys.resize(count);
+		m_tempValues.resize(count);
+
+		const uint32 numChunks = m_jobSystem->getNumThreads();
+		const uint32 chunkSize = (count + numChunks - 1) / numChunks;
+		m_chunkHistograms.resize(numChunks * PASSES * BUCKETS);
+
+		uint32* chunkHistograms = m_chunkHistograms.data();
+
+		// Histograms of all passes per chunk, used by first pass and to find passes to skip
+		m_jobSystem->parallelFor(numChunks, 1, [=](uint32 begin, uint32 end) {
+			for (uint32 chunk = begin; chunk < end; chunk++) {
+				uint32* histograms = chunkHistograms + chunk * PASSES * BUCKETS;
+				memset(histograms, 0, PASSES * BUCKETS * sizeof(uint32));
+
+				const uint32 first = chunk * chunkSize;
+				const uint32 last = std::min(first + chunkSize, count);
+				for (uint32 i = first; i < last; i++) {
+					const uint64 key = keys[i];
+					for (uint32 pass = 0; pass < PASSES; pass++) {
+						histograms[pass * BUCKETS + digit(key, pass * DIGIT_BITS)]++;
+					}
+				}
+			}
+		});
+
+		bool skip[PASSES] = {};
+		for (uint32 pass = 0; pass < PASSES; pass++) {
+			const uint32 bucket = digit(keys[0], pass * DIGIT_BITS);
+			uint32 bucketCount = 0;
+			for (uint32 chunk = 0; chunk < numChunks; chunk++) {
+				bucketCount += chunkHistograms[(chunk * PASSES + pass) * BUCKETS + bucket];
+			}
+			skip[pass] = bucketCount == count;
+		}
+
+		uint64* sourceKeys = keys;
+		uint32* sourceValues = values;
+		uint64* targetKeys = m_tempKeys.data();
+		uint32* targetValues = m_tempValues.data();
+		bool firstPass = true;
+
+		for (uint32 pass = 0; pass < PASSES; pass++) {
+			if (skip[pass]) {
+				continue;
+			}
+
+			const uint32 shift = pass * DIGIT_BITS;
+
+			// Chunks hold different keys after every scatter, only first pass can use initial histograms
+			if (!firstPass) {
+				m_jobSystem->parallelFor(numChunks, 1, [=](uint32 begin, uint32 end) {
+					for (uint32 chunk = begin; chunk < end; chunk++) {
+						uint32* histogram = chunkHistograms + (chunk * PASSES + pass) * BUCKETS;
+						memset(histogram, 0, BUCKETS * sizeof(uint32));
+
+						const uint32 first = chunk * chunkSize;
+						const uint32 last = std::min(first + chunkSize, count);
+						for (uint32 i = first; i < last; i++) {
+							histogram[digit(sourceKeys[i], shift)]++;
+						}
+					}
+				});
+			}
+			firstPass = false;
+
+			// Every bucket is split among chunks in chunk order, so equal keys keep their order
+			uint32 offset = 0;
+			for (uint32 bucket = 0; bucket < BUCKETS; bucket++) {
+				for (uint32 chunk = 0; chunk < numChunks; chunk++) {
+					uint32& entry = chunkHistograms[(chunk * PASSES + pass) * BUCKETS + bucket];
+					const uint32 bucketCount = entry;
+					entry = offset;
+					offset += bucketCount;
+				}
+			}
+
+			m_jobSystem->parallelFor(numChunks, 1, [=](uint32 begin, uint32 end) {
+				for (uint32 chunk = begin; chunk < end; chunk++) {
+					uint32* offsets = chunkHistograms + (chunk * PASSES + pass) * BUCKETS;
+
+					const uint32 first = chunk * chunkSize;
+					const uint32 last = std::min(first + chunkSize, count);
+					for (uint32 i = first; i < last; i++) {
+						const uint32 target = offsets[digit(sourceKeys[i], shift)]++;
+						targetKeys[target] = sourceKeys[i];
+						targetValues[target] = sourceValues[i];
+					}
+				}
+			});
+
+			std::swap(sourceKeys, targetKeys);
+			std::swap(sourceValues, targetValues);
+		}
+
+		if (sourceKeys != keys) {
+			memcpy(keys, sourceKeys, count * sizeof(uint64));
+			memcpy(values, sourceValues, count * sizeof(uint32));
+		}
+	}
+}
@@ -0,0 +1,49 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	class JobSystem;
+
+	// Stable LSD radix sort of 64 bit keys carrying 32 bit values (indices of sorted items), 8 bits per pass.
+	// Passes where all keys share the digit are skipped, so keys with few varying bits (sort keys of
+	// draws, sprites) cost only couple of passes. Scratch memory is kept between calls.
+	// Large arrays are split into one chunk per thread: chunks count their digits and scatter into
+	// disjoint ranges of every bucket in parallel, which keeps the sort stable.
+	class RadixSorter
+	{
+	public:
+		// Smaller arrays are sorted on calling thread
+		static const uint32 PARALLEL_THRESHOLD = 64 * 1024;
+
+		// @param jobSystem nullptr sorts on calling thread only
+		explicit RadixSorter(JobSystem* jobSystem = nullptr)
+			: m_jobSystem(jobSystem)
+		{
+		}
+
+		void sort(uint64* keys, uint32* values, uint32 count);
+
+		void sort(std::vector<uint64>& keys, std::vector<uint32>& values)
+		{
+			sort(keys.data(), values.data(), static_cast<uint32>(keys.size()));
+		}
+
+	private:
+		void sortParallel(uint64* keys, uint32* values, uint32 count);
+
+		JobSystem* m_jobSystem = nullptr;
+
+		std::vector<uint64> m_tempKeys;
+		std::vector<uint32> m_tempValues;
+
+		// Bucket counts, then scatter offsets, of every chunk
+		std::vector<uint32> m_chunkHistograms;
+	};
+}
@@ -0,0 +1,443 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "RenderCommandBuffer.h"
+
+#include <algorithm>
+
+#include "DrawBatcher.h"
+#include "Shader.h"
+#include "VertexArray.h"
+#include "Log.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		// Every packet starts at aligned offset, payload follows padded header
+		const size_t PACKET_ALIGNMENT = 16;
+		const size_t PAYLOAD_OFFSET = PACKET_ALIGNMENT;
+
+		inline size_t alignSize(size_t size)
+		{
+			return (size + PACKET_ALIGNMENT - 1) & ~(PACKET_ALIGNMENT - 1);
+		}
+
+		struct ClearCommand
+		{
+			GLbitfield mask;
+		};
+
+		struct ShaderCommand
+		{
+			Shader* shader;
+		};
+
+		template <typename T>
+		struct UniformCommand
+		{
+			Shader* shader;
+			const char* name;
+			T value;
+		};
+
+		struct TextureCommand
+		{
+			Shader* shader;
+			GLenum target;
+			int index;
+			GLuint texture;
+			const char* uniformName;
+		};
+
+		struct VertexArrayCommand
+		{
+			VertexArray* vertexArray;
+		};
+
+		struct DrawArraysCommand
+		{
+			GLenum mode;
+			GLint first;
+			GLsizei count;
+		};
+
+		struct DrawElementsCommand
+		{
+			GLenum mode;
+			GLsizei count;
+			GLenum type;
+			size_t indexOffset;
+		};
+
+		struct DrawElementsBaseVertexCommand
+		{
+			GLenum mode;
+			GLsizei count;
+			GLenum type;
+			size_t indexOffset;
+			GLint baseVertex;
+		};
+
+		struct DrawArraysInstancedCommand
+		{
+			GLenum mode;
+			GLint first;
+			GLsizei count;
+			GLsizei instanceCount;
+		};
+
+		struct DrawElementsInstancedCommand
+		{
+			GLenum mode;
+			GLsizei count;
+			GLenum type;
+			size_t indexOffset;
+			GLsizei instanceCount;
+			GLint baseVertex;
+		};
+
+		// Followed by draws and draw data
+		struct DrawBatchCommand
+		{
+			DrawBatcher* batcher;
+			GLenum mode;
+			uint32 drawCount;
+			uint32 drawDataSize;
+		};
+
+		struct CallbackCommand
+		{
+			RenderCommandBuffer::Callback func;
+			void* userData;
+		};
+
+		// Followed by data at aligned offset
+		struct DataCallbackCommand
+		{
+			RenderCommandBuffer::DataCallback func;
+			void* userData;
+			size_t size;
+		};
+
+		const size_t DATA_CALLBACK_DATA_OFFSET = alignSize(sizeof(DataCallbackCommand));
+
+		template <typename T>
+		inline const T& payload(const unsigned char* packet)
+		{
+			return *reinterpret_cast<const T*>(packet + PAYLOAD_OFFSET);
+		}
+	}
+
+	RenderCommandBuffer::RenderCommandBuffer(size_t initialCapacity)
+	{
+		m_data.resize(initialCapacity);
+	}
+
+	void RenderCommandBuffer::reset()
+	{
+		m_size = 0;
+		m_commandCount = 0;
+		m_frameStateSize = 0;
+		m_snapshot = FrameSnapshot();
+	}
+
+	void RenderCommandBuffer::setSnapshot(const FrameSnapshot& snapshot)
+	{
+		m_snapshot = snapshot;
+		m_snapshot.state = m_frameStateSize > 0 ? m_frameState.data() : nullptr;
+		m_snapshot.stateSize = m_frameStateSize;
+	}
+
+	void* RenderCommandBuffer::allocateFrameState(size_t size)
+	{
+		m_frameState.resize((size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+		m_frameStateSize = size;
+
+		// Recorded state is visible also if snapshot was set before it
+		m_snapshot.state = m_frameState.data();
+		m_snapshot.stateSize = size;
+
+		return m_frameState.data();
+	}
+
+	void* RenderCommandBuffer::allocate(RenderCommandType type, size_t payloadSize)
+	{
+		static_assert(sizeof(Header) <= PAYLOAD_OFFSET, "Packet header doesn't fit");
+
+		const size_t packetSize = alignSize(PAYLOAD_OFFSET + payloadSize);
+
+		if (m_size + packetSize > m_data.size()) {
+			// Grows rarely, buffers are reused every frame
+			m_data.resize(std::max(m_data.size() * 2, m_size + packetSize));
+		}
+
+		unsigned char* packet = m_data.data() + m_size;
+
+		Header header;
+		header.type = type;
+		header.size = static_cast<uint32>(packetSize);
+		memcpy(packet, &header, sizeof(Header));
+
+		m_size += packetSize;
+		m_commandCount++;
+
+		return packet + PAYLOAD_OFFSET;
+	}
+
+	void RenderCommandBuffer::clear(GLbitfield mask)
+	{
+		push(RenderCommandType::EXA_CLEAR, ClearCommand{ mask });
+	}
+
+	void RenderCommandBuffer::bindShader(Shader* shader)
+	{
+		push(RenderCommandType::EXA_BIND_SHADER, ShaderCommand{ shader });
+	}
+
+	void RenderCommandBuffer::unbindShader()
+	{
+		push(RenderCommandType::EXA_UNBIND_SHADER, ShaderCommand{ nullptr });
+	}
+
+	void RenderCommandBuffer::setUniform(Shader* shader, const char* name, int value)
+	{
+		push(RenderCommandType::EXA_UNIFORM_INT, UniformCommand<int>{ shader, name, value });
+	}
+
+	void RenderCommandBuffer::setUniform(Shader* shader, const char* name, float value)
+	{
+		push(RenderCommandType::EXA_UNIFORM_FLOAT, UniformCommand<float>{ shader, name, value });
+	}
+
+	void RenderCommandBuffer::setUniform(Shader* shader, const char* name, const glm::vec4& value)
+	{
+		push(RenderCommandType::EXA_UNIFORM_VEC4, UniformCommand<glm::vec4>{ shader, name, value });
+	}
+
+	void RenderCommandBuffer::setUniform(Shader* shader, const char* name, const glm::mat4& value)
+	{
+		push(RenderCommandType::EXA_UNIFORM_MAT4, UniformCommand<glm::mat4>{ shader, name, value });
+	}
+
+	void RenderCommandBuffer::activateTexture(Shader* shader, GLenum target, int index, GLuint texture, const char* uniformName)
+	{
+		push(RenderCommandType::EXA_ACTIVATE_TEXTURE, TextureCommand{ shader, target, index, texture, uniformName });
+	}
+
+	void RenderCommandBuffer::bindVertexArray(VertexArray* vertexArray)
+	{
+		push(RenderCommandType::EXA_BIND_VERTEX_ARRAY, VertexArrayCommand{ vertexArray });
+	}
+
+	void RenderCommandBuffer::unbindVertexArray()
+	{
+		push(RenderCommandType::EXA_UNBIND_VERTEX_ARRAY, VertexArrayCommand{ nullptr });
+	}
+
+	void RenderCommandBuffer::drawArrays(GLenum mode, GLint first, GLsizei count)
+	{
+		push(RenderCommandType::EXA_DRAW_ARRAYS, DrawArraysCommand{ mode, first, count });
+	}
+
+	void RenderCommandBuffer::drawElements(GLenum mode, GLsizei count, GLenum type, size_t indexOffset)
+	{
+		push(RenderCommandType::EXA_DRAW_ELEMENTS, DrawElementsCommand{ mode, count, type, indexOffset });
+	}
+
+	void RenderCommandBuffer::drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, size_t indexOffset, GLint baseVertex)
+	{
+		push(RenderCommandType::EXA_DRAW_ELEMENTS_BASE_VERTEX, DrawElementsBaseVertexCommand{ mode, count, type, indexOffset, baseVertex });
+	}
+
+	void RenderCommandBuffer::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount)
+	{
+		push(RenderCommandType::EXA_DRAW_ARRAYS_INSTANCED, DrawArraysInstancedCommand{ mode, first, count, instanceCount });
+	}
+
+	void RenderCommandBuffer::drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, size_t indexOffset, GLsizei instanceCount, GLint baseVertex)
+	{
+		push(RenderCommandType::EXA_DRAW_ELEMENTS_INSTANCED, DrawElementsInstancedCommand{ mode, count, type, indexOffset, instanceCount, baseVertex });
+	}
+
+	void RenderCommandBuffer::drawBatch(DrawBatcher* batcher, GLenum mode, const DrawElementsIndirectCommand* draws, uint32 drawCount, const void* drawData, size_t drawDataSize)
+	{
+		const size_t drawsSize = drawCount * sizeof(DrawElementsIndirectCommand);
+		unsigned char* memory = static_cast<unsigned char*>(allocate(RenderCommandType::EXA_DRAW_BATCH, sizeof(DrawBatchCommand) + drawsSize + drawDataSize));
+
+		const DrawBatchCommand command{ batcher, mode, drawCount, static_cast<uint32>(drawDataSize) };
+		memcpy(memory, &command, sizeof(DrawBatchCommand));
+		memcpy(memory + sizeof(DrawBatchCommand), draws, drawsSize);
+		if (drawDataSize > 0) {
+			memcpy(memory + sizeof(DrawBatchCommand) + drawsSize, drawData, drawDataSize);
+		}
+	}
+
+	void RenderCommandBuffer::callback(Callback func, void* userData)
+	{
+		push(RenderCommandType::EXA_CALLBACK, CallbackCommand{ func, userData });
+	}
+
+	void* RenderCommandBuffer::callback(DataCallback func, void* userData, size_t dataSize)
+	{
+		unsigned char* memory = static_cast<unsigned char*>(allocate(RenderCommandType::EXA_DATA_CALLBACK, DATA_CALLBACK_DATA_OFFSET + dataSize));
+
+		const DataCallbackCommand command{ func, userData, dataSize };
+		memcpy(memory, &command, sizeof(DataCallbackCommand));
+
+		return memory + DATA_CALLBACK_DATA_OFFSET;
+	}
+
+	void RenderCommandBuffer::execute() const
+	{
+		// Replay of one buffer is one frame for GPU
+		EXA_PROFILE_GPU_FRAME(m_snapshot.frameIndex);
+		EXA_PROFILE_SCOPE("replay");
+		EXA_PROFILE_GPU_SCOPE("replay");
+
+		const unsigned char* packet = m_data.data();
+		const unsigned char* end = packet + m_size;
+
+		while (packet < end) {
+			Header header;
+			memcpy(&header, packet, sizeof(Header));
+
+			switch (header.type) {
+
+				case RenderCommandType::EXA_CLEAR:
+				{
+					exaglClear(payload<ClearCommand>(packet).mask);
+					break;
+				}
+
+				case RenderCommandType::EXA_BIND_SHADER:
+				{
+					payload<ShaderCommand>(packet).shader->bind();
+					break;
+				}
+
+				case RenderCommandType::EXA_UNBIND_SHADER:
+				{
+					exaglUseProgram(0);
+					break;
+				}
+
+				case RenderCommandType::EXA_UNIFORM_INT:
+				{
+					const auto& command = payload<UniformCommand<int>>(packet);
+					command.shader->bindUniform(command.name, command.value);
+					break;
+				}
+
+				case RenderCommandType::EXA_UNIFORM_FLOAT:
+				{
+					const auto& command = payload<UniformCommand<float>>(packet);
+					command.shader->bindUniform(command.name, command.value);
+					break;
+				}
+
+				case RenderCommandType::EXA_UNIFORM_VEC4:
+				{
+					const auto& command = payload<UniformCommand<glm::vec4>>(packet);
+					command.shader->bindUniform(command.name, command.value);
+					break;
+				}
+
+				case RenderCommandType::EXA_UNIFORM_MAT4:
+				{
+					const auto& command = payload<UniformCommand<glm::mat4>>(packet);
+					command.shader->bindUniform(command.name, command.value);
+					break;
+				}
+
+				case RenderCommandType::EXA_ACTIVATE_TEXTURE:
+				{
+					const auto& command = payload<TextureCommand>(packet);
+					command.shader->activateTexture(command.target, command.index, command.texture, command.uniformName);
+					break;
+				}
+
+				case RenderCommandType::EXA_BIND_VERTEX_ARRAY:
+				{
+					payload<VertexArrayCommand>(packet).vertexArray->bind();
+					break;
+				}
+
+				case RenderCommandType::EXA_UNBIND_VERTEX_ARRAY:
+				{
+					exaglBindVertexArray(0);
+					break;
+				}
+
+				case RenderCommandType::EXA_DRAW_ARRAYS:
+				{
+					const auto& command = payload<DrawArraysCommand>(packet);
+					exaglDrawArrays(command.mode, command.first, command.count);
+					break;
+				}
+
+				case RenderCommandType::EXA_DRAW_ELEMENTS:
+				{
+					const auto& command = payload<DrawElementsCommand>(packet);
+					exaglDrawElements(command.mode, command.count, command.type,
+						reinterpret_cast<const GLvoid*>(command.indexOffset));
+					break;
+				}
+
+				case RenderCommandType::EXA_DRAW_ELEMENTS_BASE_VERTEX:
+				{
+					const auto& command = payload<DrawElementsBaseVertexCommand>(packet);
+					exaglDrawElementsBaseVertex(command.mode, command.count, command.type,
+						reinterpret_cast<const GLvoid*>(command.indexOffset), command.baseVertex);
+					break;
+				}
+
+				case RenderCommandType::EXA_DRAW_ARRAYS_INSTANCED:
+				{
+					const auto& command = payload<DrawArraysInstancedCommand>(packet);
+					exaglDrawArraysInstanced(command.mode, command.first, command.count, command.instanceCount);
+					break;
+				}
+
+				case RenderCommandType::EXA_DRAW_ELEMENTS_INSTANCED:
+				{
+					const auto& command = payload<DrawElementsInstancedCommand>(packet);
+					exaglDrawElementsInstancedBaseVertex(command.mode, command.count, command.type,
+						reinterpret_cast<const GLvoid*>(command.indexOffset), command.instanceCount, command.baseVertex);
+					break;
+				}
+
+				case RenderCommandType::EXA_DRAW_BATCH:
+				{
+					const auto& command = payload<DrawBatchCommand>(packet);
+					const unsigned char* draws = packet + PAYLOAD_OFFSET + sizeof(DrawBatchCommand);
+					const unsigned char* drawData = draws + command.drawCount * sizeof(DrawElementsIndirectCommand);
+					command.batcher->submit(command.mode, reinterpret_cast<const DrawElementsIndirectCommand*>(draws), command.drawCount,
+						command.drawDataSize > 0 ? drawData : nullptr);
+					break;
+				}
+
+				case RenderCommandType::EXA_CALLBACK:
+				{
+					const auto& command = payload<CallbackCommand>(packet);
+					command.func(command.userData, m_snapshot);
+					break;
+				}
+
+				case RenderCommandType::EXA_DATA_CALLBACK:
+				{
+					const auto& command = payload<DataCallbackCommand>(packet);
+					command.func(command.userData, packet + PAYLOAD_OFFSET + DATA_CALLBACK_DATA_OFFSET, command.size, m_snapshot);
+					break;
+				}
+
+				default:
+					log::error("Unknown render command %d", static_cast<int>(header.type));
+					return;
+			}
+
+			packet += header.size;
+		}
+	}
+}
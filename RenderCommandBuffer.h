@@ -0,0 +1,192 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	class DrawBatcher;
+	class Shader;
+	class VertexArray;
+	struct DrawElementsIndirectCommand;
+
+	// Render command packet types
+	enum class RenderCommandType : std::uint8_t
+	{
+		EXA_CLEAR,
+		EXA_BIND_SHADER,
+		EXA_UNBIND_SHADER,
+		EXA_UNIFORM_INT,
+		EXA_UNIFORM_FLOAT,
+		EXA_UNIFORM_VEC4,
+		EXA_UNIFORM_MAT4,
+		EXA_ACTIVATE_TEXTURE,
+		EXA_BIND_VERTEX_ARRAY,
+		EXA_UNBIND_VERTEX_ARRAY,
+		EXA_DRAW_ARRAYS,
+		EXA_DRAW_ELEMENTS,
+		EXA_DRAW_ELEMENTS_BASE_VERTEX,
+		EXA_DRAW_ARRAYS_INSTANCED,
+		EXA_DRAW_ELEMENTS_INSTANCED,
+		EXA_DRAW_BATCH,
+		EXA_CALLBACK,
+		EXA_DATA_CALLBACK,
+		EXA_TOTAL_ITEMS
+	};
+
+	// Immutable game state handed over to render side together with commands of the frame.
+	// Every command buffer owns its copy, so render side never reads state game thread is changing.
+	struct FrameSnapshot
+	{
+		uint64 frameIndex = 0;
+		// Blend factor between two last simulation states
+		double interpolationAlpha = 0.0;
+		// Simulated time in seconds
+		double simulationTime = 0.0;
+		int32 width = 0;
+		int32 height = 0;
+		// Present settings of frame (FramePacer)
+		int32 swapInterval = 1;
+		bool lowLatency = false;
+
+		// Game state copied by RenderCommandBuffer::setFrameState, owned by command buffer
+		const void* state = nullptr;
+		size_t stateSize = 0;
+
+		// nullptr if no state of type T was recorded
+		template <typename T>
+		const T* getState() const {
+			return stateSize == sizeof(T) ? static_cast<const T*>(state) : nullptr;
+		}
+	};
+
+	// Linear memory of compact command packets recorded by game thread and replayed by thread owning OpenGL context.
+	// @note Referenced objects (shaders, vertex arrays, uniform names) must outlive the frame
+	class RenderCommandBuffer
+	{
+	public:
+		// Called on render thread with snapshot of the frame being replayed.
+		// userData is render side object (owned by render thread while frames are in flight), game state
+		// must be read from snapshot or data recorded with command, never through userData
+		using Callback = void(*)(void* userData, const FrameSnapshot& snapshot);
+
+		// Called on render thread with data recorded together with command
+		using DataCallback = void(*)(void* userData, const void* data, size_t size, const FrameSnapshot& snapshot);
+
+		explicit RenderCommandBuffer(size_t initialCapacity = 64 * 1024);
+
+		// Drops recorded commands, keeps memory
+		void reset();
+
+		// Keeps state recorded by setFrameState
+		void setSnapshot(const FrameSnapshot& snapshot);
+
+		// Copies game state of frame into buffer, render side reads it as snapshot.getState<T>()
+		template <typename T>
+		void setFrameState(const T& state)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Frame state must be trivially copyable");
+			static_assert(alignof(T) <= alignof(std::max_align_t), "Frame state is over-aligned");
+			memcpy(allocateFrameState(sizeof(T)), &state, sizeof(T));
+		}
+
+		// Returns memory aligned as std::max_align_t for state of frame, replaces previous state
+		void* allocateFrameState(size_t size);
+
+		const FrameSnapshot& getSnapshot() const {
+			return m_snapshot;
+		}
+
+		void clear(GLbitfield mask);
+
+		void bindShader(Shader* shader);
+
+		void unbindShader();
+
+		void setUniform(Shader* shader, const char* name, int value);
+
+		void setUniform(Shader* shader, const char* name, float value);
+
+		void setUniform(Shader* shader, const char* name, const glm::vec4& value);
+
+		void setUniform(Shader* shader, const char* name, const glm::mat4& value);
+
+		void activateTexture(Shader* shader, GLenum target, int index, GLuint texture, const char* uniformName);
+
+		void bindVertexArray(VertexArray* vertexArray);
+
+		void unbindVertexArray();
+
+		void drawArrays(GLenum mode, GLint first, GLsizei count);
+
+		void drawElements(GLenum mode, GLsizei count, GLenum type, size_t indexOffset);
+
+		// Indices are offset by baseVertex, draws meshes sharing one vertex buffer (GeometryArena)
+		void drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, size_t indexOffset, GLint baseVertex);
+
+		// Instance attributes must be set up in bound vertex array (InstanceLayout)
+		void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+
+		void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, size_t indexOffset, GLsizei instanceCount, GLint baseVertex = 0);
+
+		// Draws and their data are copied into command, replayed by DrawBatcher::submit
+		void drawBatch(DrawBatcher* batcher, GLenum mode, const DrawElementsIndirectCommand* draws, uint32 drawCount, const void* drawData, size_t drawDataSize);
+
+		// Calls function on render thread, used for work not covered by commands (resource uploads, swap, e.t.c.)
+		void callback(Callback func, void* userData);
+
+		// Calls function with block of data stored in command buffer, so recording side can reuse its own memory
+		// right away. Returns 16 byte aligned memory of dataSize bytes to be filled by caller.
+		// @note Pointer is invalidated by next recorded command
+		void* callback(DataCallback func, void* userData, size_t dataSize);
+
+		// Replays all commands, must be called on thread owning OpenGL context
+		void execute() const;
+
+		// Bytes used by recorded commands
+		size_t getSize() const {
+			return m_size;
+		}
+
+		uint32 getCommandCount() const {
+			return m_commandCount;
+		}
+
+	private:
+		struct Header
+		{
+			RenderCommandType type;
+			uint32 size;
+		};
+
+		// Reserves aligned packet with payload of given size and returns pointer to payload
+		void* allocate(RenderCommandType type, size_t payloadSize);
+
+		template <typename T>
+		void push(RenderCommandType type, const T& payload)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Command payload must be trivially copyable");
+			void* memory = allocate(type, sizeof(T));
+			memcpy(memory, &payload, sizeof(T));
+		}
+
+		std::vector<unsigned char> m_data;
+
+		// Copy of game state of frame, element type gives alignment of any scalar type
+		std::vector<std::max_align_t> m_frameState;
+		size_t m_frameStateSize = 0;
+
+		size_t m_size = 0;
+
+		uint32 m_commandCount = 0;
+
+		FrameSnapshot m_snapshot;
+	};
+}
@@ -0,0 +1,115 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		uint64 field(uint32 value, uint32 maxValue, uint32 shift)
+		{
+			return static_cast<uint64>(std::min(value, maxValue)) << shift;
+		}
+
+		void countStateChanges(const std::vector<uint64>& keys, uint32& shaderChanges, uint32& materialChanges, uint32& textureChanges)
+		{
+			shaderChanges = 0;
+			materialChanges = 0;
+			textureChanges = 0;
+
+			for (size_t i = 1; i < keys.size(); i++) {
+				const uint64 previous = keys[i - 1];
+				const uint64 current = keys[i];
+				if (RenderKey::getState(previous) == RenderKey::getState(current)) {
+					continue;
+				}
+
+				// Shader change rebinds everything
+				if (RenderKey::getShader(previous) != RenderKey::getShader(current)) {
+					shaderChanges++;
+					continue;
+				}
+				if (RenderKey::getMaterial(previous) != RenderKey::getMaterial(current)) {
+					materialChanges++;
+				}
+				if (RenderKey::getTexture(previous) != RenderKey::getTexture(current)) {
+					textureChanges++;
+				}
+			}
+		}
+	}
+
+	namespace RenderKey
+	{
+		uint32 quantizeDepth(float viewDepth, float nearPlane, float farPlane)
+		{
+			if (farPlane <= nearPlane) {
+				return 0;
+			}
+
+			const float normalized = (viewDepth - nearPlane) / (farPlane - nearPlane);
+			const float clamped = std::min(std::max(normalized, 0.0f), 1.0f);
+			return static_cast<uint32>(clamped * MAX_DEPTH);
+		}
+
+		uint64 opaque(uint32 layer, uint32 shader, uint32 material, uint32 texture, uint32 depth)
+		{
+			return field(layer, MAX_LAYER, LAYER_SHIFT)
+				| field(shader, MAX_SHADER, DEPTH_BITS + MATERIAL_BITS + TEXTURE_BITS)
+				| field(material, MAX_MATERIAL, DEPTH_BITS + TEXTURE_BITS)
+				| field(texture, MAX_TEXTURE, DEPTH_BITS)
+				| field(depth, MAX_DEPTH, 0);
+		}
+
+		uint64 translucent(uint32 layer, uint32 shader, uint32 material, uint32 texture, uint32 depth)
+		{
+			// Inverted so that far draws come first
+			return field(layer, MAX_LAYER, LAYER_SHIFT)
+				| (static_cast<uint64>(1) << TRANSLUCENT_SHIFT)
+				| field(MAX_DEPTH - std::min(depth, MAX_DEPTH), MAX_DEPTH, STATE_BITS)
+				| field(shader, MAX_SHADER, MATERIAL_BITS + TEXTURE_BITS)
+				| field(material, MAX_MATERIAL, TEXTURE_BITS)
+				| field(texture, MAX_TEXTURE, 0);
+		}
+	}
+
+	RenderQueue::RenderQueue(JobSystem* jobSystem)
+		: m_sorter(jobSystem)
+	{
+	}
+
+	void RenderQueue::reset()
+	{
+		m_keys.clear();
+		m_payloads.clear();
+	}
+
+	void RenderQueue::reserve(uint32 count)
+	{
+		m_keys.reserve(count);
+		m_payloads.reserve(count);
+	}
+
+	void RenderQueue::sort()
+	{
+		EXA_PROFILE_FUNCTION();
+
+		m_stats = RenderQueueStats();
+		m_stats.items = getCount();
+
+		if (m_statsEnabled) {
+			countStateChanges(m_keys, m_stats.unsortedShaderChanges, m_stats.unsortedMaterialChanges, m_stats.unsortedTextureChanges);
+		}
+
+		m_sorter.sort(m_keys, m_payloads);
+
+		if (m_statsEnabled) {
+			countStateChanges(m_keys, m_stats.shaderChanges, m_stats.materialChanges, m_stats.textureChanges);
+		}
+	}
+}
@@ -0,0 +1,159 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "exa.h"
+#include "RadixSorter.h"
+
+namespace exa
+{
+	class JobSystem;
+
+	// 64 bit sort key of draw, most significant fields decide order first:
+	//
+	// opaque:      layer 4 | 0 | shader 11 | material 12 | texture 12 | depth 24
+	// translucent: layer 4 | 1 | ~depth 24 | shader 11 | material 12 | texture 12
+	//
+	// Opaque draws are grouped by state and go front-to-back within equal state for early depth test,
+	// translucent draws follow opaque ones of same layer and go back-to-front regardless of state.
+	namespace RenderKey
+	{
+		const uint32 LAYER_BITS = 4;
+		const uint32 SHADER_BITS = 11;
+		const uint32 MATERIAL_BITS = 12;
+		const uint32 TEXTURE_BITS = 12;
+		const uint32 DEPTH_BITS = 24;
+
+		const uint32 MAX_LAYER = (1u << LAYER_BITS) - 1;
+		const uint32 MAX_SHADER = (1u << SHADER_BITS) - 1;
+		const uint32 MAX_MATERIAL = (1u << MATERIAL_BITS) - 1;
+		const uint32 MAX_TEXTURE = (1u << TEXTURE_BITS) - 1;
+		const uint32 MAX_DEPTH = (1u << DEPTH_BITS) - 1;
+
+		const uint32 LAYER_SHIFT = 60;
+		const uint32 TRANSLUCENT_SHIFT = 59;
+
+		// Shader, material and texture of opaque key start at bit 24, of translucent key at bit 0
+		const uint32 STATE_BITS = SHADER_BITS + MATERIAL_BITS + TEXTURE_BITS;
+		const uint64 STATE_MASK = (static_cast<uint64>(1) << STATE_BITS) - 1;
+
+		// Distance from camera mapped linearly from [nearPlane; farPlane] to [0; MAX_DEPTH], clamped
+		uint32 quantizeDepth(float viewDepth, float nearPlane, float farPlane);
+
+		// Ids are cut to their field width, keep them dense (index of shader, material, texture in frame)
+		uint64 opaque(uint32 layer, uint32 shader, uint32 material, uint32 texture, uint32 depth);
+
+		uint64 translucent(uint32 layer, uint32 shader, uint32 material, uint32 texture, uint32 depth);
+
+		inline uint32 getLayer(uint64 key)
+		{
+			return static_cast<uint32>(key >> LAYER_SHIFT);
+		}
+
+		inline bool isTranslucent(uint64 key)
+		{
+			return ((key >> TRANSLUCENT_SHIFT) & 1) != 0;
+		}
+
+		// Shader, material and texture packed together, equal states need no state change
+		inline uint64 getState(uint64 key)
+		{
+			return (isTranslucent(key) ? key : key >> DEPTH_BITS) & STATE_MASK;
+		}
+
+		inline uint32 getShader(uint64 key)
+		{
+			return static_cast<uint32>(getState(key) >> (MATERIAL_BITS + TEXTURE_BITS));
+		}
+
+		inline uint32 getMaterial(uint64 key)
+		{
+			return static_cast<uint32>(getState(key) >> TEXTURE_BITS) & MAX_MATERIAL;
+		}
+
+		inline uint32 getTexture(uint64 key)
+		{
+			return static_cast<uint32>(getState(key)) & MAX_TEXTURE;
+		}
+
+		inline uint32 getDepth(uint64 key)
+		{
+			return isTranslucent(key)
+				? MAX_DEPTH - (static_cast<uint32>(key >> STATE_BITS) & MAX_DEPTH)
+				: static_cast<uint32>(key) & MAX_DEPTH;
+		}
+	}
+
+	// State changes between consecutive draws, in submission order and in sorted order
+	struct RenderQueueStats
+	{
+		uint32 items = 0;
+		uint32 unsortedShaderChanges = 0;
+		uint32 unsortedMaterialChanges = 0;
+		uint32 unsortedTextureChanges = 0;
+		uint32 shaderChanges = 0;
+		uint32 materialChanges = 0;
+		uint32 textureChanges = 0;
+	};
+
+	// Draws of frame as sort keys (RenderKey) with payload index, usually index of draw in caller's array.
+	// Sorted once per frame with radix sort, in parallel for large queues, then walked in order to record
+	// draws and change state only where key fields differ.
+	//
+	// queue.push(RenderKey::opaque(0, shaderIndex, materialIndex, textureIndex, depth), drawIndex);
+	// queue.sort();
+	// for (uint32 i = 0; i < queue.getCount(); i++) record(draws[queue.getPayloads()[i]]);
+	class RenderQueue
+	{
+	public:
+		// @param jobSystem Used for queues of RadixSorter::PARALLEL_THRESHOLD items and more, nullptr sorts on calling thread
+		explicit RenderQueue(JobSystem* jobSystem = nullptr);
+
+		// Drops items, keeps memory
+		void reset();
+
+		void reserve(uint32 count);
+
+		void push(uint64 key, uint32 payload)
+		{
+			m_keys.push_back(key);
+			m_payloads.push_back(payload);
+		}
+
+		void sort();
+
+		uint32 getCount() const {
+			return static_cast<uint32>(m_keys.size());
+		}
+
+		const std::vector<uint64>& getKeys() const {
+			return m_keys;
+		}
+
+		const std::vector<uint32>& getPayloads() const {
+			return m_payloads;
+		}
+
+		// Counting costs extra pass over keys before and after sort, off by default
+		void setStatsEnabled(bool enabled = true) {
+			m_statsEnabled = enabled;
+		}
+
+		// Of last sort
+		const RenderQueueStats& getStats() const {
+			return m_stats;
+		}
+
+	private:
+		std::vector<uint64> m_keys;
+		std::vector<uint32> m_payloads;
+
+		RadixSorter m_sorter;
+
+		bool m_statsEnabled = false;
+		RenderQueueStats m_stats;
+	};
+}
@@ -0,0 +1,190 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "RenderThread.h"
+
+#include "Window.h"
+#include "Log.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	RenderThread::RenderThread()
+	{
+	}
+
+	RenderThread::~RenderThread()
+	{
+		stop();
+	}
+
+	bool RenderThread::start(Window* window)
+	{
+		if (m_running) {
+			log::warning("Render thread already started");
+			return true;
+		}
+
+		m_window = window;
+
+		m_freeBuffers.clear();
+		m_submittedBuffers.clear();
+		for (size_t i = 0; i < NUM_BUFFERS; i++) {
+			m_buffers[i].reset();
+			m_freeBuffers.push_back(i);
+		}
+		m_recordingBuffer = NUM_BUFFERS;
+		m_replayingBuffer = NUM_BUFFERS;
+
+		// Context may be current only on one thread at a time
+		m_window->releaseContext();
+
+		m_running = true;
+		m_contextReady = false;
+		m_contextFailed = false;
+
+		m_thread = std::thread(&RenderThread::threadLoop, this);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [this] {
+			return m_contextReady || m_contextFailed;
+		});
+
+		if (m_contextFailed) {
+			lock.unlock();
+			m_thread.join();
+			m_running = false;
+			m_window->makeContextCurrent();
+			log::error("Render thread failed to acquire OpenGL context");
+			return false;
+		}
+
+		log::debug("Render thread started");
+
+		return true;
+	}
+
+	void RenderThread::stop()
+	{
+		if (!m_running) {
+			return;
+		}
+
+		flush();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_condition.notify_all();
+
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+
+		// Context is released by render thread before exit
+		m_window->makeContextCurrent();
+
+		log::debug("Render thread stopped");
+	}
+
+	RenderCommandBuffer& RenderThread::beginFrame()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (m_recordingBuffer != NUM_BUFFERS) {
+			log::error("Previous frame was not submitted");
+			return m_buffers[m_recordingBuffer];
+		}
+
+		// Backpressure: game thread can't run more than two frames ahead
+		m_condition.wait(lock, [this] {
+			return !m_freeBuffers.empty();
+		});
+
+		m_recordingBuffer = m_freeBuffers.front();
+		m_freeBuffers.pop_front();
+
+		RenderCommandBuffer& buffer = m_buffers[m_recordingBuffer];
+		buffer.reset();
+		return buffer;
+	}
+
+	void RenderThread::submitFrame(const FrameSnapshot& snapshot)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_recordingBuffer == NUM_BUFFERS) {
+				log::error("Nothing to submit, beginFrame was not called");
+				return;
+			}
+
+			m_buffers[m_recordingBuffer].setSnapshot(snapshot);
+			m_submittedBuffers.push_back(m_recordingBuffer);
+			m_recordingBuffer = NUM_BUFFERS;
+		}
+		m_condition.notify_all();
+	}
+
+	void RenderThread::flush()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [this] {
+			return m_submittedBuffers.empty() && m_replayingBuffer == NUM_BUFFERS;
+		});
+	}
+
+	void RenderThread::threadLoop()
+	{
+		EXA_PROFILE_THREAD("Render");
+
+		bool contextReady = m_window->makeContextCurrent();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_contextReady = contextReady;
+			m_contextFailed = !contextReady;
+		}
+		m_condition.notify_all();
+
+		if (!contextReady) {
+			return;
+		}
+
+		for (;;) {
+			size_t bufferIndex = NUM_BUFFERS;
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this] {
+					return !m_submittedBuffers.empty() || !m_running;
+				});
+
+				if (m_submittedBuffers.empty()) {
+					// Stopped and nothing left to replay
+					break;
+				}
+
+				bufferIndex = m_submittedBuffers.front();
+				m_submittedBuffers.pop_front();
+				m_replayingBuffer = bufferIndex;
+			}
+
+			// Recorded buffer is immutable now, no lock needed
+			m_buffers[bufferIndex].execute();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_replayingBuffer = NUM_BUFFERS;
+				m_freeBuffers.push_back(bufferIndex);
+			}
+			m_condition.notify_all();
+		}
+
+		// Queries belong to context, delete them while it is still current
+		PROFILER().releaseGpuResources();
+
+		m_window->releaseContext();
+	}
+}
@@ -0,0 +1,79 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "exa.h"
+#include "RenderCommandBuffer.h"
+
+namespace exa
+{
+	class Window;
+
+	// Thread owning OpenGL context that replays command buffers recorded by game thread.
+	// Frames are triple buffered: one is recorded, one is queued and one is replayed,
+	// so frame N+1 is simulated while frame N is submitted.
+	class RenderThread
+	{
+	public:
+		static const size_t NUM_BUFFERS = 3;
+
+		RenderThread();
+		~RenderThread();
+
+		// Moves OpenGL context of window to render thread
+		// @note Must be called from thread currently owning context
+		bool start(Window* window);
+
+		// Replays all queued frames, joins thread and makes context current on calling thread again
+		void stop();
+
+		// Waits for free buffer and returns it for recording
+		RenderCommandBuffer& beginFrame();
+
+		// Queues recorded buffer together with snapshot of game state
+		void submitFrame(const FrameSnapshot& snapshot);
+
+		// Blocks until all submitted frames are replayed
+		void flush();
+
+		bool isRunning() const {
+			return m_running;
+		}
+
+	private:
+		void threadLoop();
+
+		Window* m_window = nullptr;
+
+		std::thread m_thread;
+
+		std::array<RenderCommandBuffer, NUM_BUFFERS> m_buffers;
+
+		// Buffers not used by any side
+		std::deque<size_t> m_freeBuffers;
+
+		// Buffers waiting to be replayed
+		std::deque<size_t> m_submittedBuffers;
+
+		// Buffer being recorded by game thread
+		size_t m_recordingBuffer = NUM_BUFFERS;
+
+		// Buffer being replayed by render thread
+		size_t m_replayingBuffer = NUM_BUFFERS;
+
+		bool m_running = false;
+
+		bool m_contextReady = false;
+		bool m_contextFailed = false;
+
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+	};
+}
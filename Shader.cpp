@@ -3,32 +3,200 @@
 
 #include "Shader.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
 
 #include "File.h"
 #include "Exagine.h"
 #include "Log.h"
+#include "Profiler.h"
+#include "Hash.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderPreprocessor.h"
 
 namespace exa
 {
-	void Shader::bindUniform(unsigned int location, glm::vec4 & value)
+	// OpenGL stage type of every ShaderType
+	static const GLenum SHADER_STAGE_TYPES[] = {
+		GL_VERTEX_SHADER,
+		GL_FRAGMENT_SHADER,
+		GL_GEOMETRY_SHADER,
+		GL_COMPUTE_SHADER,
+		GL_TESS_CONTROL_SHADER,
+		GL_TESS_EVALUATION_SHADER
+	};
+
+	static_assert(sizeof(SHADER_STAGE_TYPES) / sizeof(GLenum) == static_cast<size_t>(ShaderType::EXA_TOTAL_ITEMS), "Stage type for every ShaderType");
+
+	void Shader::buildReflection()
 	{
-		exaglUniform4f(location, value.x, value.y, value.z, value.w);
+		m_uniforms.clear();
+		m_uniformNames.clear();
+		m_uniformLookup.clear();
+		m_uniformValues.clear();
+		m_uniformValuesKnown.clear();
+
+		for (const auto& blockBinding : m_uniformBlockBindings) {
+			const GLuint blockIndex = exaglGetUniformBlockIndex(m_shaderProgram, blockBinding.first.c_str());
+			if (blockIndex != GL_INVALID_INDEX) {
+				exaglUniformBlockBinding(m_shaderProgram, blockIndex, blockBinding.second);
+			}
+		}
+
+		m_reflection.build(m_shaderProgram);
+
+		m_uniforms.reserve(m_reflection.getUniforms().size());
+
+		for (const auto& uniform : m_reflection.getUniforms()) {
+			// Members of uniform blocks have no location
+			if (uniform.location == -1) {
+				continue;
+			}
+
+			const int32 index = addUniform(uniform);
+			addUniformName(uniform.name.c_str(), index, 0);
+
+			// Arrays are reported as "name[0]" by driver, keep that name working too with same shadow value
+			if (uniform.arraySize > 1) {
+				addUniformName((uniform.name + "[0]").c_str(), index, 0);
+			}
+		}
+
+		log::debug("Shader program %u has %u attributes, %u uniforms, %u uniform blocks, %u samplers", m_shaderProgram,
+			static_cast<unsigned int>(m_reflection.getAttributes().size()),
+			static_cast<unsigned int>(m_reflection.getUniforms().size()),
+			static_cast<unsigned int>(m_reflection.getUniformBlocks().size()),
+			static_cast<unsigned int>(m_reflection.getSamplers().size()));
+	}
+
+	int32 Shader::addUniform(const ShaderUniform& reflected)
+	{
+		Uniform uniform;
+		uniform.name = reflected.name;
+		uniform.location = reflected.location;
+		uniform.type = reflected.type;
+		uniform.arraySize = std::max(reflected.arraySize, 1);
+
+		// Element locations are not guaranteed to be consecutive, so they are queried here rather than on bind
+		if (uniform.arraySize > 1) {
+			uniform.elementLocations.resize(uniform.arraySize);
+			uniform.elementLocations[0] = uniform.location;
+			for (GLint i = 1; i < uniform.arraySize; i++) {
+				const std::string elementName = uniform.name + "[" + std::to_string(i) + "]";
+				uniform.elementLocations[i] = exaglGetUniformLocation(m_shaderProgram, elementName.c_str());
+			}
+		}
+
+		uniform.knownOffset = m_uniformValuesKnown.size();
+		m_uniformValuesKnown.resize(m_uniformValuesKnown.size() + uniform.arraySize, 0);
+
+		m_uniforms.push_back(std::move(uniform));
+		return static_cast<int32>(m_uniforms.size() - 1);
+	}
+
+	Shader::UniformName* Shader::addUniformName(const char* name, int32 uniform, GLint element)
+	{
+		const uint32 hash = hashFnv1a32(name);
+		if (m_uniformLookup.find(hash) != m_uniformLookup.end()) {
+			// Still found by findUniformName with linear search
+			log::warning("Uniform name hash collision: %s", name);
+		}
+		else {
+			m_uniformLookup[hash] = static_cast<uint32>(m_uniformNames.size());
+		}
+
+		UniformName uniformName;
+		uniformName.name = name;
+		uniformName.uniform = uniform;
+		uniformName.element = element;
+		if (uniform >= 0) {
+			const Uniform& target = m_uniforms[uniform];
+			uniformName.location = target.elementLocations.empty() ? target.location : target.elementLocations[element];
+		}
+		m_uniformNames.push_back(std::move(uniformName));
+
+		return &m_uniformNames.back();
 	}
 
-	void Shader::bindUniform(unsigned int location, glm::mat4 const & matrix)
+	Shader::UniformName* Shader::findUniformName(const char* name)
 	{
-		exaglUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+		auto it = m_uniformLookup.find(hashFnv1a32(name));
+		if (it != m_uniformLookup.end() && m_uniformNames[it->second].name == name) {
+			return &m_uniformNames[it->second];
+		}
+
+		for (auto& uniformName : m_uniformNames) {
+			if (uniformName.name == name) {
+				return &uniformName;
+			}
+		}
+		return nullptr;
 	}
 
-	void Shader::bindUniform(unsigned int location, float value)
+	const Shader::UniformName* Shader::findUniform(const char* name)
 	{
-		exaglUniform1f(location, value);
+		UniformName* uniformName = findUniformName(name);
+		if (uniformName != nullptr) {
+			return uniformName->uniform >= 0 ? uniformName : nullptr;
+		}
+
+		// Element of array ("lights[2]") shares shadow value of array
+		int32 uniform = -1;
+		GLint element = 0;
+		const char* bracket = std::strrchr(name, '[');
+		if (bracket != nullptr) {
+			char* end = nullptr;
+			const long index = std::strtol(bracket + 1, &end, 10);
+			const std::string arrayName(name, bracket);
+			const UniformName* array = findUniformName(arrayName.c_str());
+			if (end != bracket + 1 && end[0] == ']' && end[1] == '\0' && array != nullptr && array->uniform >= 0 &&
+				index >= 0 && index < m_uniforms[array->uniform].arraySize) {
+				uniform = array->uniform;
+				element = static_cast<GLint>(index);
+			}
+		}
+
+		// Compiler removes unused uniforms (often depending on permutation defines), binding them is not an error.
+		// Misses are remembered too, so unknown names are resolved and reported only once
+		if (uniform < 0) {
+			log::warning("Uniform %s is not used by shader program %u", name, m_shaderProgram);
+		}
+		uniformName = addUniformName(name, uniform, element);
+		return uniformName->uniform >= 0 ? uniformName : nullptr;
 	}
 
-	void Shader::bindUniform(unsigned int location, int value)
+	bool Shader::updateShadowValue(const UniformName& name, const void* values, size_t elementSize, GLsizei count)
 	{
-		exaglUniform1i(location, value);
+		Uniform& uniform = m_uniforms[name.uniform];
+
+		// Driver ignores elements past end of array
+		const GLint elements = std::min(static_cast<GLint>(count), uniform.arraySize - name.element);
+		if (elements <= 0) {
+			return true;
+		}
+
+		// Storage for whole array is reserved on first upload, again if uniform is uploaded as other type later
+		if (uniform.elementSize != elementSize) {
+			uniform.elementSize = elementSize;
+			uniform.valueOffset = m_uniformValues.size();
+			m_uniformValues.resize(m_uniformValues.size() + elementSize * uniform.arraySize);
+			std::fill_n(m_uniformValuesKnown.begin() + uniform.knownOffset, uniform.arraySize, 0);
+		}
+
+		unsigned char* shadow = &m_uniformValues[uniform.valueOffset + elementSize * name.element];
+		const size_t size = elementSize * elements;
+		auto known = m_uniformValuesKnown.begin() + uniform.knownOffset + name.element;
+
+		if (std::find(known, known + elements, 0) == known + elements && memcmp(shadow, values, size) == 0) {
+			return false;
+		}
+
+		memcpy(shadow, values, size);
+		std::fill_n(known, elements, 1);
+
+		return true;
 	}
 
 	void  Shader::activateTexture(GLenum target = GL_TEXTURE_2D, int index = 0,
@@ -37,9 +205,35 @@ namespace exa
 		if (index < 0 || index > GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS) {
 			log::error("%s %d %s", "activateTexture", target, ": i < 0 || i > GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS");
 		}
+#if defined(EXA_DEBUG)
+		const ShaderSampler* sampler = m_reflection.findSampler(uniformName);
+		if (sampler != nullptr && sampler->target != target) {
+			log::warning("Sampler %s expects texture target 0x%x, got 0x%x", uniformName, sampler->target, target);
+		}
+#endif
 		exaglActiveTexture(GL_TEXTURE0 + index);
-		exaglBindTexture(GL_TEXTURE_2D, textureGl);
-		exaglUniform1i(getUniformLocation(uniformName), index);
+		exaglBindTexture(target, textureGl);
+		bindUniform(uniformName, index);
+	}
+
+	void Shader::bindUniformBlock(const char* blockName, GLuint binding)
+	{
+		auto found = std::find_if(m_uniformBlockBindings.begin(), m_uniformBlockBindings.end(),
+			[blockName](const std::pair<std::string, GLuint>& blockBinding) { return blockBinding.first == blockName; });
+		if (found != m_uniformBlockBindings.end()) {
+			found->second = binding;
+		}
+		else {
+			m_uniformBlockBindings.emplace_back(blockName, binding);
+		}
+
+		if (m_reflection.findUniformBlock(blockName) == nullptr) {
+			log::debug("Uniform block %s is not used by program %u", blockName, m_shaderProgram);
+			return;
+		}
+
+		// Reflection is rebuilt to report new binding
+		buildReflection();
 	}
 
 	void  Shader::activateTexture2D(int index, GLuint textureGl, const char* uniformName)
@@ -73,10 +267,9 @@ namespace exa
 			/* Array of string lengths */ nullptr
 		);
 
+		// Status is queried by finishLink, querying here would wait for driver compiler threads
 		exaglCompileShader(shader);
 
-		VALIDATE_SHADER_IV(shader, GL_COMPILE_STATUS);
-
 		return shader;
 	}
 
@@ -87,12 +280,13 @@ namespace exa
 			EXAGINE().stop();
 		}
 
-		GLint attribLocation = exaglGetAttribLocation(m_shaderProgram, atrName);
-		if (attribLocation == -1) {
-			log::error("%s %d %s %s", "Could not get attribute location ", attribLocation, " of ", atrName);
-			EXAGINE().stop();
+		// Compiler removes unused attributes, vertex data for them is simply not bound
+		const ShaderAttribute* attribute = m_reflection.findAttribute(atrName);
+		if (attribute == nullptr) {
+			log::warning("Attribute %s is not used by shader program %u", atrName, m_shaderProgram);
+			return -1;
 		}
-		return attribLocation;
+		return attribute->location;
 	}
 
 	GLint Shader::getUniformLocation(const char* atrName)
@@ -102,12 +296,8 @@ namespace exa
 			EXAGINE().stop();
 		}
 
-		GLint uniformLocation = exaglGetUniformLocation(m_shaderProgram, atrName);
-		if (uniformLocation == -1) {
-			log::error("%s %d %s %s", "Could not get uniform location ", uniformLocation, " of ", atrName);
-			EXAGINE().stop();
-		}
-		return uniformLocation;
+		const UniformName* uniform = findUniform(atrName);
+		return uniform != nullptr ? uniform->location : -1;
 	}
 
 	/**
@@ -123,6 +313,8 @@ namespace exa
 	**/
 	Shader & Shader::addShader(const char * filename)
 	{
+		EXA_PROFILE_FUNCTION();
+
 		// Get file extention
 		std::string filenameStr(filename);
 		auto index = filenameStr.rfind(".");
@@ -133,40 +325,48 @@ namespace exa
 		std::string filefullpath = path + filenameStr;
 
 		log::debug("adding shader %s", filefullpath.c_str());
-		
-		if (!File::exists(filefullpath.c_str())) {
-			log::error("File %s doesn't exist %s:%d", filefullpath.c_str(), __FILE__, __LINE__);
-		}
 
-		// Read file										 
-		File shaderfile(filefullpath.c_str());
-
-		// Create a Shader Object
-		// @note According to the C++ standard a reinterpret_cast between unsigned char* and char* is 
-		//		 safe as they are the same size and have the same construction and constraints
-		const char * source = reinterpret_cast<const char *>(shaderfile.getBuffer());
+		GLenum type = GL_NONE;
 
 		if (ext == "comp") {
-			addShader(GL_COMPUTE_SHADER, source);
+			type = GL_COMPUTE_SHADER;
 		}
 		else if (ext == "frag") {
-			addShader(GL_FRAGMENT_SHADER, source);
+			type = GL_FRAGMENT_SHADER;
 		}
 		else if (ext == "geom") {
-			addShader(GL_GEOMETRY_SHADER, source);
+			type = GL_GEOMETRY_SHADER;
 		}
 		else if (ext == "vert") {
-			addShader(GL_VERTEX_SHADER, source);
+			type = GL_VERTEX_SHADER;
 		}
 		else if (ext == "tesc") {
-			addShader(GL_TESS_CONTROL_SHADER, source);
+			type = GL_TESS_CONTROL_SHADER;
 		}
 		else if (ext == "tese") {
-			addShader(GL_TESS_EVALUATION_SHADER, source);
+			type = GL_TESS_EVALUATION_SHADER;
 		}
 		else {
 			log::error("Unknown shader type");
 			EXAGINE().stop();
+			return *this;
+		}
+
+		for (size_t i = 0; i < m_sourceFiles.size(); i++) {
+			if (SHADER_STAGE_TYPES[i] != type) {
+				continue;
+			}
+
+			m_sourceFiles[i] = filefullpath;
+
+			std::string source;
+			if (!preprocessStage(i, source)) {
+				log::error("Unable to preprocess shader %s", filefullpath.c_str());
+				EXAGINE().stop();
+				return *this;
+			}
+
+			addShader(type, source.c_str());
 		}
 
 		log::debug("added shader %s", filefullpath.c_str());
@@ -174,31 +374,32 @@ namespace exa
 		return *this;
 	}
 
+	// Source is compiled by link(), only if program is not found in binary cache
 	Shader & Shader::addShader(GLenum type, const char *shaderSrc)
 	{
 		if (type == GL_VERTEX_SHADER) {
 			size_t index = static_cast<size_t>(ShaderType::EXA_VERTEX_SHADER);
-			m_shaders[index] = loadShaderFromMemory(type, shaderSrc);
+			m_sources[index] = shaderSrc;
 		}
 		else if (type == GL_FRAGMENT_SHADER) {
 			size_t index = static_cast<size_t>(ShaderType::EXA_FRAGMENT_SHADER);
-			m_shaders[index] = loadShaderFromMemory(type, shaderSrc);
+			m_sources[index] = shaderSrc;
 		}
 		else if (type == GL_GEOMETRY_SHADER) {
 			size_t index = static_cast<size_t>(ShaderType::EXA_GEOMETRY_SHADER);
-			m_shaders[index] = loadShaderFromMemory(type, shaderSrc);
+			m_sources[index] = shaderSrc;
 		}
 		else if (type == GL_COMPUTE_SHADER) {
 			size_t index = static_cast<size_t>(ShaderType::EXA_COMPUTE_SHADER);
-			m_shaders[index] = loadShaderFromMemory(type, shaderSrc);
+			m_sources[index] = shaderSrc;
 		}
 		else if (type == GL_TESS_CONTROL_SHADER) {
 			size_t index = static_cast<size_t>(ShaderType::EXA_TESS_CONTROL_SHADER);
-			m_shaders[index] = loadShaderFromMemory(type, shaderSrc);
+			m_sources[index] = shaderSrc;
 		}
 		else if (type == GL_TESS_EVALUATION_SHADER) {
 			size_t index = static_cast<size_t>(ShaderType::EXA_TESS_EVALUATION_SHADER);
-			m_shaders[index] = loadShaderFromMemory(type, shaderSrc);
+			m_sources[index] = shaderSrc;
 		}
 		else {
 			log::error("Unsupported shader type");
@@ -207,6 +408,38 @@ namespace exa
 		return *this;
 	}
 
+	Shader & Shader::addDefine(const char * name, const char * value)
+	{
+		std::string define(name);
+		if (value != nullptr) {
+			define += ' ';
+			define += value;
+		}
+		m_defines.push_back(std::move(define));
+		return *this;
+	}
+
+	bool Shader::preprocessStage(size_t stage, std::string& source)
+	{
+		ShaderPreprocessor preprocessor;
+		preprocessor.setDefines(m_defines);
+
+		if (!preprocessor.process(m_sourceFiles[stage], source)) {
+			return false;
+		}
+
+		m_includedFiles[stage] = preprocessor.getFiles();
+		return true;
+	}
+
+	void Shader::logIncludedFiles(size_t stage) const
+	{
+		const auto& files = m_includedFiles[stage];
+		for (size_t i = 0; i < files.size(); i++) {
+			log::error("  source %u: %s", static_cast<unsigned int>(i), files[i].c_str());
+		}
+	}
+
 	Shader::Shader()
 	{
 		m_shaderProgram = 0;
@@ -224,38 +457,113 @@ namespace exa
 	}
 
 	Shader & Shader::link()
+	{
+		EXA_PROFILE_FUNCTION();
+
+		beginLink();
+		finishLink();
+
+		return *this;
+	}
+
+	void Shader::beginLink()
 	{
 		log::debug("linking shaders");
 
 		size_t index = static_cast<size_t>(ShaderType::EXA_VERTEX_SHADER);
-		if (m_shaders[index] == 0) {
+		size_t computeIndex = static_cast<size_t>(ShaderType::EXA_COMPUTE_SHADER);
+		if (m_sources[index].empty() && m_sources[computeIndex].empty()) {
 			log::error("At least vertex shader must be set!");
 		}
 
+		ProgramBinaryCache& cache = PROGRAMCACHE();
+		const bool useCache = cache.isAvailable();
+
+		m_linkedFromCache = false;
+		m_cacheKey = 0;
+		if (useCache) {
+			m_cacheKey = cache.computeKey(SHADER_STAGE_TYPES, m_sources.data(), m_sources.size());
+
+			// Warm start: no GLSL compilation at all
+			if (cache.load(m_cacheKey, m_shaderProgram)) {
+				log::debug("loaded program %u from binary cache", m_shaderProgram);
+				m_linkedFromCache = true;
+				return;
+			}
+		}
+
+		for (unsigned int i = 0; i < m_sources.size(); i++) {
+			if (!m_sources[i].empty()) {
+				m_shaders[i] = loadShaderFromMemory(SHADER_STAGE_TYPES[i], m_sources[i].c_str());
+			}
+		}
+
 		for (unsigned int i = 0; i < m_shaders.size(); i++) {
-			exaglAttachShader(m_shaderProgram, m_shaders[i]);
+			if (m_shaders[i] > 0) {
+				exaglAttachShader(m_shaderProgram, m_shaders[i]);
+			}
+		}
+
+		if (useCache) {
+			exaglProgramParameteri(m_shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		}
 
 		exaglLinkProgram(m_shaderProgram);
-		VALIDATE_PROGRAM_IV(GL_LINK_STATUS);
+	}
+
+	bool Shader::finishLink()
+	{
+		EXA_PROFILE_FUNCTION();
+
+		if (m_linkedFromCache) {
+			buildReflection();
+			return true;
+		}
+
+		for (unsigned int i = 0; i < m_shaders.size(); i++) {
+			if (m_shaders[i] > 0 && !VALIDATE_SHADER_IV(m_shaders[i], GL_COMPILE_STATUS)) {
+				// Deleted by validateShaderiv
+				m_shaders[i] = 0;
+				logIncludedFiles(i);
+				return false;
+			}
+		}
 
-		exaglValidateProgram(m_shaderProgram);
-		VALIDATE_PROGRAM_IV(GL_VALIDATE_STATUS);
+		if (!VALIDATE_PROGRAM_IV(GL_LINK_STATUS)) {
+			return false;
+		}
 
-		// Delete the shader objects once weve linked them into the program object cause
+		buildReflection();
+
+#if EXA_GL_DEBUG
+		if (GLDebug::isEnabled()) {
+			exaglValidateProgram(m_shaderProgram);
+			VALIDATE_PROGRAM_IV(GL_VALIDATE_STATUS);
+		}
+#endif
+
+		// Delete the shader objects once weve linked them into the program object cause
 		// we no longer need them anymore
 		for (unsigned int i = 0; i < m_shaders.size(); i++) {
 			if (m_shaders[i] > 0) {
 				//Always detach shaders after a successful link.
 				exaglDetachShader(m_shaderProgram, m_shaders[i]);
 				exaglDeleteShader(m_shaders[i]);
+				m_shaders[i] = 0;
 			}
 		}
-		return *this;
+
+		if (m_cacheKey != 0) {
+			PROGRAMCACHE().store(m_cacheKey, m_shaderProgram);
+		}
+
+		return true;
 	}
 
 	Shader::~Shader()
 	{
+		discardReload();
+
 		if (m_shaderProgram == 0) {
 			log::error("shaderProgram == 0");
 			EXAGINE().stop();
@@ -361,6 +669,195 @@ namespace exa
 		return validateProgramiv(m_shaderProgram, flag, file, line);
 	}
 
+	bool Shader::usesSourceFile(const std::string& path) const
+	{
+		for (const auto& files : m_includedFiles) {
+			if (std::find(files.begin(), files.end(), path) != files.end()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::vector<std::string> Shader::getSourceDependencies() const
+	{
+		std::vector<std::string> dependencies;
+		for (const auto& files : m_includedFiles) {
+			for (const auto& file : files) {
+				if (std::find(dependencies.begin(), dependencies.end(), file) == dependencies.end()) {
+					dependencies.push_back(file);
+				}
+			}
+		}
+		return dependencies;
+	}
+
+	std::string Shader::getInfoLog(GLuint object, bool isProgram)
+	{
+		GLint logLength = 0;
+		if (isProgram) {
+			exaglGetProgramiv(object, GL_INFO_LOG_LENGTH, &logLength);
+		}
+		else {
+			exaglGetShaderiv(object, GL_INFO_LOG_LENGTH, &logLength);
+		}
+
+		if (logLength <= 1) {
+			return std::string();
+		}
+
+		std::vector<char> infoLog(static_cast<size_t>(logLength));
+		if (isProgram) {
+			exaglGetProgramInfoLog(object, logLength, nullptr, infoLog.data());
+		}
+		else {
+			exaglGetShaderInfoLog(object, logLength, nullptr, infoLog.data());
+		}
+		return std::string(infoLog.data());
+	}
+
+	bool Shader::reload()
+	{
+		EXA_PROFILE_FUNCTION();
+
+		// Restart with latest sources if files changed again during compilation
+		discardReload();
+
+		m_pendingSources = m_sources;
+
+		bool changed = false;
+		for (size_t i = 0; i < m_sourceFiles.size(); i++) {
+			if (m_sourceFiles[i].empty()) {
+				continue;
+			}
+
+			if (!preprocessStage(i, m_pendingSources[i])) {
+				log::error("Unable to reload shader %s", m_sourceFiles[i].c_str());
+				return false;
+			}
+
+			changed = changed || m_pendingSources[i] != m_sources[i];
+		}
+
+		// Editors often touch files without changing them
+		if (!changed) {
+			return false;
+		}
+
+		m_pendingProgram = exaglCreateProgram();
+		if (m_pendingProgram == 0) {
+			log::error("Could not create shader program");
+			return false;
+		}
+
+		// Vertex arrays were set up with attribute locations of current program, keep them
+		for (const auto& attribute : m_reflection.getAttributes()) {
+			exaglBindAttribLocation(m_pendingProgram, static_cast<GLuint>(attribute.location), attribute.name.c_str());
+		}
+
+		// No status queries here, they would wait for compiler threads
+		for (size_t i = 0; i < m_pendingSources.size(); i++) {
+			if (m_pendingSources[i].empty()) {
+				continue;
+			}
+
+			m_pendingShaders[i] = loadShaderFromMemory(SHADER_STAGE_TYPES[i], m_pendingSources[i].c_str());
+			exaglAttachShader(m_pendingProgram, m_pendingShaders[i]);
+		}
+
+		if (PROGRAMCACHE().isAvailable()) {
+			exaglProgramParameteri(m_pendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		exaglLinkProgram(m_pendingProgram);
+
+		log::message("Reloading shader program %u", m_shaderProgram);
+
+		return true;
+	}
+
+	bool Shader::updateReload()
+	{
+		if (!isReloading()) {
+			return false;
+		}
+
+		if (GLAD_GL_ARB_parallel_shader_compile) {
+			GLint completed = GL_FALSE;
+			exaglGetProgramiv(m_pendingProgram, GL_COMPLETION_STATUS_ARB, &completed);
+			if (completed == GL_FALSE) {
+				return true;
+			}
+		}
+
+		GLint linked = GL_FALSE;
+		exaglGetProgramiv(m_pendingProgram, GL_LINK_STATUS, &linked);
+
+		if (linked == GL_FALSE) {
+			for (size_t i = 0; i < m_pendingShaders.size(); i++) {
+				if (m_pendingShaders[i] == 0) {
+					continue;
+				}
+
+				GLint compiled = GL_FALSE;
+				exaglGetShaderiv(m_pendingShaders[i], GL_COMPILE_STATUS, &compiled);
+				if (compiled == GL_FALSE) {
+					log::error("Error compiling shader %s\n%s", m_sourceFiles[i].c_str(), getInfoLog(m_pendingShaders[i], false).c_str());
+					logIncludedFiles(i);
+				}
+			}
+
+			log::error("Shader reload failed, keeping previous program %u\n%s", m_shaderProgram, getInfoLog(m_pendingProgram, true).c_str());
+
+			discardReload();
+			return false;
+		}
+
+		for (size_t i = 0; i < m_pendingShaders.size(); i++) {
+			if (m_pendingShaders[i] > 0) {
+				exaglDetachShader(m_pendingProgram, m_pendingShaders[i]);
+				exaglDeleteShader(m_pendingShaders[i]);
+				m_pendingShaders[i] = 0;
+			}
+		}
+
+		exaglDeleteProgram(m_shaderProgram);
+
+		m_shaderProgram = m_pendingProgram;
+		m_pendingProgram = 0;
+		m_sources = m_pendingSources;
+
+		// Locations may change, uniforms are uploaded again on next bindUniform
+		buildReflection();
+
+		ProgramBinaryCache& cache = PROGRAMCACHE();
+		if (cache.isAvailable()) {
+			cache.store(cache.computeKey(SHADER_STAGE_TYPES, m_sources.data(), m_sources.size()), m_shaderProgram);
+		}
+
+		log::message("Reloaded shader program %u", m_shaderProgram);
+
+		return false;
+	}
+
+	void Shader::discardReload()
+	{
+		for (size_t i = 0; i < m_pendingShaders.size(); i++) {
+			if (m_pendingShaders[i] > 0) {
+				if (m_pendingProgram > 0) {
+					exaglDetachShader(m_pendingProgram, m_pendingShaders[i]);
+				}
+				exaglDeleteShader(m_pendingShaders[i]);
+				m_pendingShaders[i] = 0;
+			}
+		}
+
+		if (m_pendingProgram > 0) {
+			exaglDeleteProgram(m_pendingProgram);
+			m_pendingProgram = 0;
+		}
+	}
+
 	// Calls glUseProgram with current program
 	void Shader::bind()
 	{
@@ -369,11 +866,16 @@ namespace exa
 			EXAGINE().stop();
 		}
 
+#if EXA_GL_DEBUG
 		// ValidateProgram should be called just before glDrawArrays or glDrawElements. 
 		// Test whether the current 'context' is valid for drawing actions 
-		exaglValidateProgram(m_shaderProgram);
+		// @note Synchronous driver round trip, done only by debug layer
+		if (GLDebug::isEnabled()) {
+			exaglValidateProgram(m_shaderProgram);
 
-		VALIDATE_PROGRAM_IV(GL_VALIDATE_STATUS);
+			VALIDATE_PROGRAM_IV(GL_VALIDATE_STATUS);
+		}
+#endif
 
 		exaglUseProgram(m_shaderProgram);
 	}
@@ -4,8 +4,12 @@
 #pragma once
 
 #include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "RenderPlatforms.h"
+#include "ShaderReflection.h"
 #include "Util.h"
 #include "Log.h"
 									   
@@ -14,6 +18,65 @@
 
 namespace exa
 {
+	// Maps C++ type to glUniform* call used by Shader::bindUniform
+	template <typename T>
+	struct uniform_traits
+	{
+		static_assert(std::is_same<T, void>::value, "Unsupported uniform type!");
+	};
+
+#define EXA_UNIFORM_VECTOR(T, call) \
+	template <> struct uniform_traits<T> \
+	{ \
+		static void upload(GLint location, GLsizei count, const T* values) { \
+			call(location, count, glm::value_ptr(*values)); \
+		} \
+	};
+
+#define EXA_UNIFORM_SCALAR(T, call) \
+	template <> struct uniform_traits<T> \
+	{ \
+		static void upload(GLint location, GLsizei count, const T* values) { \
+			call(location, count, values); \
+		} \
+	};
+
+#define EXA_UNIFORM_MATRIX(T, call) \
+	template <> struct uniform_traits<T> \
+	{ \
+		static void upload(GLint location, GLsizei count, const T* values) { \
+			call(location, count, GL_FALSE, glm::value_ptr(*values)); \
+		} \
+	};
+
+	EXA_UNIFORM_SCALAR(float, exaglUniform1fv)
+	EXA_UNIFORM_SCALAR(int, exaglUniform1iv)
+	EXA_UNIFORM_SCALAR(unsigned int, exaglUniform1uiv)
+
+	EXA_UNIFORM_VECTOR(glm::vec2, exaglUniform2fv)
+	EXA_UNIFORM_VECTOR(glm::vec3, exaglUniform3fv)
+	EXA_UNIFORM_VECTOR(glm::vec4, exaglUniform4fv)
+	EXA_UNIFORM_VECTOR(glm::ivec2, exaglUniform2iv)
+	EXA_UNIFORM_VECTOR(glm::ivec3, exaglUniform3iv)
+	EXA_UNIFORM_VECTOR(glm::ivec4, exaglUniform4iv)
+	EXA_UNIFORM_VECTOR(glm::uvec2, exaglUniform2uiv)
+	EXA_UNIFORM_VECTOR(glm::uvec3, exaglUniform3uiv)
+	EXA_UNIFORM_VECTOR(glm::uvec4, exaglUniform4uiv)
+
+	EXA_UNIFORM_MATRIX(glm::mat2, exaglUniformMatrix2fv)
+	EXA_UNIFORM_MATRIX(glm::mat3, exaglUniformMatrix3fv)
+	EXA_UNIFORM_MATRIX(glm::mat4, exaglUniformMatrix4fv)
+	EXA_UNIFORM_MATRIX(glm::mat2x3, exaglUniformMatrix2x3fv)
+	EXA_UNIFORM_MATRIX(glm::mat3x2, exaglUniformMatrix3x2fv)
+	EXA_UNIFORM_MATRIX(glm::mat2x4, exaglUniformMatrix2x4fv)
+	EXA_UNIFORM_MATRIX(glm::mat4x2, exaglUniformMatrix4x2fv)
+	EXA_UNIFORM_MATRIX(glm::mat3x4, exaglUniformMatrix3x4fv)
+	EXA_UNIFORM_MATRIX(glm::mat4x3, exaglUniformMatrix4x3fv)
+
+#undef EXA_UNIFORM_VECTOR
+#undef EXA_UNIFORM_SCALAR
+#undef EXA_UNIFORM_MATRIX
+
 	// Internal shader types 
 	enum class ShaderType : std::int8_t
 	{
@@ -34,40 +97,133 @@ namespace exa
 		// Shaders: Vertex, fragment, geometry, e.t.c.
 		std::array<GLuint, static_cast<size_t>(ShaderType::EXA_TOTAL_ITEMS)> m_shaders{ 0 };
 
+		// GLSL sources of stages, compiled on link if program binary is not cached
+		std::array<std::string, static_cast<size_t>(ShaderType::EXA_TOTAL_ITEMS)> m_sources;
+
+		// Files stages were loaded from, used by hot reload
+		std::array<std::string, static_cast<size_t>(ShaderType::EXA_TOTAL_ITEMS)> m_sourceFiles;
+
+		// Stage file followed by files it includes, index matches source string number of #line directives
+		std::array<std::vector<std::string>, static_cast<size_t>(ShaderType::EXA_TOTAL_ITEMS)> m_includedFiles;
+
+		// Injected after #version of every stage loaded from file, "NAME" or "NAME VALUE"
+		std::vector<std::string> m_defines;
+
+		// Uniform block name and binding point set by bindUniformBlock
+		std::vector<std::pair<std::string, GLuint>> m_uniformBlockBindings;
+
+		// Set by beginLink for finishLink
+		bool m_linkedFromCache = false;
+		uint64 m_cacheKey = 0;
+
+		// Program being compiled by reload, replaces m_shaderProgram once linked
+		GLuint m_pendingProgram = 0;
+		std::array<GLuint, static_cast<size_t>(ShaderType::EXA_TOTAL_ITEMS)> m_pendingShaders{ 0 };
+		std::array<std::string, static_cast<size_t>(ShaderType::EXA_TOTAL_ITEMS)> m_pendingSources;
+
 	public:
 
 		Shader();
 		~Shader();
 
 
-		// Calls loadShaderFromMemory based on type passed
+		// Stores source of stage based on type passed, it is compiled on link
 		Shader & addShader(GLenum type, const char * shaderSrc);
 
-		// Reads shader from file and calls loadShaderFromMemory based on filename passed
+		// Reads shader from file, resolves its #include directives and injects defines
 		Shader & addShader(const char * filename);
 
-		// Calls glLinkProgram and glAttachShader 
+		// Defines apply to stages added from file afterwards
+		Shader & addDefine(const char * name, const char * value = nullptr);
+
+		const std::vector<std::string>& getDefines() const {
+			return m_defines;
+		}
+
+		// Loads program from binary cache or compiles stages and calls glLinkProgram and glAttachShader 
 		Shader & link();
 
+		// First half of link: issues compilation and linking without waiting for driver, so several
+		// programs started before their finishLink calls are compiled in parallel
+		void beginLink();
+
+		// Second half of link: checks compile and link status, returns false if program is unusable
+		bool finishLink();
+
+		// File stage was loaded from, empty if stage was added from memory
+		const std::string& getSourceFile(ShaderType stage) const {
+			return m_sourceFiles[static_cast<size_t>(stage)];
+		}
+
+		// True if any stage was loaded from file or includes it
+		bool usesSourceFile(const std::string& path) const;
+
+		// All stage files and their includes
+		std::vector<std::string> getSourceDependencies() const;
+
+		// Rereads stage files and starts compiling new program, in background if driver supports
+		// ARB_parallel_shader_compile. Current program stays in use until new one is linked.
+		// @note Must be called on thread owning OpenGL context
+		bool reload();
+
+		// Swaps in reloaded program once driver finished linking, old program is kept if compilation failed.
+		// Returns true while reload is still in progress
+		bool updateReload();
+
+		bool isReloading() const {
+			return m_pendingProgram != 0;
+		}
+
 		// Use the program
 		void bind();
 		void unbind();
 
-		template<typename T> Shader & bindUniform(const char * name, T&& value)
+		// Uploads uniform of any type supported by uniform_traits, skipped if value didn't change since last upload.
+		// Uniforms removed by compiler are ignored with warning logged once per name.
+		// @note Program must be bound
+		template<typename T> Shader & bindUniform(const char * name, const T& value)
 		{
-			int location = getUniformLocation(name);
-			bindUniform(location, std::forward<T>(value));
+			return bindUniform(name, &value, 1);
+		}
+
+		// Uploads count elements of uniform array starting from first one
+		template<typename T> Shader & bindUniform(const char * name, const T* values, GLsizei count)
+		{
+			const UniformName* uniform = findUniform(name);
+			if (uniform != nullptr && updateShadowValue(*uniform, values, sizeof(T), count)) {
+				uniform_traits<T>::upload(uniform->location, count, values);
+			}
 			return *this;
 		}
 
+		template<typename T> Shader & bindUniform(const char * name, const std::vector<T>& values)
+		{
+			return bindUniform(name, values.data(), static_cast<GLsizei>(values.size()));
+		}
+
+		template<typename T, size_t N> Shader & bindUniform(const char * name, const std::array<T, N>& values)
+		{
+			return bindUniform(name, values.data(), static_cast<GLsizei>(N));
+		}
+
+		// Attributes, uniforms, uniform blocks and samplers of linked program
+		const ShaderReflection& getReflection() const {
+			return m_reflection;
+		}
+
 		void activateTexture(GLenum target, int index, GLuint textureGl, const char* uniformName);
 
+		// Assigns binding point to uniform block, kept when program is relinked (GLSL 330 has no binding qualifier)
+		void bindUniformBlock(const char* blockName, GLuint binding);
+
 		void activateTexture2D(int index, GLuint textureGl, const char * uniformName);
 
 		void activateCubeMapTexture(int index, GLuint textureGl, const char * uniformName);
 
+		// Looked up in reflection table, -1 if program doesn't use attribute
 		GLint getAttribLocation(const char* atrName);
 
+		// Looked up in uniform table, -1 if program doesn't use uniform
 		GLint getUniformLocation(const char* atrName);
 
 		// http://stackoverflow.com/questions/22729054/get-member-offset-in-a-template-for-glvertexattribpointer
@@ -78,6 +234,10 @@ namespace exa
 			static_assert(std::is_standard_layout<Vertex>::value, "Error: not a standard layout");
 
 			GLint handle = getAttribLocation(name);
+			if (handle == -1) {
+				return;
+			}
+
 			exaglEnableVertexAttribArray(handle);
 			union
 			{
@@ -109,16 +269,78 @@ namespace exa
 		// Shortcut to validateProgram, validates current program
 		bool validateiv(GLuint flag, const char *file, int line);
 
+		// Creates shader and starts compilation, status is checked by finishLink
 		GLuint loadShaderFromMemory(GLenum type, const char * shaderSrc);
 
-		void bindUniform(unsigned int location, glm::vec4 & value);
+		// Runs preprocessor on file of stage, updates m_includedFiles
+		bool preprocessStage(size_t stage, std::string& source);
 
-		void bindUniform(unsigned int location, float value);
+		// Logs which file each #line source string number refers to
+		void logIncludedFiles(size_t stage) const;
 
-		void bindUniform(unsigned int location, glm::mat4 const & matrix);
+		// Compile or link log of shader or program, doesn't stop engine
+		static std::string getInfoLog(GLuint object, bool isProgram);
 
-		void bindUniform(unsigned int location, int value);
+		// Deletes pending program and shaders of reload
+		void discardReload();
 
 		void init();
+
+		// Active uniform of linked program, arrays are single entry
+		struct Uniform
+		{
+			std::string name;
+			GLint location = -1;
+			// GL_FLOAT_VEC4, GL_SAMPLER_2D, e.t.c.
+			GLenum type = 0;
+			GLint arraySize = 1;
+			// Location of every element of array, queried after link
+			std::vector<GLint> elementLocations;
+			// Last uploaded values of all elements in m_uniformValues, element size is set by first upload
+			size_t valueOffset = 0;
+			size_t elementSize = 0;
+			// Element flags in m_uniformValuesKnown
+			size_t knownOffset = 0;
+		};
+
+		// Name passed to bindUniform, "lights", "lights[0]" and "lights[2]" all refer to one Uniform
+		struct UniformName
+		{
+			std::string name;
+			// Index in m_uniforms, -1 if program doesn't use name
+			int32 uniform = -1;
+			// Element of array name starts at
+			GLint element = 0;
+			GLint location = -1;
+		};
+
+		// Fills reflection and uniform table from linked program
+		void buildReflection();
+
+		int32 addUniform(const ShaderUniform& reflected);
+
+		UniformName* addUniformName(const char* name, int32 uniform, GLint element);
+
+		// Hash lookup of names already seen, nullptr if name was never looked up
+		UniformName* findUniformName(const char* name);
+
+		// Hash lookup, names not seen before are resolved against uniform table once (array elements).
+		// Returns nullptr if program doesn't use uniform
+		const UniformName* findUniform(const char* name);
+
+		// Returns false if values equal last uploaded ones, otherwise stores them
+		bool updateShadowValue(const UniformName& name, const void* values, size_t elementSize, GLsizei count);
+
+		std::vector<Uniform> m_uniforms;
+
+		std::vector<UniformName> m_uniformNames;
+
+		// FNV-1a hash of name to index in m_uniformNames
+		std::unordered_map<uint32, uint32> m_uniformLookup;
+
+		std::vector<unsigned char> m_uniformValues;
+		std::vector<unsigned char> m_uniformValuesKnown;
+
+		ShaderReflection m_reflection;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "ShaderPermutations.h"
+
+#include "Shader.h"
+#include "Log.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	ShaderPermutations::ShaderPermutations()
+	{
+	}
+
+	ShaderPermutations::~ShaderPermutations()
+	{
+		clear();
+	}
+
+	void ShaderPermutations::clear()
+	{
+		for (Shader*& shader : m_shaders) {
+			SafeDelete(shader);
+		}
+		m_shaders.clear();
+		m_variants.clear();
+	}
+
+	uint32 ShaderPermutations::addFeature(const char* define)
+	{
+		uint32 bit = getFeatureBit(define);
+		if (bit != 0) {
+			return bit;
+		}
+
+		if (m_features.size() >= MAX_FEATURES) {
+			log::error("Too many shader features, %s is ignored", define);
+			return 0;
+		}
+
+		m_features.push_back(define);
+		return 1u << (m_features.size() - 1);
+	}
+
+	uint32 ShaderPermutations::getFeatureBit(const char* define) const
+	{
+		for (size_t i = 0; i < m_features.size(); i++) {
+			if (m_features[i] == define) {
+				return 1u << i;
+			}
+		}
+		return 0;
+	}
+
+	ShaderPermutations& ShaderPermutations::addShader(const char* filename)
+	{
+		m_files.push_back(filename);
+		return *this;
+	}
+
+	ShaderPermutations& ShaderPermutations::addPermutation(uint32 key)
+	{
+		m_keys.push_back(key);
+		return *this;
+	}
+
+	bool ShaderPermutations::build()
+	{
+		EXA_PROFILE_FUNCTION();
+
+		clear();
+
+		const uint32 count = 1u << m_features.size();
+		m_variants.assign(count, nullptr);
+
+		std::vector<uint32> keys = m_keys;
+		if (keys.empty()) {
+			for (uint32 key = 0; key < count; key++) {
+				keys.push_back(key);
+			}
+		}
+
+		for (uint32 key : keys) {
+			if (key >= count) {
+				log::error("Shader permutation %u uses undeclared features", key);
+				continue;
+			}
+
+			if (m_variants[key] != nullptr) {
+				continue;
+			}
+
+			Shader* shader = exanew Shader();
+			for (size_t i = 0; i < m_features.size(); i++) {
+				if (key & (1u << i)) {
+					// Shaders test features with #ifdef, disabled ones are not defined
+					shader->addDefine(m_features[i].c_str(), "1");
+				}
+			}
+
+			for (const auto& file : m_files) {
+				shader->addShader(file.c_str());
+			}
+
+			// Driver compiles while next variant is preprocessed
+			shader->beginLink();
+
+			m_shaders.push_back(shader);
+			m_variants[key] = shader;
+		}
+
+		bool success = true;
+		for (Shader* shader : m_shaders) {
+			success = shader->finishLink() && success;
+		}
+
+		log::debug("Built %u shader permutations", static_cast<unsigned int>(m_shaders.size()));
+
+		return success;
+	}
+}
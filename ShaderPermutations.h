@@ -0,0 +1,76 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	class Shader;
+
+	// Variants of one shader built from feature defines. Every feature is a bit of permutation key,
+	// variants are declared up front, compiled together at load and looked up by key in O(1).
+	//
+	// ShaderPermutations lighting;
+	// uint32 normalMap = lighting.addFeature("NORMAL_MAP");
+	// uint32 shadows = lighting.addFeature("SHADOWS");
+	// lighting.addShader("lit.vert").addShader("lit.frag");
+	// lighting.addPermutation(0);
+	// lighting.addPermutation(normalMap | shadows);
+	// lighting.build();
+	// lighting.get(normalMap | shadows)->bind();
+	class ShaderPermutations
+	{
+	public:
+		// Lookup table has 2^features entries
+		static const size_t MAX_FEATURES = 12;
+
+		ShaderPermutations();
+		~ShaderPermutations();
+
+		// Feature is enabled in variant by "#define NAME 1", returns its bit in permutation key
+		uint32 addFeature(const char* define);
+
+		// Bit of feature added before, 0 if unknown
+		uint32 getFeatureBit(const char* define) const;
+
+		// Stage file shared by all variants
+		ShaderPermutations& addShader(const char* filename);
+
+		// Variant to build, all combinations of features are built if none is declared
+		ShaderPermutations& addPermutation(uint32 key);
+
+		// Preprocesses all declared variants, then starts compiling every one of them before waiting
+		// for any, so driver compiles them in parallel. Returns false if any variant failed.
+		// @note Must be called on thread owning OpenGL context
+		bool build();
+
+		// nullptr if variant wasn't declared
+		Shader* get(uint32 key) const {
+			return key < m_variants.size() ? m_variants[key] : nullptr;
+		}
+
+		// Programs of all built variants, one per key
+		const std::vector<Shader*>& getShaders() const {
+			return m_shaders;
+		}
+
+	private:
+		// Destroys programs and empties lookup table
+		void clear();
+
+		std::vector<std::string> m_features;
+		std::vector<std::string> m_files;
+		std::vector<uint32> m_keys;
+
+		// Owned
+		std::vector<Shader*> m_shaders;
+
+		// Indexed by permutation key
+		std::vector<Shader*> m_variants;
+	};
+}
@@ -0,0 +1,207 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "File.h"
+#include "Log.h"
+
+namespace exa
+{
+	namespace
+	{
+		// Returns directive name and sets rest to text after it, empty name if line is not directive
+		std::string parseDirective(const std::string& line, std::string& rest)
+		{
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line[start] != '#') {
+				return std::string();
+			}
+
+			size_t nameStart = line.find_first_not_of(" \t", start + 1);
+			if (nameStart == std::string::npos) {
+				return std::string();
+			}
+
+			size_t nameEnd = line.find_first_of(" \t\r", nameStart);
+			if (nameEnd == std::string::npos) {
+				nameEnd = line.size();
+			}
+
+			rest = line.substr(nameEnd);
+			return line.substr(nameStart, nameEnd - nameStart);
+		}
+
+		std::string getDirectory(const std::string& path)
+		{
+			size_t slash = path.find_last_of("/\\");
+			return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+		}
+	}
+
+	ShaderPreprocessor::ShaderPreprocessor()
+	{
+		m_includeDirectories.push_back(PROJECT_SHADERS_DIR);
+	}
+
+	void ShaderPreprocessor::addIncludeDirectory(const std::string& directory)
+	{
+		std::string path = directory;
+		if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+			path += '/';
+		}
+		m_includeDirectories.push_back(path);
+	}
+
+	bool ShaderPreprocessor::process(const std::string& path, std::string& output)
+	{
+		m_files.clear();
+		m_onceFiles.clear();
+		output.clear();
+
+		std::vector<std::string> includeStack;
+		return processFile(path, includeStack, output);
+	}
+
+	std::string ShaderPreprocessor::resolveInclude(const std::string& name, const std::string& includingFile) const
+	{
+		std::string path = getDirectory(includingFile) + name;
+		if (File::exists(path.c_str())) {
+			return path;
+		}
+
+		for (const auto& directory : m_includeDirectories) {
+			path = directory + name;
+			if (File::exists(path.c_str())) {
+				return path;
+			}
+		}
+
+		return std::string();
+	}
+
+	bool ShaderPreprocessor::processFile(const std::string& path, std::vector<std::string>& includeStack, std::string& output)
+	{
+		if (std::find(includeStack.begin(), includeStack.end(), path) != includeStack.end()) {
+			log::error("Recursive include of %s", path.c_str());
+			return false;
+		}
+
+		if (static_cast<int>(includeStack.size()) >= MAX_INCLUDE_DEPTH) {
+			log::error("Include depth limit reached in %s", path.c_str());
+			return false;
+		}
+
+		if (!File::exists(path.c_str())) {
+			log::error("Shader file %s doesn't exist", path.c_str());
+			return false;
+		}
+
+		File file;
+		if (!file.load(path.c_str())) {
+			return false;
+		}
+
+		const int fileIndex = static_cast<int>(m_files.size());
+		m_files.push_back(path);
+		includeStack.push_back(path);
+
+		const bool isMainFile = includeStack.size() == 1;
+
+		std::istringstream stream(std::string(reinterpret_cast<const char*>(file.getBuffer()), static_cast<size_t>(file.getLength())));
+
+		std::vector<std::string> lines;
+		std::string text;
+		while (std::getline(stream, text)) {
+			lines.push_back(text);
+		}
+
+		// Comments and blank lines may precede #version, so it is found before anything is emitted.
+		// Defines follow it, or start main file without #version
+		int versionLine = 0;
+		if (isMainFile) {
+			for (size_t i = 0; i < lines.size(); i++) {
+				std::string rest;
+				if (parseDirective(lines[i], rest) == "version") {
+					versionLine = static_cast<int>(i) + 1;
+					break;
+				}
+			}
+		}
+
+		std::ostringstream result;
+
+		// Every file starts own source string number, included files get no defines
+		auto beginSource = [&](int nextLine) {
+			if (isMainFile) {
+				for (const auto& define : m_defines) {
+					result << "#define " << define << "\n";
+				}
+			}
+			result << "#line " << nextLine << " " << fileIndex << "\n";
+		};
+
+		if (versionLine == 0) {
+			beginSource(1);
+		}
+
+		for (size_t i = 0; i < lines.size(); i++) {
+			const int lineNumber = static_cast<int>(i) + 1;
+			const std::string& line = lines[i];
+
+			std::string rest;
+			std::string directive = parseDirective(line, rest);
+
+			if (lineNumber == versionLine) {
+				result << line << "\n";
+				beginSource(lineNumber + 1);
+				continue;
+			}
+
+			if (directive == "pragma" && rest.find("once") != std::string::npos) {
+				if (std::find(m_onceFiles.begin(), m_onceFiles.end(), path) != m_onceFiles.end()) {
+					includeStack.pop_back();
+					return true;
+				}
+				m_onceFiles.push_back(path);
+				result << "\n";
+				continue;
+			}
+
+			if (directive == "include") {
+				size_t open = rest.find_first_of("\"<");
+				size_t close = (open == std::string::npos) ? std::string::npos : rest.find_first_of("\">", open + 1);
+				if (close == std::string::npos) {
+					log::error("%s:%d: malformed #include", path.c_str(), lineNumber);
+					return false;
+				}
+
+				const std::string name = rest.substr(open + 1, close - open - 1);
+				const std::string includePath = resolveInclude(name, path);
+				if (includePath.empty()) {
+					log::error("%s:%d: can't find include %s", path.c_str(), lineNumber, name.c_str());
+					return false;
+				}
+
+				std::string included;
+				if (!processFile(includePath, includeStack, included)) {
+					return false;
+				}
+
+				result << included;
+				result << "#line " << (lineNumber + 1) << " " << fileIndex << "\n";
+				continue;
+			}
+
+			result << line << "\n";
+		}
+
+		includeStack.pop_back();
+
+		output += result.str();
+		return true;
+	}
+}
@@ -0,0 +1,50 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "exa.h"
+
+namespace exa
+{
+	// Expands #include "file" (with #pragma once support) and injects #define lines right after #version.
+	// Emits #line directives with index of file in getFiles() as source string number, so compiler
+	// errors point to original files.
+	class ShaderPreprocessor
+	{
+	public:
+		static const int MAX_INCLUDE_DEPTH = 32;
+
+		ShaderPreprocessor();
+
+		// Searched after directory of including file (PROJECT_SHADERS_DIR by default)
+		void addIncludeDirectory(const std::string& directory);
+
+		// "NAME" or "NAME VALUE"
+		void setDefines(const std::vector<std::string>& defines) {
+			m_defines = defines;
+		}
+
+		// Returns false and logs error if file or one of its includes can't be read
+		bool process(const std::string& path, std::string& output);
+
+		// Main file and all included files of last process call
+		const std::vector<std::string>& getFiles() const {
+			return m_files;
+		}
+
+	private:
+		bool processFile(const std::string& path, std::vector<std::string>& includeStack, std::string& output);
+
+		// Returns empty string if include not found
+		std::string resolveInclude(const std::string& name, const std::string& includingFile) const;
+
+		std::vector<std::string> m_includeDirectories;
+		std::vector<std::string> m_defines;
+		std::vector<std::string> m_files;
+		std::vector<std::string> m_onceFiles;
+	};
+}
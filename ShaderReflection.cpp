@@ -0,0 +1,262 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "ShaderReflection.h"
+
+#include <algorithm>
+
+#include "Hash.h"
+#include "Log.h"
+
+namespace exa
+{
+	namespace
+	{
+		// "name[0]" -> "name"
+		std::string stripArraySuffix(const char* name, GLsizei length)
+		{
+			std::string result(name, static_cast<size_t>(length));
+			if (result.size() > 3 && result.compare(result.size() - 3, 3, "[0]") == 0) {
+				result.resize(result.size() - 3);
+			}
+			return result;
+		}
+
+		template <typename T>
+		const T* findByName(const std::vector<T>& items, const char* name)
+		{
+			const uint32 hash = hashFnv1a32(name);
+			for (const auto& item : items) {
+				if (item.nameHash == hash && item.name == name) {
+					return &item;
+				}
+			}
+			return nullptr;
+		}
+
+		struct SamplerTarget
+		{
+			GLenum type;
+			GLenum target;
+		};
+
+		const SamplerTarget SAMPLER_TARGETS[] = {
+			{ GL_SAMPLER_1D, GL_TEXTURE_1D },
+			{ GL_SAMPLER_2D, GL_TEXTURE_2D },
+			{ GL_SAMPLER_3D, GL_TEXTURE_3D },
+			{ GL_SAMPLER_CUBE, GL_TEXTURE_CUBE_MAP },
+			{ GL_SAMPLER_1D_SHADOW, GL_TEXTURE_1D },
+			{ GL_SAMPLER_2D_SHADOW, GL_TEXTURE_2D },
+			{ GL_SAMPLER_1D_ARRAY, GL_TEXTURE_1D_ARRAY },
+			{ GL_SAMPLER_2D_ARRAY, GL_TEXTURE_2D_ARRAY },
+			{ GL_SAMPLER_1D_ARRAY_SHADOW, GL_TEXTURE_1D_ARRAY },
+			{ GL_SAMPLER_2D_ARRAY_SHADOW, GL_TEXTURE_2D_ARRAY },
+			{ GL_SAMPLER_2D_MULTISAMPLE, GL_TEXTURE_2D_MULTISAMPLE },
+			{ GL_SAMPLER_2D_MULTISAMPLE_ARRAY, GL_TEXTURE_2D_MULTISAMPLE_ARRAY },
+			{ GL_SAMPLER_CUBE_SHADOW, GL_TEXTURE_CUBE_MAP },
+			{ GL_SAMPLER_BUFFER, GL_TEXTURE_BUFFER },
+			{ GL_SAMPLER_2D_RECT, GL_TEXTURE_RECTANGLE },
+			{ GL_SAMPLER_2D_RECT_SHADOW, GL_TEXTURE_RECTANGLE },
+			{ GL_INT_SAMPLER_1D, GL_TEXTURE_1D },
+			{ GL_INT_SAMPLER_2D, GL_TEXTURE_2D },
+			{ GL_INT_SAMPLER_3D, GL_TEXTURE_3D },
+			{ GL_INT_SAMPLER_CUBE, GL_TEXTURE_CUBE_MAP },
+			{ GL_INT_SAMPLER_1D_ARRAY, GL_TEXTURE_1D_ARRAY },
+			{ GL_INT_SAMPLER_2D_ARRAY, GL_TEXTURE_2D_ARRAY },
+			{ GL_INT_SAMPLER_2D_MULTISAMPLE, GL_TEXTURE_2D_MULTISAMPLE },
+			{ GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY, GL_TEXTURE_2D_MULTISAMPLE_ARRAY },
+			{ GL_INT_SAMPLER_BUFFER, GL_TEXTURE_BUFFER },
+			{ GL_INT_SAMPLER_2D_RECT, GL_TEXTURE_RECTANGLE },
+			{ GL_UNSIGNED_INT_SAMPLER_1D, GL_TEXTURE_1D },
+			{ GL_UNSIGNED_INT_SAMPLER_2D, GL_TEXTURE_2D },
+			{ GL_UNSIGNED_INT_SAMPLER_3D, GL_TEXTURE_3D },
+			{ GL_UNSIGNED_INT_SAMPLER_CUBE, GL_TEXTURE_CUBE_MAP },
+			{ GL_UNSIGNED_INT_SAMPLER_1D_ARRAY, GL_TEXTURE_1D_ARRAY },
+			{ GL_UNSIGNED_INT_SAMPLER_2D_ARRAY, GL_TEXTURE_2D_ARRAY },
+			{ GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE, GL_TEXTURE_2D_MULTISAMPLE },
+			{ GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY, GL_TEXTURE_2D_MULTISAMPLE_ARRAY },
+			{ GL_UNSIGNED_INT_SAMPLER_BUFFER, GL_TEXTURE_BUFFER },
+			{ GL_UNSIGNED_INT_SAMPLER_2D_RECT, GL_TEXTURE_RECTANGLE }
+		};
+	}
+
+	GLenum ShaderReflection::getSamplerTarget(GLenum type)
+	{
+		for (const auto& sampler : SAMPLER_TARGETS) {
+			if (sampler.type == type) {
+				return sampler.target;
+			}
+		}
+		return 0;
+	}
+
+	void ShaderReflection::clear()
+	{
+		m_attributes.clear();
+		m_uniforms.clear();
+		m_uniformBlocks.clear();
+		m_samplers.clear();
+	}
+
+	void ShaderReflection::build(GLuint program)
+	{
+		clear();
+
+		buildAttributes(program);
+		buildUniforms(program);
+		buildUniformBlocks(program);
+	}
+
+	void ShaderReflection::buildAttributes(GLuint program)
+	{
+		GLint count = 0;
+		GLint maxLength = 0;
+		exaglGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+		exaglGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+
+		std::vector<char> name(static_cast<size_t>(std::max(maxLength, 1)));
+		m_attributes.reserve(static_cast<size_t>(count));
+
+		for (GLint i = 0; i < count; i++) {
+			ShaderAttribute attribute;
+			GLsizei length = 0;
+			exaglGetActiveAttrib(program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &attribute.arraySize, &attribute.type, name.data());
+
+			// Built-ins like gl_VertexID are reported without location
+			attribute.location = exaglGetAttribLocation(program, name.data());
+			if (attribute.location == -1) {
+				continue;
+			}
+
+			attribute.name = stripArraySuffix(name.data(), length);
+			attribute.nameHash = hashFnv1a32(attribute.name.c_str());
+			m_attributes.push_back(std::move(attribute));
+		}
+
+		// Vertex layouts walk attributes in location order
+		std::sort(m_attributes.begin(), m_attributes.end(), [](const ShaderAttribute& a, const ShaderAttribute& b) {
+			return a.location < b.location;
+		});
+	}
+
+	void ShaderReflection::buildUniforms(GLuint program)
+	{
+		GLint count = 0;
+		GLint maxLength = 0;
+		exaglGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		exaglGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+		if (count <= 0) {
+			return;
+		}
+
+		// Block membership of all uniforms in two calls
+		std::vector<GLuint> indices(static_cast<size_t>(count));
+		for (GLint i = 0; i < count; i++) {
+			indices[static_cast<size_t>(i)] = static_cast<GLuint>(i);
+		}
+
+		std::vector<GLint> blockIndices(static_cast<size_t>(count), -1);
+		std::vector<GLint> blockOffsets(static_cast<size_t>(count), -1);
+		exaglGetActiveUniformsiv(program, count, indices.data(), GL_UNIFORM_BLOCK_INDEX, blockIndices.data());
+		exaglGetActiveUniformsiv(program, count, indices.data(), GL_UNIFORM_OFFSET, blockOffsets.data());
+
+		std::vector<char> name(static_cast<size_t>(std::max(maxLength, 1)));
+		m_uniforms.reserve(static_cast<size_t>(count));
+
+		for (GLint i = 0; i < count; i++) {
+			ShaderUniform uniform;
+			GLsizei length = 0;
+			exaglGetActiveUniform(program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length, &uniform.arraySize, &uniform.type, name.data());
+
+			uniform.blockIndex = blockIndices[static_cast<size_t>(i)];
+			uniform.blockOffset = blockOffsets[static_cast<size_t>(i)];
+			if (uniform.blockIndex == -1) {
+				uniform.location = exaglGetUniformLocation(program, name.data());
+			}
+
+			uniform.name = stripArraySuffix(name.data(), length);
+			uniform.nameHash = hashFnv1a32(uniform.name.c_str());
+
+			const GLenum target = getSamplerTarget(uniform.type);
+			if (target != 0 && uniform.location != -1) {
+				ShaderSampler sampler;
+				sampler.name = uniform.name;
+				sampler.nameHash = uniform.nameHash;
+				sampler.location = uniform.location;
+				sampler.type = uniform.type;
+				sampler.target = target;
+				sampler.arraySize = uniform.arraySize;
+				exaglGetUniformiv(program, uniform.location, &sampler.unit);
+				m_samplers.push_back(std::move(sampler));
+			}
+
+			m_uniforms.push_back(std::move(uniform));
+		}
+	}
+
+	void ShaderReflection::buildUniformBlocks(GLuint program)
+	{
+		GLint count = 0;
+		GLint maxLength = 0;
+		exaglGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		exaglGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+
+		std::vector<char> name(static_cast<size_t>(std::max(maxLength, 1)));
+		m_uniformBlocks.reserve(static_cast<size_t>(count));
+
+		for (GLint i = 0; i < count; i++) {
+			ShaderUniformBlock block;
+			block.index = static_cast<GLuint>(i);
+
+			GLsizei length = 0;
+			exaglGetActiveUniformBlockName(program, block.index, static_cast<GLsizei>(name.size()), &length, name.data());
+			exaglGetActiveUniformBlockiv(program, block.index, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+			exaglGetActiveUniformBlockiv(program, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+			exaglGetActiveUniformBlockiv(program, block.index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &block.activeUniforms);
+
+			block.name.assign(name.data(), static_cast<size_t>(length));
+			block.nameHash = hashFnv1a32(block.name.c_str());
+			m_uniformBlocks.push_back(std::move(block));
+		}
+	}
+
+	const ShaderAttribute* ShaderReflection::findAttribute(const char* name) const
+	{
+		return findByName(m_attributes, name);
+	}
+
+	const ShaderUniform* ShaderReflection::findUniform(const char* name) const
+	{
+		return findByName(m_uniforms, name);
+	}
+
+	const ShaderUniformBlock* ShaderReflection::findUniformBlock(const char* name) const
+	{
+		return findByName(m_uniformBlocks, name);
+	}
+
+	const ShaderSampler* ShaderReflection::findSampler(const char* name) const
+	{
+		return findByName(m_samplers, name);
+	}
+
+	void ShaderReflection::dump() const
+	{
+		for (const auto& attribute : m_attributes) {
+			log::debug("  attribute %s location %d type 0x%x size %d", attribute.name.c_str(), attribute.location, attribute.type, attribute.arraySize);
+		}
+
+		for (const auto& uniform : m_uniforms) {
+			log::debug("  uniform %s location %d type 0x%x size %d block %d offset %d", uniform.name.c_str(), uniform.location, uniform.type, uniform.arraySize, uniform.blockIndex, uniform.blockOffset);
+		}
+
+		for (const auto& block : m_uniformBlocks) {
+			log::debug("  uniform block %s binding %d size %d uniforms %d", block.name.c_str(), block.binding, block.dataSize, block.activeUniforms);
+		}
+
+		for (const auto& sampler : m_samplers) {
+			log::debug("  sampler %s location %d target 0x%x unit %d", sampler.name.c_str(), sampler.location, sampler.target, sampler.unit);
+		}
+	}
+}
@@ -0,0 +1,110 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "exa.h"
+#include "RenderPlatforms.h"
+
+namespace exa
+{
+	struct ShaderAttribute
+	{
+		std::string name;
+		uint32 nameHash = 0;
+		GLint location = -1;
+		// GL_FLOAT_VEC3, e.t.c.
+		GLenum type = 0;
+		GLint arraySize = 1;
+	};
+
+	struct ShaderUniform
+	{
+		std::string name;
+		uint32 nameHash = 0;
+		// -1 for members of uniform blocks
+		GLint location = -1;
+		GLenum type = 0;
+		GLint arraySize = 1;
+		// Index in getUniformBlocks() and byte offset in block, -1 for default block uniforms
+		GLint blockIndex = -1;
+		GLint blockOffset = -1;
+	};
+
+	struct ShaderUniformBlock
+	{
+		std::string name;
+		uint32 nameHash = 0;
+		GLuint index = 0;
+		GLint binding = 0;
+		GLint dataSize = 0;
+		GLint activeUniforms = 0;
+	};
+
+	struct ShaderSampler
+	{
+		std::string name;
+		uint32 nameHash = 0;
+		GLint location = -1;
+		// GL_SAMPLER_2D, e.t.c.
+		GLenum type = 0;
+		// Texture target matching type (GL_TEXTURE_2D, e.t.c.)
+		GLenum target = 0;
+		GLint arraySize = 1;
+		// Texture unit assigned in program
+		GLint unit = 0;
+	};
+
+	// Everything a linked program uses, queried once after link so that vertex layouts, uniform
+	// uploads and materials are matched against tables rather than by driver queries.
+	// Array names are stored without "[0]" suffix.
+	class ShaderReflection
+	{
+	public:
+		// @note Program must be linked
+		void build(GLuint program);
+
+		void clear();
+
+		// nullptr if program doesn't use name
+		const ShaderAttribute* findAttribute(const char* name) const;
+		const ShaderUniform* findUniform(const char* name) const;
+		const ShaderUniformBlock* findUniformBlock(const char* name) const;
+		const ShaderSampler* findSampler(const char* name) const;
+
+		const std::vector<ShaderAttribute>& getAttributes() const {
+			return m_attributes;
+		}
+
+		const std::vector<ShaderUniform>& getUniforms() const {
+			return m_uniforms;
+		}
+
+		const std::vector<ShaderUniformBlock>& getUniformBlocks() const {
+			return m_uniformBlocks;
+		}
+
+		const std::vector<ShaderSampler>& getSamplers() const {
+			return m_samplers;
+		}
+
+		// Texture target sampled by sampler type, 0 if type is not sampler
+		static GLenum getSamplerTarget(GLenum type);
+
+		// Logs all tables
+		void dump() const;
+
+	private:
+		void buildAttributes(GLuint program);
+		void buildUniforms(GLuint program);
+		void buildUniformBlocks(GLuint program);
+
+		std::vector<ShaderAttribute> m_attributes;
+		std::vector<ShaderUniform> m_uniforms;
+		std::vector<ShaderUniformBlock> m_uniformBlocks;
+		std::vector<ShaderSampler> m_samplers;
+	};
+}
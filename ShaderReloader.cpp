@@ -0,0 +1,94 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "ShaderReloader.h"
+
+#include <algorithm>
+
+#include "Shader.h"
+#include "Log.h"
+
+namespace exa
+{
+	namespace
+	{
+		void addUnique(std::vector<Shader*>& shaders, Shader* shader)
+		{
+			if (std::find(shaders.begin(), shaders.end(), shader) == shaders.end()) {
+				shaders.push_back(shader);
+			}
+		}
+	}
+
+	ShaderReloader::ShaderReloader()
+	{
+		if (!m_watcher.isUsingNotifications()) {
+			log::debug("Shader files are polled for changes");
+		}
+	}
+
+	ShaderReloader::~ShaderReloader()
+	{
+	}
+
+	void ShaderReloader::watch(Shader* shader)
+	{
+		addUnique(m_shaders, shader);
+
+		// Editing an include reloads every shader using it
+		for (const auto& file : shader->getSourceDependencies()) {
+			m_watcher.addFile(file);
+		}
+	}
+
+	void ShaderReloader::unwatch(Shader* shader)
+	{
+		m_shaders.erase(std::remove(m_shaders.begin(), m_shaders.end(), shader), m_shaders.end());
+
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_queued.erase(std::remove(m_queued.begin(), m_queued.end(), shader), m_queued.end());
+		m_compiling.erase(std::remove(m_compiling.begin(), m_compiling.end(), shader), m_compiling.end());
+	}
+
+	void ShaderReloader::pollChanges()
+	{
+		m_changedFiles.clear();
+		m_watcher.update(m_changedFiles);
+
+		if (m_changedFiles.empty()) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		for (const auto& file : m_changedFiles) {
+			log::debug("Shader file changed: %s", file.c_str());
+			for (Shader* shader : m_shaders) {
+				if (shader->usesSourceFile(file)) {
+					addUnique(m_queued, shader);
+				}
+			}
+		}
+	}
+
+	void ShaderReloader::update()
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+
+		for (Shader* shader : m_queued) {
+			if (shader->reload()) {
+				addUnique(m_compiling, shader);
+			}
+		}
+		m_queued.clear();
+
+		// Frame keeps rendering with old programs while new ones compile
+		m_compiling.erase(std::remove_if(m_compiling.begin(), m_compiling.end(), [](Shader* shader) {
+			return !shader->updateReload();
+		}), m_compiling.end());
+	}
+
+	void ShaderReloader::updateCallback(void* userData, const FrameSnapshot& /*snapshot*/)
+	{
+		static_cast<ShaderReloader*>(userData)->update();
+	}
+}
@@ -0,0 +1,54 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "exa.h"
+#include "FileWatcher.h"
+#include "RenderCommandBuffer.h"
+
+namespace exa
+{
+	class Shader;
+
+	// Watches source files of shaders and recompiles them when they change.
+	// Changes are detected on main thread, compilation and program swap happen on thread owning OpenGL context.
+	class ShaderReloader
+	{
+	public:
+		ShaderReloader();
+		~ShaderReloader();
+
+		// @note Shader must be unwatched before it is deleted
+		void watch(Shader* shader);
+
+		void unwatch(Shader* shader);
+
+		// Queues shaders whose files changed, called on main thread every frame
+		void pollChanges();
+
+		// Starts compiling queued shaders and swaps in finished ones, called on thread owning OpenGL context
+		void update();
+
+		// Command buffer callback calling update
+		static void updateCallback(void* userData, const FrameSnapshot& snapshot);
+
+	private:
+		FileWatcher m_watcher;
+
+		std::vector<Shader*> m_shaders;
+
+		std::vector<std::string> m_changedFiles;
+
+		// Filled on main thread, drained on render thread
+		std::mutex m_queueMutex;
+		std::vector<Shader*> m_queued;
+
+		// Shaders waiting for driver to finish linking, guarded by m_queueMutex too
+		std::vector<Shader*> m_compiling;
+	};
+}
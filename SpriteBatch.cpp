@@ -0,0 +1,296 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "SpriteBatch.h"
+
+#include <cstring>
+
+#include <glm/gtc/packing.hpp>
+
+#include "Log.h"
+#include "Profiler.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "VertexArray.h"
+#include "VertexBuffer.h"
+
+namespace exa
+{
+	namespace
+	{
+		const GLuint CORNER_LOCATION = 0;
+		const GLuint FIRST_INSTANCE_LOCATION = 1;
+
+		// Bits of sort key, layer is most significant so that layers are drawn in order
+		const uint32 LAYER_SHIFT = 32;
+		const uint32 SHADER_SHIFT = 16;
+		const uint64 STATE_MASK = 0xFFFFFFFF;
+		const uint64 SHADER_MASK = 0xFFFF0000;
+		const uint32 MAX_STATES = 0xFFFF;
+
+		const float CORNERS[] = {
+			-0.5f, -0.5f,
+			0.5f, -0.5f,
+			-0.5f, 0.5f,
+			0.5f, 0.5f
+		};
+	}
+
+	const char* const SpriteBatch::VIEW_PROJECTION_UNIFORM = "viewProjection";
+	const char* const SpriteBatch::TEXTURE_UNIFORM = "spriteTexture";
+
+	SpriteBatch::SpriteBatch(Shader* defaultShader, uint32 maxSprites)
+		: m_defaultShader(defaultShader)
+		, m_maxSprites(maxSprites)
+		, m_viewProjection(1.0f)
+	{
+		m_instances.reserve(maxSprites);
+		m_keys.reserve(maxSprites);
+		m_order.reserve(maxSprites);
+
+		m_vertexArray = exanew VertexArray();
+		m_corners = exanew VertexBuffer();
+		m_stream = exanew StreamBuffer(GL_ARRAY_BUFFER, maxSprites * sizeof(SpriteInstance));
+
+		m_vertexArray->bind();
+		m_corners->setData(CORNERS, sizeof(CORNERS), GL_STATIC_DRAW);
+		SpriteCornerLayout::applyLocations(CORNER_LOCATION);
+		m_vertexArray->unbind();
+	}
+
+	SpriteBatch::~SpriteBatch()
+	{
+		SafeDelete(m_stream);
+		SafeDelete(m_corners);
+		SafeDelete(m_vertexArray);
+	}
+
+	uint32 SpriteBatch::packColor(const glm::vec4& color)
+	{
+		return glm::packUnorm4x8(color);
+	}
+
+	void SpriteBatch::begin(const glm::mat4& viewProjection)
+	{
+		m_viewProjection = viewProjection;
+		m_stats = SpriteBatchStats();
+	}
+
+	uint32 SpriteBatch::getShaderIndex(Shader* shader)
+	{
+		if (m_lastShader < m_shaders.size() && m_shaders[m_lastShader] == shader) {
+			return m_lastShader;
+		}
+
+		for (uint32 i = 0; i < m_shaders.size(); i++) {
+			if (m_shaders[i] == shader) {
+				m_lastShader = i;
+				return i;
+			}
+		}
+
+		m_lastShader = static_cast<uint32>(m_shaders.size());
+		m_shaders.push_back(shader);
+		return m_lastShader;
+	}
+
+	uint32 SpriteBatch::getTextureIndex(GLuint texture)
+	{
+		if (m_lastTexture < m_textures.size() && m_textures[m_lastTexture] == texture) {
+			return m_lastTexture;
+		}
+
+		for (uint32 i = 0; i < m_textures.size(); i++) {
+			if (m_textures[i] == texture) {
+				m_lastTexture = i;
+				return i;
+			}
+		}
+
+		m_lastTexture = static_cast<uint32>(m_textures.size());
+		m_textures.push_back(texture);
+		return m_lastTexture;
+	}
+
+	void SpriteBatch::draw(const Sprite& sprite)
+	{
+		if (m_instances.size() >= m_maxSprites) {
+			m_stats.dropped++;
+			return;
+		}
+
+		const uint32 shader = getShaderIndex(sprite.shader != nullptr ? sprite.shader : m_defaultShader);
+		const uint32 texture = getTextureIndex(sprite.texture);
+		if (shader > MAX_STATES || texture > MAX_STATES) {
+			m_stats.dropped++;
+			return;
+		}
+
+		// Biased so that negative layers sort first
+		const uint64 layer = static_cast<uint16>(sprite.layer) ^ 0x8000u;
+
+		m_keys.push_back((layer << LAYER_SHIFT) | (static_cast<uint64>(shader) << SHADER_SHIFT) | texture);
+		m_order.push_back(static_cast<uint32>(m_instances.size()));
+
+		const glm::u16vec4 uvRect = glm::packUnorm<uint16>(sprite.uvRect);
+
+		SpriteInstance instance;
+		instance.Position[0] = sprite.position.x;
+		instance.Position[1] = sprite.position.y;
+		instance.Size[0] = sprite.size.x;
+		instance.Size[1] = sprite.size.y;
+		instance.Rotation = sprite.rotation;
+		instance.UvRect[0] = uvRect.x;
+		instance.UvRect[1] = uvRect.y;
+		instance.UvRect[2] = uvRect.z;
+		instance.UvRect[3] = uvRect.w;
+		instance.Tint = sprite.tint;
+		m_instances.push_back(instance);
+	}
+
+	void SpriteBatch::end(RenderCommandBuffer& commands)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		const uint32 count = static_cast<uint32>(m_instances.size());
+		m_stats.sprites = count;
+
+		if (m_stats.dropped > 0) {
+			log::warning("Sprite batch dropped %u sprites over limit of %u", m_stats.dropped, m_maxSprites);
+		}
+
+		if (count > 0) {
+			m_sorter.sort(m_keys, m_order);
+
+			// Runs of equal shader and texture, layer alone doesn't break batch
+			m_ranges.clear();
+			uint64 previousState = ~static_cast<uint64>(0);
+			for (uint32 i = 0; i < count; i++) {
+				const uint64 state = m_keys[i] & STATE_MASK;
+				if (state != previousState) {
+					if (i > 0) {
+						if ((state & SHADER_MASK) != (previousState & SHADER_MASK)) {
+							m_stats.shaderBreaks++;
+						}
+						else {
+							m_stats.textureBreaks++;
+						}
+					}
+
+					Range range;
+					range.shader = m_shaders[static_cast<uint32>(state >> SHADER_SHIFT)];
+					range.texture = m_textures[static_cast<uint32>(state & 0xFFFF)];
+					range.first = i;
+					range.count = 0;
+					m_ranges.push_back(range);
+
+					previousState = state;
+				}
+				m_ranges.back().count++;
+			}
+
+			m_stats.batches = static_cast<uint32>(m_ranges.size());
+
+			const size_t rangesSize = m_ranges.size() * sizeof(Range);
+			const size_t size = sizeof(FrameHeader) + rangesSize + count * sizeof(SpriteInstance);
+			unsigned char* data = static_cast<unsigned char*>(commands.callback(&SpriteBatch::submitCallback, this, size));
+
+			FrameHeader header;
+			header.viewProjection = m_viewProjection;
+			header.instanceCount = count;
+			header.rangeCount = static_cast<uint32>(m_ranges.size());
+			memcpy(data, &header, sizeof(FrameHeader));
+			memcpy(data + sizeof(FrameHeader), m_ranges.data(), rangesSize);
+
+			// Gathered in sorted order straight into command buffer
+			SpriteInstance* instances = reinterpret_cast<SpriteInstance*>(data + sizeof(FrameHeader) + rangesSize);
+			for (uint32 i = 0; i < count; i++) {
+				instances[i] = m_instances[m_order[i]];
+			}
+		}
+
+		m_instances.clear();
+		m_keys.clear();
+		m_order.clear();
+		m_shaders.clear();
+		m_textures.clear();
+		m_lastShader = 0;
+		m_lastTexture = 0;
+	}
+
+	void SpriteBatch::submitCallback(void* userData, const void* data, size_t /*size*/, const FrameSnapshot& snapshot)
+	{
+		static_cast<SpriteBatch*>(userData)->submit(static_cast<const unsigned char*>(data), snapshot);
+	}
+
+	void SpriteBatch::submit(const unsigned char* data, const FrameSnapshot& snapshot)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		FrameHeader header;
+		memcpy(&header, data, sizeof(FrameHeader));
+
+		// Command data is not aligned for Range, ranges are copied out one by one
+		const unsigned char* ranges = data + sizeof(FrameHeader);
+		const unsigned char* instances = data + sizeof(FrameHeader) + header.rangeCount * sizeof(Range);
+
+		if (snapshot.frameIndex != m_streamFrame) {
+			// endFrameCallback was not recorded, previous region is fenced late rather than never
+			if (!m_streamFenced) {
+				endFrame();
+			}
+			m_stream->beginFrame();
+			m_streamFrame = snapshot.frameIndex;
+			m_streamFenced = false;
+		}
+
+		const size_t offset = m_stream->write(instances, header.instanceCount * sizeof(SpriteInstance), sizeof(SpriteInstance));
+		if (offset == StreamBuffer::INVALID_OFFSET) {
+			return;
+		}
+
+		m_vertexArray->bind();
+
+		Shader* shader = nullptr;
+		GLuint texture = 0;
+
+		for (uint32 i = 0; i < header.rangeCount; i++) {
+			Range range;
+			memcpy(&range, ranges + i * sizeof(Range), sizeof(Range));
+
+			if (range.shader != shader) {
+				shader = range.shader;
+				shader->bind();
+				shader->bindUniform(VIEW_PROJECTION_UNIFORM, header.viewProjection);
+				texture = ~range.texture;
+			}
+
+			if (range.texture != texture) {
+				texture = range.texture;
+				shader->activateTexture(GL_TEXTURE_2D, 0, texture, TEXTURE_UNIFORM);
+			}
+
+			// No base instance in OpenGL 3.3, instance attributes point at start of range instead
+			m_stream->bind();
+			SpriteInstanceLayout::applyLocations(FIRST_INSTANCE_LOCATION, offset + range.first * sizeof(SpriteInstance));
+
+			exaglDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(range.count));
+		}
+	}
+
+	void SpriteBatch::endFrame()
+	{
+		if (m_streamFenced) {
+			return;
+		}
+
+		// One fence after all submits of frame covers whole region
+		m_stream->endFrame();
+		m_streamFenced = true;
+	}
+
+	void SpriteBatch::endFrameCallback(void* userData, const FrameSnapshot& /*snapshot*/)
+	{
+		static_cast<SpriteBatch*>(userData)->endFrame();
+	}
+}
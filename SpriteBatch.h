@@ -0,0 +1,181 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include "exa.h"
+#include "RadixSorter.h"
+#include "RenderCommandBuffer.h"
+#include "VertexLayout.h"
+
+namespace exa
+{
+	class Shader;
+	class StreamBuffer;
+	class VertexArray;
+	class VertexBuffer;
+
+	EXA_VERTEX_ATTRIBUTE(SpriteCornerAttribute, "spriteCorner")
+	EXA_VERTEX_ATTRIBUTE(SpritePositionAttribute, "spritePosition")
+	EXA_VERTEX_ATTRIBUTE(SpriteSizeAttribute, "spriteSize")
+	EXA_VERTEX_ATTRIBUTE(SpriteRotationAttribute, "spriteRotation")
+	EXA_VERTEX_ATTRIBUTE(SpriteUvRectAttribute, "spriteUvRect")
+	EXA_VERTEX_ATTRIBUTE(SpriteTintAttribute, "spriteTint")
+
+	struct Sprite
+	{
+		// Center of sprite
+		glm::vec2 position = glm::vec2(0.0f);
+		glm::vec2 size = glm::vec2(1.0f);
+		// Radians, around center
+		float rotation = 0.0f;
+		// Offset and size in texture
+		glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		// 8 bit RGBA, see packColor
+		uint32 tint = 0xFFFFFFFF;
+		// Higher layers are drawn later
+		int16 layer = 0;
+		GLuint texture = 0;
+		// nullptr means default shader of batch
+		Shader* shader = nullptr;
+	};
+
+	// Per-instance data of sprite, 32 bytes instead of 4 vertices
+	struct SpriteInstance
+	{
+		float Position[2];
+		float Size[2];
+		float Rotation;
+		uint16 UvRect[4];
+		uint32 Tint;
+	};
+
+	using SpriteInstanceLayout = InstanceLayout<
+		VertexAttribute<SpritePositionAttribute, float2>,
+		VertexAttribute<SpriteSizeAttribute, float2>,
+		VertexAttribute<SpriteRotationAttribute, float1>,
+		VertexAttribute<SpriteUvRectAttribute, unorm16x4>,
+		VertexAttribute<SpriteTintAttribute, unorm8x4>>;
+
+	static_assert(sizeof(SpriteInstance) == SpriteInstanceLayout::stride(), "Sprite instance doesn't match its layout");
+
+	// Corner of unit quad in [-0.5; 0.5], same for all sprites
+	using SpriteCornerLayout = VertexLayout<VertexAttribute<SpriteCornerAttribute, float2>>;
+
+	struct SpriteBatchStats
+	{
+		uint32 sprites = 0;
+		// Draw calls
+		uint32 batches = 0;
+		// Batches ended by change of texture or shader
+		uint32 textureBreaks = 0;
+		uint32 shaderBreaks = 0;
+		// Sprites over maxSprites limit
+		uint32 dropped = 0;
+	};
+
+	// Collects sprites of frame, sorts them by layer, shader and texture with radix sort and draws every
+	// run of equal shader and texture with one instanced call. Sprites are recorded on any single thread,
+	// sorted instances are written straight into command buffer and uploaded to stream buffer on replay.
+	//
+	// Shaders use explicit locations:
+	// layout(location = 0) in vec2 spriteCorner;
+	// layout(location = 1) in vec2 spritePosition; ... layout(location = 5) in vec4 spriteTint;
+	// uniform mat4 viewProjection; uniform sampler2D spriteTexture;
+	//
+	// Stream buffer region of frame is fenced by endFrameCallback, record it once per frame after last end:
+	// commands.callback(&SpriteBatch::endFrameCallback, &sprites);
+	//
+	// @note Order of sprites is kept within layer only for equal shader and texture
+	class SpriteBatch
+	{
+	public:
+		static const char* const VIEW_PROJECTION_UNIFORM;
+		static const char* const TEXTURE_UNIFORM;
+
+		// @param maxSprites Limit per frame, sets stream buffer size
+		// @note Must be created on thread owning OpenGL context
+		SpriteBatch(Shader* defaultShader, uint32 maxSprites);
+		~SpriteBatch();
+
+		void begin(const glm::mat4& viewProjection);
+
+		void draw(const Sprite& sprite);
+
+		// Sorts sprites and records their draws, may be called several times per frame
+		void end(RenderCommandBuffer& commands);
+
+		// Fences instances submitted in frame, called on render thread
+		static void endFrameCallback(void* userData, const FrameSnapshot& snapshot);
+
+		// Of last end
+		const SpriteBatchStats& getStats() const {
+			return m_stats;
+		}
+
+		static uint32 packColor(const glm::vec4& color);
+
+	private:
+		// Run of sorted instances drawn with one call
+		struct Range
+		{
+			Shader* shader;
+			GLuint texture;
+			uint32 first;
+			uint32 count;
+		};
+
+		// Start of data recorded into command buffer, followed by ranges and instances
+		struct FrameHeader
+		{
+			glm::mat4 viewProjection;
+			uint32 instanceCount;
+			uint32 rangeCount;
+		};
+
+		uint32 getShaderIndex(Shader* shader);
+		uint32 getTextureIndex(GLuint texture);
+
+		void submit(const unsigned char* data, const FrameSnapshot& snapshot);
+
+		void endFrame();
+
+		static void submitCallback(void* userData, const void* data, size_t size, const FrameSnapshot& snapshot);
+
+		Shader* m_defaultShader = nullptr;
+		uint32 m_maxSprites = 0;
+
+		// Recording side
+		glm::mat4 m_viewProjection;
+
+		std::vector<SpriteInstance> m_instances;
+
+		// Layer, shader and texture index, sorted together with index of instance
+		std::vector<uint64> m_keys;
+		std::vector<uint32> m_order;
+
+		RadixSorter m_sorter;
+
+		// Shaders and textures of frame in order of first use, last used is checked first
+		std::vector<Shader*> m_shaders;
+		std::vector<GLuint> m_textures;
+		uint32 m_lastShader = 0;
+		uint32 m_lastTexture = 0;
+
+		std::vector<Range> m_ranges;
+
+		SpriteBatchStats m_stats;
+
+		// Render side
+		VertexArray* m_vertexArray = nullptr;
+		VertexBuffer* m_corners = nullptr;
+		StreamBuffer* m_stream = nullptr;
+
+		// Stream buffer moves to next region once per frame, even if batch is submitted several times
+		uint64 m_streamFrame = ~static_cast<uint64>(0);
+		// Region of m_streamFrame was fenced by endFrame
+		bool m_streamFenced = true;
+	};
+}
@@ -0,0 +1,242 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Log.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		// Uploads go through copy write target, binding element array buffer would change bound vertex array
+		const GLenum UPLOAD_TARGET = GL_COPY_WRITE_BUFFER;
+
+		// Nanoseconds, wait is repeated after timeout
+		const GLuint64 FENCE_TIMEOUT = 1000000000;
+
+		size_t alignUp(size_t value, size_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	StreamBuffer::StreamBuffer(GLenum target, size_t regionSize, StreamBufferMode preferredMode)
+		: m_target(target)
+		, m_mode(preferredMode)
+		, m_regionSize(regionSize)
+	{
+		if (m_mode == StreamBufferMode::EXA_PERSISTENT && !GLAD_GL_ARB_buffer_storage) {
+			m_mode = StreamBufferMode::EXA_UNSYNCHRONIZED;
+		}
+
+		if (m_target == GL_UNIFORM_BUFFER || m_target == GL_SHADER_STORAGE_BUFFER) {
+			GLint alignment = 0;
+			exaglGetIntegerv(m_target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT : GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+			m_minAlignment = static_cast<size_t>(std::max(alignment, 1));
+			m_regionSize = alignUp(m_regionSize, m_minAlignment);
+		}
+
+		exaglGenBuffers(1, &m_buffer);
+		exaglBindBuffer(UPLOAD_TARGET, m_buffer);
+
+		const GLsizeiptr totalSize = static_cast<GLsizeiptr>(m_regionSize * NUM_REGIONS);
+
+		switch (m_mode) {
+			case StreamBufferMode::EXA_PERSISTENT: {
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				exaglBufferStorage(UPLOAD_TARGET, totalSize, nullptr, flags);
+				m_mapped = static_cast<unsigned char*>(exaglMapBufferRange(UPLOAD_TARGET, 0, totalSize, flags));
+				if (m_mapped != nullptr) {
+					break;
+				}
+
+				// Immutable storage can't be reallocated, start with new buffer
+				log::warning("Persistent mapping failed, falling back to unsynchronized mapping");
+				exaglDeleteBuffers(1, &m_buffer);
+				exaglGenBuffers(1, &m_buffer);
+				exaglBindBuffer(UPLOAD_TARGET, m_buffer);
+				m_mode = StreamBufferMode::EXA_UNSYNCHRONIZED;
+				exaglBufferData(UPLOAD_TARGET, totalSize, nullptr, GL_STREAM_DRAW);
+				break;
+			}
+			case StreamBufferMode::EXA_UNSYNCHRONIZED:
+				exaglBufferData(UPLOAD_TARGET, totalSize, nullptr, GL_STREAM_DRAW);
+				break;
+			default:
+				// Storage is orphaned every frame, single region is enough
+				exaglBufferData(UPLOAD_TARGET, static_cast<GLsizeiptr>(m_regionSize), nullptr, GL_STREAM_DRAW);
+				break;
+		}
+
+		// Start with last region so that first beginFrame moves to region 0
+		m_region = NUM_REGIONS - 1;
+	}
+
+	StreamBuffer::~StreamBuffer()
+	{
+		for (auto& fence : m_fences) {
+			if (fence != nullptr) {
+				exaglDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
+
+		if (m_mapped != nullptr) {
+			exaglBindBuffer(UPLOAD_TARGET, m_buffer);
+			exaglUnmapBuffer(UPLOAD_TARGET);
+			m_mapped = nullptr;
+		}
+
+		exaglDeleteBuffers(1, &m_buffer);
+	}
+
+	void StreamBuffer::waitForRegion(uint32 region)
+	{
+		GLsync& fence = m_fences[region];
+		if (fence == nullptr) {
+			return;
+		}
+
+		// Usually signaled long ago, flag is needed only if fence wasn't submitted yet
+		GLenum result = exaglClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			EXA_PROFILE_SCOPE("StreamBuffer wait");
+			m_stalls++;
+			do {
+				result = exaglClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+
+		if (result == GL_WAIT_FAILED) {
+			log::error("Waiting for stream buffer fence failed");
+		}
+
+		exaglDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	void StreamBuffer::beginFrame()
+	{
+		m_regionUsed = 0;
+
+		if (m_mode == StreamBufferMode::EXA_ORPHAN) {
+			exaglBindBuffer(UPLOAD_TARGET, m_buffer);
+			exaglBufferData(UPLOAD_TARGET, static_cast<GLsizeiptr>(m_regionSize), nullptr, GL_STREAM_DRAW);
+			m_region = 0;
+			return;
+		}
+
+		m_region = (m_region + 1) % NUM_REGIONS;
+		waitForRegion(m_region);
+	}
+
+	void StreamBuffer::endFrame()
+	{
+		if (m_mode == StreamBufferMode::EXA_ORPHAN) {
+			return;
+		}
+
+		if (m_fences[m_region] != nullptr) {
+			exaglDeleteSync(m_fences[m_region]);
+		}
+		m_fences[m_region] = exaglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	size_t StreamBuffer::reserve(size_t size, size_t alignment)
+	{
+		alignment = std::max(alignment, m_minAlignment);
+
+		const size_t regionStart = m_region * m_regionSize;
+		const size_t offset = alignUp(regionStart + m_regionUsed, alignment);
+		if (offset + size > regionStart + m_regionSize) {
+			log::warning("Stream buffer region of %u bytes is full", static_cast<unsigned int>(m_regionSize));
+			return INVALID_OFFSET;
+		}
+
+		m_regionUsed = offset + size - regionStart;
+		return offset;
+	}
+
+	void* StreamBuffer::map(size_t size, size_t alignment, size_t& offset)
+	{
+		offset = reserve(size, alignment);
+		if (offset == INVALID_OFFSET) {
+			return nullptr;
+		}
+
+		switch (m_mode) {
+			case StreamBufferMode::EXA_PERSISTENT:
+				return m_mapped + offset;
+			case StreamBufferMode::EXA_UNSYNCHRONIZED:
+				// Region is protected by fence, driver must not synchronize
+				exaglBindBuffer(UPLOAD_TARGET, m_buffer);
+				m_mapPointer = exaglMapBufferRange(UPLOAD_TARGET, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size),
+					GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+				break;
+			default:
+				m_staging.resize(size);
+				m_mapPointer = m_staging.data();
+				break;
+		}
+
+		m_mapOffset = offset;
+		m_mapSize = size;
+		return m_mapPointer;
+	}
+
+	void StreamBuffer::unmap()
+	{
+		if (m_mapPointer == nullptr) {
+			return;
+		}
+
+		exaglBindBuffer(UPLOAD_TARGET, m_buffer);
+		if (m_mode == StreamBufferMode::EXA_UNSYNCHRONIZED) {
+			exaglUnmapBuffer(UPLOAD_TARGET);
+		}
+		else {
+			exaglBufferSubData(UPLOAD_TARGET, static_cast<GLintptr>(m_mapOffset), static_cast<GLsizeiptr>(m_mapSize), m_mapPointer);
+		}
+
+		m_mapPointer = nullptr;
+	}
+
+	size_t StreamBuffer::write(const void* data, size_t size, size_t alignment)
+	{
+		if (m_mode == StreamBufferMode::EXA_ORPHAN) {
+			// No staging copy needed
+			const size_t offset = reserve(size, alignment);
+			if (offset != INVALID_OFFSET) {
+				exaglBindBuffer(UPLOAD_TARGET, m_buffer);
+				exaglBufferSubData(UPLOAD_TARGET, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+			}
+			return offset;
+		}
+
+		size_t offset = INVALID_OFFSET;
+		void* destination = map(size, alignment, offset);
+		if (destination == nullptr) {
+			return INVALID_OFFSET;
+		}
+
+		memcpy(destination, data, size);
+		unmap();
+
+		return offset;
+	}
+
+	void StreamBuffer::bind()
+	{
+		exaglBindBuffer(m_target, m_buffer);
+	}
+
+	void StreamBuffer::bindRange(GLuint index, size_t offset, size_t size)
+	{
+		exaglBindBufferRange(m_target, index, m_buffer, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size));
+	}
+}
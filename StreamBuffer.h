@@ -0,0 +1,123 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "exa.h"
+#include "RenderPlatforms.h"
+
+namespace exa
+{
+	// How stream buffer memory is updated, picked by what driver supports
+	enum class StreamBufferMode : std::int8_t
+	{
+		// glBufferStorage with persistent coherent mapping, writes are plain memcpy (ARB_buffer_storage)
+		EXA_PERSISTENT,
+		// glMapBufferRange with GL_MAP_UNSYNCHRONIZED_BIT per write, fences protect regions in use
+		EXA_UNSYNCHRONIZED,
+		// glBufferData(nullptr) orphans storage every frame, then glBufferSubData
+		EXA_ORPHAN,
+		EXA_TOTAL_ITEMS
+	};
+
+	// Ring of NUM_REGIONS per-frame regions for data rewritten every frame (dynamic vertices, uniforms).
+	// Region is fenced when frame ends and reused NUM_REGIONS frames later, waiting only if GPU is that
+	// far behind, so CPU never stalls on buffer still read by GPU.
+	//
+	// stream.beginFrame();
+	// size_t offset = stream.write(vertices, size);
+	// ... draw with offset ...
+	// stream.endFrame();
+	//
+	// @note Must be used on thread owning OpenGL context
+	class StreamBuffer
+	{
+	public:
+		static const uint32 NUM_REGIONS = 3;
+
+		// Returned by write when region is full
+		static const size_t INVALID_OFFSET = ~static_cast<size_t>(0);
+
+		// @param regionSize Bytes available per frame
+		// @param preferredMode Fastest mode supported by driver not faster than this one is used
+		StreamBuffer(GLenum target, size_t regionSize, StreamBufferMode preferredMode = StreamBufferMode::EXA_PERSISTENT);
+		~StreamBuffer();
+
+		// Moves to next region, waits for its fence if GPU still reads it
+		void beginFrame();
+
+		// Fences current region
+		void endFrame();
+
+		// Copies data to current region, returns byte offset in buffer or INVALID_OFFSET if region is full.
+		// Alignment is raised to offset alignment required for uniform and shader storage buffers.
+		size_t write(const void* data, size_t size, size_t alignment = 4);
+
+		// Space for writing in place, pointer is valid until unmap. Returns nullptr if region is full
+		void* map(size_t size, size_t alignment, size_t& offset);
+
+		// Ends write started by map
+		void unmap();
+
+		void bind();
+
+		// glBindBufferRange of data written at offset, for uniform blocks
+		void bindRange(GLuint index, size_t offset, size_t size);
+
+		GLuint getBuffer() const {
+			return m_buffer;
+		}
+
+		StreamBufferMode getMode() const {
+			return m_mode;
+		}
+
+		size_t getRegionSize() const {
+			return m_regionSize;
+		}
+
+		// Bytes written to current region
+		size_t getUsed() const {
+			return m_regionUsed;
+		}
+
+		// Frames in which beginFrame had to wait for GPU
+		uint64 getStalls() const {
+			return m_stalls;
+		}
+
+	private:
+		// Reserves aligned space in current region, returns offset in buffer
+		size_t reserve(size_t size, size_t alignment);
+
+		void waitForRegion(uint32 region);
+
+		GLenum m_target = GL_ARRAY_BUFFER;
+		GLuint m_buffer = 0;
+		StreamBufferMode m_mode = StreamBufferMode::EXA_PERSISTENT;
+
+		size_t m_regionSize = 0;
+		size_t m_minAlignment = 1;
+
+		uint32 m_region = 0;
+		size_t m_regionUsed = 0;
+
+		// Persistent mapping of whole buffer
+		unsigned char* m_mapped = nullptr;
+
+		// Range opened by map in other modes
+		size_t m_mapOffset = 0;
+		size_t m_mapSize = 0;
+		void* m_mapPointer = nullptr;
+
+		// Data of map in orphan mode, uploaded by unmap
+		std::vector<unsigned char> m_staging;
+
+		GLsync m_fences[NUM_REGIONS] = {};
+
+		uint64 m_stalls = 0;
+	};
+}
@@ -0,0 +1,354 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace exa
+{
+	namespace
+	{
+		const uint32 INVALID_INDEX = 0xFFFFFFFF;
+		const uint32 NO_PARENT = 0xFFFFFFFF;
+
+		template <typename T>
+		void permute(std::vector<T>& values, const std::vector<uint32>& order)
+		{
+			std::vector<T> permuted(order.size());
+			for (size_t i = 0; i < order.size(); i++) {
+				permuted[i] = values[order[i]];
+			}
+			values.swap(permuted);
+		}
+
+		// Translation * rotation * scale, columns of rotation scaled
+		inline void composeLocal(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, glm::mat4& local)
+		{
+			const glm::mat3 basis = glm::mat3_cast(rotation);
+			local[0] = glm::vec4(basis[0] * scale.x, 0.0f);
+			local[1] = glm::vec4(basis[1] * scale.y, 0.0f);
+			local[2] = glm::vec4(basis[2] * scale.z, 0.0f);
+			local[3] = glm::vec4(position, 1.0f);
+		}
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+		// world = parent * local, local has (0, 0, 0, 1) last row. Matrices aren't 16 byte aligned in vectors
+		inline void multiplyAffine(const glm::mat4& parent, const glm::mat4& local, glm::mat4& world)
+		{
+			const __m128 parent0 = _mm_loadu_ps(&parent[0][0]);
+			const __m128 parent1 = _mm_loadu_ps(&parent[1][0]);
+			const __m128 parent2 = _mm_loadu_ps(&parent[2][0]);
+			const __m128 parent3 = _mm_loadu_ps(&parent[3][0]);
+
+			for (int column = 0; column < 3; column++) {
+				const glm::vec4& l = local[column];
+				const __m128 result = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(parent0, _mm_set1_ps(l.x)), _mm_mul_ps(parent1, _mm_set1_ps(l.y))),
+					_mm_mul_ps(parent2, _mm_set1_ps(l.z)));
+				_mm_storeu_ps(&world[column][0], result);
+			}
+
+			const glm::vec4& t = local[3];
+			const __m128 translation = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(parent0, _mm_set1_ps(t.x)), _mm_mul_ps(parent1, _mm_set1_ps(t.y))),
+				_mm_add_ps(_mm_mul_ps(parent2, _mm_set1_ps(t.z)), parent3));
+			_mm_storeu_ps(&world[3][0], translation);
+		}
+
+#else
+
+		inline void multiplyAffine(const glm::mat4& parent, const glm::mat4& local, glm::mat4& world)
+		{
+			world = parent * local;
+		}
+
+#endif
+	}
+
+	TransformSystem::TransformSystem()
+	{
+		m_levels.push_back(0);
+	}
+
+	void TransformSystem::reserve(uint32 count)
+	{
+		m_parents.reserve(count);
+		m_positions.reserve(count);
+		m_rotations.reserve(count);
+		m_scales.reserve(count);
+		m_worlds.reserve(count);
+		m_dirty.reserve(count);
+		m_indexToHandle.reserve(count);
+		m_handleToIndex.reserve(count);
+	}
+
+	bool TransformSystem::isValid(Handle handle) const
+	{
+		return handle < m_handleToIndex.size() && m_handleToIndex[handle] != INVALID_INDEX;
+	}
+
+	TransformSystem::Handle TransformSystem::create(Handle parent)
+	{
+		if (parent != INVALID_HANDLE && !isValid(parent)) {
+			log::error("Creating transform with invalid parent %u", parent);
+			return INVALID_HANDLE;
+		}
+
+		Handle handle = INVALID_HANDLE;
+		if (!m_freeHandles.empty()) {
+			handle = m_freeHandles.back();
+			m_freeHandles.pop_back();
+		}
+		else {
+			handle = static_cast<Handle>(m_handleToIndex.size());
+			m_handleToIndex.push_back(INVALID_INDEX);
+		}
+
+		const uint32 index = m_count++;
+		m_handleToIndex[handle] = index;
+
+		m_parents.push_back(parent != INVALID_HANDLE ? m_handleToIndex[parent] : NO_PARENT);
+		m_positions.push_back(glm::vec3(0.0f));
+		m_rotations.push_back(glm::quat());
+		m_scales.push_back(glm::vec3(1.0f));
+		m_worlds.push_back(glm::mat4(1.0f));
+		m_dirty.push_back(1);
+		m_indexToHandle.push_back(handle);
+
+		// Appended node may be at any depth
+		m_orderDirty = true;
+		return handle;
+	}
+
+	void TransformSystem::destroy(Handle handle)
+	{
+		if (!isValid(handle)) {
+			log::warning("Destroying invalid transform %u", handle);
+			return;
+		}
+
+		// Node stays in arrays until reorder, which drops it with its descendants
+		m_indexToHandle[m_handleToIndex[handle]] = INVALID_HANDLE;
+		m_handleToIndex[handle] = INVALID_INDEX;
+		m_freeHandles.push_back(handle);
+		m_orderDirty = true;
+	}
+
+	bool TransformSystem::setParent(Handle handle, Handle parent)
+	{
+		if (!isValid(handle) || (parent != INVALID_HANDLE && !isValid(parent))) {
+			log::error("Setting parent %u of invalid transform %u", parent, handle);
+			return false;
+		}
+
+		const uint32 index = m_handleToIndex[handle];
+		const uint32 parentIndex = parent != INVALID_HANDLE ? m_handleToIndex[parent] : NO_PARENT;
+
+		for (uint32 ancestor = parentIndex; ancestor != NO_PARENT; ancestor = m_parents[ancestor]) {
+			if (ancestor == index) {
+				log::error("Transform %u can't be parented to its descendant %u", handle, parent);
+				return false;
+			}
+		}
+
+		m_parents[index] = parentIndex;
+		m_dirty[index] = 1;
+		m_orderDirty = true;
+		return true;
+	}
+
+	TransformSystem::Handle TransformSystem::getParent(Handle handle) const
+	{
+		const uint32 parent = m_parents[m_handleToIndex[handle]];
+		if (parent == NO_PARENT) {
+			return INVALID_HANDLE;
+		}
+		return m_indexToHandle[parent];
+	}
+
+	void TransformSystem::markDirty(Handle handle)
+	{
+		m_dirty[m_handleToIndex[handle]] = 1;
+	}
+
+	void TransformSystem::setPosition(Handle handle, const glm::vec3& position)
+	{
+		m_positions[m_handleToIndex[handle]] = position;
+		markDirty(handle);
+	}
+
+	void TransformSystem::setRotation(Handle handle, const glm::quat& rotation)
+	{
+		m_rotations[m_handleToIndex[handle]] = rotation;
+		markDirty(handle);
+	}
+
+	void TransformSystem::setScale(Handle handle, const glm::vec3& scale)
+	{
+		m_scales[m_handleToIndex[handle]] = scale;
+		markDirty(handle);
+	}
+
+	void TransformSystem::setLocal(Handle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+	{
+		const uint32 index = m_handleToIndex[handle];
+		m_positions[index] = position;
+		m_rotations[index] = rotation;
+		m_scales[index] = scale;
+		m_dirty[index] = 1;
+	}
+
+	void TransformSystem::reorder()
+	{
+		EXA_PROFILE_FUNCTION();
+
+		// Children of every node in index order
+		m_childOffsets.assign(m_count + 1, 0);
+		for (uint32 i = 0; i < m_count; i++) {
+			if (m_parents[i] != NO_PARENT) {
+				m_childOffsets[m_parents[i] + 1]++;
+			}
+		}
+		for (uint32 i = 0; i < m_count; i++) {
+			m_childOffsets[i + 1] += m_childOffsets[i];
+		}
+
+		m_children.resize(m_childOffsets[m_count]);
+		m_newIndices.assign(m_childOffsets.begin(), m_childOffsets.end() - 1);
+		for (uint32 i = 0; i < m_count; i++) {
+			if (m_parents[i] != NO_PARENT) {
+				m_children[m_newIndices[m_parents[i]]++] = i;
+			}
+		}
+
+		// Breadth-first walk from roots keeps siblings together and levels ordered by parent,
+		// destroyed nodes are not entered so their subtrees are dropped
+		m_order.clear();
+		for (uint32 i = 0; i < m_count; i++) {
+			if (m_parents[i] == NO_PARENT && m_indexToHandle[i] != INVALID_HANDLE) {
+				m_order.push_back(i);
+			}
+		}
+
+		m_levels.clear();
+		m_levels.push_back(0);
+
+		uint32 levelEnd = static_cast<uint32>(m_order.size());
+		for (uint32 head = 0; head < m_order.size(); head++) {
+			if (head == levelEnd) {
+				m_levels.push_back(levelEnd);
+				levelEnd = static_cast<uint32>(m_order.size());
+			}
+
+			const uint32 node = m_order[head];
+			for (uint32 child = m_childOffsets[node]; child < m_childOffsets[node + 1]; child++) {
+				if (m_indexToHandle[m_children[child]] != INVALID_HANDLE) {
+					m_order.push_back(m_children[child]);
+				}
+			}
+		}
+
+		const uint32 count = static_cast<uint32>(m_order.size());
+		if (count > 0) {
+			m_levels.push_back(count);
+		}
+
+		m_newIndices.assign(m_count, INVALID_INDEX);
+		for (uint32 i = 0; i < count; i++) {
+			m_newIndices[m_order[i]] = i;
+		}
+
+		// Descendants of destroyed nodes still own their handles
+		for (uint32 i = 0; i < m_count; i++) {
+			const Handle handle = m_indexToHandle[i];
+			if (m_newIndices[i] == INVALID_INDEX && handle != INVALID_HANDLE) {
+				m_handleToIndex[handle] = INVALID_INDEX;
+				m_freeHandles.push_back(handle);
+			}
+		}
+
+		permute(m_parents, m_order);
+		permute(m_positions, m_order);
+		permute(m_rotations, m_order);
+		permute(m_scales, m_order);
+		permute(m_worlds, m_order);
+		permute(m_dirty, m_order);
+		permute(m_indexToHandle, m_order);
+
+		m_count = count;
+
+		for (uint32 i = 0; i < count; i++) {
+			if (m_parents[i] != NO_PARENT) {
+				m_parents[i] = m_newIndices[m_parents[i]];
+			}
+			m_handleToIndex[m_indexToHandle[i]] = i;
+		}
+	}
+
+	uint32 TransformSystem::updateRange(uint32 begin, uint32 end)
+	{
+		uint32 updated = 0;
+		glm::mat4 local;
+
+		for (uint32 i = begin; i < end; i++) {
+			const uint32 parent = m_parents[i];
+
+			// Parent is on previous level, its flag is final
+			if (!m_dirty[i] && (parent == NO_PARENT || !m_dirty[parent])) {
+				continue;
+			}
+
+			m_dirty[i] = 1;
+			composeLocal(m_positions[i], m_rotations[i], m_scales[i], local);
+
+			if (parent == NO_PARENT) {
+				m_worlds[i] = local;
+			}
+			else {
+				multiplyAffine(m_worlds[parent], local, m_worlds[i]);
+			}
+
+			updated++;
+		}
+
+		return updated;
+	}
+
+	void TransformSystem::update(JobSystem* jobSystem)
+	{
+		EXA_PROFILE_FUNCTION();
+
+		if (m_orderDirty) {
+			reorder();
+			m_orderDirty = false;
+		}
+
+		const bool parallel = jobSystem != nullptr && jobSystem->getNumThreads() > 1;
+
+		m_updatedCount = 0;
+		for (uint32 level = 0; level + 1 < m_levels.size(); level++) {
+			const uint32 begin = m_levels[level];
+			const uint32 end = m_levels[level + 1];
+
+			if (!parallel || end - begin <= CHUNK_SIZE) {
+				m_updatedCount += updateRange(begin, end);
+				continue;
+			}
+
+			// Level is barrier, parallelFor returns after all its nodes are done
+			std::atomic<uint32> updated(0);
+			jobSystem->parallelFor(end - begin, CHUNK_SIZE, [this, begin, &updated](uint32 first, uint32 last) {
+				updated.fetch_add(updateRange(begin + first, begin + last), std::memory_order_relaxed);
+			});
+			m_updatedCount += updated.load();
+		}
+
+		std::fill(m_dirty.begin(), m_dirty.end(), static_cast<uint8>(0));
+	}
+}
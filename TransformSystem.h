@@ -0,0 +1,127 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "exa.h"
+
+namespace exa
+{
+	class JobSystem;
+
+	// Transform hierarchy stored as structure of arrays (positions, rotations, scales, world matrices)
+	// in breadth-first order: nodes are grouped by depth, so parents always precede their children.
+	// update walks levels in order and computes world matrices of every level in parallel, reading only
+	// parents of previous level. Only nodes changed since last update and their descendants are recomputed.
+	//
+	// Nodes are addressed by stable handles, changes of hierarchy (create, destroy, setParent) reorder
+	// arrays once at next update.
+	class TransformSystem
+	{
+	public:
+		using Handle = uint32;
+
+		static const Handle INVALID_HANDLE = 0xFFFFFFFF;
+
+		// Nodes per parallel job, also smallest level updated in parallel
+		static const uint32 CHUNK_SIZE = 2048;
+
+		TransformSystem();
+
+		void reserve(uint32 count);
+
+		// New node with identity local transform
+		Handle create(Handle parent = INVALID_HANDLE);
+
+		// Destroys node with its whole subtree, descendant handles become invalid
+		void destroy(Handle handle);
+
+		bool isValid(Handle handle) const;
+
+		// @return False if parent is descendant of node
+		bool setParent(Handle handle, Handle parent);
+
+		Handle getParent(Handle handle) const;
+
+		void setPosition(Handle handle, const glm::vec3& position);
+		void setRotation(Handle handle, const glm::quat& rotation);
+		void setScale(Handle handle, const glm::vec3& scale);
+		void setLocal(Handle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+		const glm::vec3& getPosition(Handle handle) const {
+			return m_positions[m_handleToIndex[handle]];
+		}
+
+		const glm::quat& getRotation(Handle handle) const {
+			return m_rotations[m_handleToIndex[handle]];
+		}
+
+		const glm::vec3& getScale(Handle handle) const {
+			return m_scales[m_handleToIndex[handle]];
+		}
+
+		// As of last update
+		const glm::mat4& getWorld(Handle handle) const {
+			return m_worlds[m_handleToIndex[handle]];
+		}
+
+		// Recomputes world matrices of changed nodes and their descendants
+		// @param jobSystem nullptr updates on calling thread only
+		void update(JobSystem* jobSystem = nullptr);
+
+		uint32 getCount() const {
+			return m_count;
+		}
+
+		// Depth of deepest node plus one, as of last update
+		uint32 getLevelCount() const {
+			return m_levels.empty() ? 0 : static_cast<uint32>(m_levels.size() - 1);
+		}
+
+		// World matrices recomputed by last update
+		uint32 getUpdatedCount() const {
+			return m_updatedCount;
+		}
+
+	private:
+		void markDirty(Handle handle);
+
+		// Restores breadth-first order, drops destroyed nodes
+		void reorder();
+
+		uint32 updateRange(uint32 begin, uint32 end);
+
+		// Per node, indexed in breadth-first order
+		std::vector<uint32> m_parents;
+		std::vector<glm::vec3> m_positions;
+		std::vector<glm::quat> m_rotations;
+		std::vector<glm::vec3> m_scales;
+		std::vector<glm::mat4> m_worlds;
+		// Set by changes, propagated to children during update, cleared after it
+		std::vector<uint8> m_dirty;
+		std::vector<Handle> m_indexToHandle;
+
+		uint32 m_count = 0;
+
+		std::vector<uint32> m_handleToIndex;
+		std::vector<Handle> m_freeHandles;
+
+		// Index of first node of every level, last entry is node count
+		std::vector<uint32> m_levels;
+
+		// Hierarchy changed since last reorder
+		bool m_orderDirty = false;
+
+		uint32 m_updatedCount = 0;
+
+		// Scratch of reorder: children of every node, breadth-first order of old indices and its inverse
+		std::vector<uint32> m_childOffsets;
+		std::vector<uint32> m_children;
+		std::vector<uint32> m_order;
+		std::vector<uint32> m_newIndices;
+	};
+}
@@ -4,6 +4,8 @@
 #pragma once
 
 #include "RenderPlatforms.h"
+#include "VertexBuffer.h"
+#include "VertexLayout.h"
 
 namespace exa
 {
@@ -20,6 +22,27 @@ namespace exa
 
 		void unbind();
 
+		// Binds array and buffer and sets up all attributes of Layout used by program in one call
+		template <class Layout>
+		void setLayout(VertexBuffer& buffer, const ShaderReflection& reflection)
+		{
+			bind();
+			buffer.bind();
+			Layout::apply(reflection);
+		}
+
+		// Adds per-instance attributes of InstanceLayout read from InstanceBuffer, or from StreamBuffer
+		// at offset returned by write, in addition to vertex layout
+		template <class Layout, class Buffer>
+		void setInstanceLayout(Buffer& buffer, const ShaderReflection& reflection, size_t baseOffset = 0)
+		{
+			static_assert(Layout::DIVISOR > 0, "Instance layout expected, use InstanceLayout");
+
+			bind();
+			buffer.bind();
+			Layout::apply(reflection, baseOffset);
+		}
+
 	private:
 		GLuint m_VAO = 0;
 	};
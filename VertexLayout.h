@@ -0,0 +1,194 @@
+// This file is part of the "UGFX".
+// For conditions of distribution and use, see copyright notice in LICENSE.txt
+
+#pragma once
+
+#include <cstddef>
+
+#include "RenderPlatforms.h"
+#include "ShaderReflection.h"
+#include "Log.h"
+
+namespace exa
+{
+	// Format of one vertex attribute in buffer
+	// @param Integer Attribute is read by glVertexAttribIPointer as ivec/uvec, otherwise converted to float
+	// @param Locations Matrices take one location per column, every column has Components and Size / Locations bytes
+	template <GLenum Type, GLint Components, GLboolean Normalized, bool Integer, size_t Size, GLuint Locations = 1>
+	struct VertexFormat
+	{
+		static constexpr GLenum TYPE = Type;
+		static constexpr GLint COMPONENTS = Components;
+		static constexpr GLboolean NORMALIZED = Normalized;
+		static constexpr bool INTEGER = Integer;
+		static constexpr size_t SIZE = Size;
+		static constexpr GLuint LOCATIONS = Locations;
+	};
+
+	using float1 = VertexFormat<GL_FLOAT, 1, GL_FALSE, false, 4>;
+	using float2 = VertexFormat<GL_FLOAT, 2, GL_FALSE, false, 8>;
+	using float3 = VertexFormat<GL_FLOAT, 3, GL_FALSE, false, 12>;
+	using float4 = VertexFormat<GL_FLOAT, 4, GL_FALSE, false, 16>;
+
+	// Column major glm::mat4 and glm::mat4x3 (affine transform, last row omitted)
+	using float4x4 = VertexFormat<GL_FLOAT, 4, GL_FALSE, false, 64, 4>;
+	using float4x3 = VertexFormat<GL_FLOAT, 3, GL_FALSE, false, 48, 4>;
+
+	// Packed with glm::packHalf, half3 is padded to 8 bytes by layout
+	using half2 = VertexFormat<GL_HALF_FLOAT, 2, GL_FALSE, false, 4>;
+	using half3 = VertexFormat<GL_HALF_FLOAT, 3, GL_FALSE, false, 6>;
+	using half4 = VertexFormat<GL_HALF_FLOAT, 4, GL_FALSE, false, 8>;
+
+	// Read by shader as float in [0;1] or [-1;1], packed with glm::packUnorm/packSnorm
+	using unorm8x4 = VertexFormat<GL_UNSIGNED_BYTE, 4, GL_TRUE, false, 4>;
+	using snorm8x4 = VertexFormat<GL_BYTE, 4, GL_TRUE, false, 4>;
+	using unorm16x2 = VertexFormat<GL_UNSIGNED_SHORT, 2, GL_TRUE, false, 4>;
+	using unorm16x4 = VertexFormat<GL_UNSIGNED_SHORT, 4, GL_TRUE, false, 8>;
+	using snorm16x2 = VertexFormat<GL_SHORT, 2, GL_TRUE, false, 4>;
+	using snorm16x4 = VertexFormat<GL_SHORT, 4, GL_TRUE, false, 8>;
+
+	// xyz 10 bits, w 2 bits, packed with glm::packSnorm3x10_1x2/packUnorm3x10_1x2
+	using snorm_2_10_10_10 = VertexFormat<GL_INT_2_10_10_10_REV, 4, GL_TRUE, false, 4>;
+	using unorm_2_10_10_10 = VertexFormat<GL_UNSIGNED_INT_2_10_10_10_REV, 4, GL_TRUE, false, 4>;
+
+	// Integer attributes (indices, bone ids, e.t.c.)
+	using uint8x4 = VertexFormat<GL_UNSIGNED_BYTE, 4, GL_FALSE, true, 4>;
+	using uint16x2 = VertexFormat<GL_UNSIGNED_SHORT, 2, GL_FALSE, true, 4>;
+	using uint16x4 = VertexFormat<GL_UNSIGNED_SHORT, 4, GL_FALSE, true, 8>;
+	using int16x2 = VertexFormat<GL_SHORT, 2, GL_FALSE, true, 4>;
+	using int16x4 = VertexFormat<GL_SHORT, 4, GL_FALSE, true, 8>;
+	using uint1 = VertexFormat<GL_UNSIGNED_INT, 1, GL_FALSE, true, 4>;
+	using uint2 = VertexFormat<GL_UNSIGNED_INT, 2, GL_FALSE, true, 8>;
+	using uint4 = VertexFormat<GL_UNSIGNED_INT, 4, GL_FALSE, true, 16>;
+	using int1 = VertexFormat<GL_INT, 1, GL_FALSE, true, 4>;
+	using int2 = VertexFormat<GL_INT, 2, GL_FALSE, true, 8>;
+	using int4 = VertexFormat<GL_INT, 4, GL_FALSE, true, 16>;
+
+	// Declares tag type naming attribute in GLSL, C++14 has no string template arguments
+	// EXA_VERTEX_ATTRIBUTE(PositionAttribute, "vPosition")
+#define EXA_VERTEX_ATTRIBUTE(Tag, glslName) \
+	struct Tag \
+	{ \
+		static constexpr const char* name() { return glslName; } \
+	};
+
+	template <class Name, class Format>
+	struct VertexAttribute
+	{
+		using format = Format;
+
+		static constexpr const char* name() {
+			return Name::name();
+		}
+	};
+
+	// Interleaved vertex with offsets and stride computed at compile time. Every attribute starts
+	// at 4 byte boundary as required for efficient fetch.
+	// Divisor 0 advances attributes per vertex, N advances them once per N instances (glVertexAttribDivisor).
+	//
+	// EXA_VERTEX_ATTRIBUTE(PositionAttribute, "vPosition")
+	// EXA_VERTEX_ATTRIBUTE(TexCoordAttribute, "texCoord")
+	// using QuadLayout = VertexLayout<VertexAttribute<PositionAttribute, half4>, VertexAttribute<TexCoordAttribute, unorm16x2>>;
+	// static_assert(sizeof(QuadVertex) == QuadLayout::stride(), "Vertex doesn't match layout");
+	template <GLuint Divisor, class... Attributes>
+	struct VertexStreamLayout
+	{
+		static_assert(sizeof...(Attributes) > 0, "Vertex layout needs at least one attribute");
+
+		static constexpr size_t COUNT = sizeof...(Attributes);
+
+		static constexpr GLuint DIVISOR = Divisor;
+
+		static constexpr size_t align(size_t size) {
+			return (size + 3) & ~static_cast<size_t>(3);
+		}
+
+		// Byte offset of attribute, offset(COUNT) is size of vertex
+		static constexpr size_t offset(size_t index) {
+			const size_t sizes[] = { Attributes::format::SIZE... };
+			size_t result = 0;
+			for (size_t i = 0; i < index && i < COUNT; i++) {
+				result += align(sizes[i]);
+			}
+			return result;
+		}
+
+		static constexpr GLsizei stride() {
+			return static_cast<GLsizei>(offset(COUNT));
+		}
+
+		// Location of attribute relative to first one, location(COUNT) is number of locations used
+		static constexpr GLuint location(size_t index) {
+			const GLuint locations[] = { Attributes::format::LOCATIONS... };
+			GLuint result = 0;
+			for (size_t i = 0; i < index && i < COUNT; i++) {
+				result += locations[i];
+			}
+			return result;
+		}
+
+		// Sets up every attribute used by program for buffer bound to GL_ARRAY_BUFFER, attributes
+		// removed by compiler are skipped.
+		// @note Vertex array must be bound
+		static void apply(const ShaderReflection& reflection, size_t baseOffset = 0)
+		{
+			size_t index = 0;
+			int expand[] = { (applyAttribute<Attributes>(reflection, offset(index++) + baseOffset), 0)... };
+			(void)expand;
+		}
+
+		// Attributes get locations in declaration order starting from firstLocation, for shaders
+		// with explicit layout(location = N)
+		static void applyLocations(GLuint firstLocation = 0, size_t baseOffset = 0)
+		{
+			size_t index = 0;
+			int expand[] = { (setAttribute<typename Attributes::format>(firstLocation + location(index), offset(index) + baseOffset), index++, 0)... };
+			(void)expand;
+		}
+
+	private:
+		template <class Attribute>
+		static void applyAttribute(const ShaderReflection& reflection, size_t attributeOffset)
+		{
+			const ShaderAttribute* attribute = reflection.findAttribute(Attribute::name());
+			if (attribute == nullptr) {
+				log::debug("Vertex attribute %s is not used by program", Attribute::name());
+				return;
+			}
+
+			setAttribute<typename Attribute::format>(static_cast<GLuint>(attribute->location), attributeOffset);
+		}
+
+		template <class Format>
+		static void setAttribute(GLuint location, size_t attributeOffset)
+		{
+			const size_t columnSize = Format::SIZE / Format::LOCATIONS;
+
+			for (GLuint column = 0; column < Format::LOCATIONS; column++) {
+				const GLvoid* pointer = reinterpret_cast<const GLvoid*>(attributeOffset + column * columnSize);
+
+				exaglEnableVertexAttribArray(location + column);
+				if (Format::INTEGER) {
+					exaglVertexAttribIPointer(location + column, Format::COMPONENTS, Format::TYPE, stride(), pointer);
+				}
+				else {
+					exaglVertexAttribPointer(location + column, Format::COMPONENTS, Format::TYPE, Format::NORMALIZED, stride(), pointer);
+				}
+
+				// Divisor is vertex array state, reset it for locations reused by per-vertex data
+				exaglVertexAttribDivisor(location + column, Divisor);
+			}
+		}
+	};
+
+	template <class... Attributes>
+	using VertexLayout = VertexStreamLayout<0, Attributes...>;
+
+	// Attributes read once per instance from separate buffer, declared alongside VertexLayout of mesh.
+	// Instance attributes follow vertex ones when explicit locations are used:
+	//
+	// Layout::applyLocations(0);
+	// Instances::applyLocations(Layout::location(Layout::COUNT));
+	template <class... Attributes>
+	using InstanceLayout = VertexStreamLayout<1, Attributes...>;
+}
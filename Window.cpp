@@ -7,6 +7,8 @@
 #include "Log.h"
 #include "Exagine.h"
 #include "Image.h"
+#include "Framebuffer.h"
+#include "Profiler.h"
 #include "exa.h"
 
 namespace exa
@@ -46,6 +48,9 @@ namespace exa
 
 	Window::~Window()
 	{
+		// @note Needs OpenGL context
+		SafeDelete(m_offscreenFramebuffer);
+
 		SDL_GL_DeleteContext(m_sdlGlContext);
 
 		if (m_gameController != nullptr)
@@ -105,11 +110,24 @@ namespace exa
 
 	bool Window::init() 
 	{
+		EXA_PROFILE_FUNCTION();
+
 		log::debug("Initializing window\n\n");
+
+		Uint32 initFlags = SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK;
+
+		if (isHeadless()) {
+			// Offscreen driver creates EGL context without display server (pbuffer or surfaceless),
+			// works with Mesa llvmpipe. Environment variable set by user takes precedence.
+			SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+
+			// Render nodes usually have no sound cards and joysticks
+			initFlags = SDL_INIT_VIDEO;
+		}
 		
 		// Initialize SDL
 		// @note SDL_Init must be called before using any other SDL function
-		if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK) < 0)
+		if (SDL_Init(initFlags) < 0)
 		{
 			log::error("SDL could not initialize!");
 			checkSDLError(__LINE__);
@@ -186,17 +204,22 @@ namespace exa
 			}
 			log::debug("\n\n");
 		}
-		log::debug("Using current audio driver: %s\n\n", SDL_GetCurrentAudioDriver());
+		if (!isHeadless()) {
+			log::debug("Using current audio driver: %s\n\n", SDL_GetCurrentAudioDriver());
 
-		printAudioDevices(0);
-		printAudioDevices(1);
+			printAudioDevices(0);
+			printAudioDevices(1);
+		}
 
 		// A hint that specifies whether the Android / iOS built-in accelerometer 
 		// should be listed as a joystick device, rather than listing actual joysticks only. 
 		SDL_SetHint(SDL_HINT_ACCELEROMETER_AS_JOYSTICK, "1");
 
 		// Check for joysticks
-		if (SDL_NumJoysticks() < 1)
+		if (isHeadless()) {
+			log::debug("Headless mode, joysticks are not used");
+		}
+		else if (SDL_NumJoysticks() < 1)
 		{
 			log::warning("Warning: No joysticks connected!");
 		}
@@ -262,12 +285,6 @@ namespace exa
 			checkSDLError(__LINE__);
 		}
 
-		if (!SDL_SetHintWithPriority(SDL_HINT_RENDER_VSYNC, "1", SDL_HINT_OVERRIDE))
-		{
-			log::warning("Warning: SDL_HINT_RENDER_VSYNC not enabled!");
-			checkSDLError(__LINE__);
-		}
-
 		// Refreshes info about device display mode
 		recalculateDisplayModeRect();
 
@@ -277,10 +294,19 @@ namespace exa
 			flags |= SDL_WINDOW_FULLSCREEN;
 		}
 
+		int windowWidth = getScreenRectWidth();
+		int windowHeight = getScreenRectHeight();
+
+		if (isHeadless()) {
+			flags |= SDL_WINDOW_HIDDEN;
+			windowWidth = getWidth();
+			windowHeight = getHeight();
+		}
+
 		// Create window
 		m_sdlWindow = SDL_CreateWindow(getWindowTitle(),
 			SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-			getScreenRectWidth(), getScreenRectHeight(),
+			windowWidth, windowHeight,
 			flags);
 
 		if (m_sdlWindow == nullptr)
@@ -295,19 +321,22 @@ namespace exa
 		// Refreshes info about window size 
 		recalculateWindowSize();
 
-		// While the mouse is in relative mode, the cursor is hidden, 
-		// and the driver will try to report continuous motion in the current window.
-		// Only relative motion events will be delivered, the mouse position will not change.
-		setRelativeMouseMode(true);
-
-		// Hide cursor
-		// @note SDL_SetRelativeMouseMode also hides cursor
-		hideCursor();
-
-		// When input is grabbed the mouse is confined to the window.
-		// If the caller enables a grab while another window is currently grabbed, 
-		// the other window loses its grab in favor of the caller's window.
-		SDL_SetWindowGrab(m_sdlWindow, SDL_TRUE);
+		// Headless window is never shown, don't grab input
+		if (!isHeadless()) {
+			// While the mouse is in relative mode, the cursor is hidden, 
+			// and the driver will try to report continuous motion in the current window.
+			// Only relative motion events will be delivered, the mouse position will not change.
+			setRelativeMouseMode(true);
+
+			// Hide cursor
+			// @note SDL_SetRelativeMouseMode also hides cursor
+			hideCursor();
+
+			// When input is grabbed the mouse is confined to the window.
+			// If the caller enables a grab while another window is currently grabbed, 
+			// the other window loses its grab in favor of the caller's window.
+			SDL_SetWindowGrab(m_sdlWindow, SDL_TRUE);
+		}
 
 		// Load default OpenGL.
 		SDL_GL_LoadLibrary(nullptr);
@@ -332,15 +361,30 @@ namespace exa
 		// TODO: https://github.com/openfl/lime/blob/efa7c0eab6596619e7414d046a35fdb817ffab96/project/src/backend/sdl/SDLWindow.cpp#L68
 		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
-		SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
-		SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-		SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
+		if (isHeadless()) {
+			// Software rasterizers (llvmpipe) have no hardware accelerated visuals,
+			// pbuffers are often created without multisampling
+			SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 0);
+			SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 0);
+		}
+		else {
+			SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
+			SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
+			SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
+		}
 
 		// Request an OpenGL context
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 
+#if EXA_GL_DEBUG
+		// Drivers report much more through KHR_debug in debug context
+		if (GLDebug::isEnabled()) {
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+		}
+#endif
+
 		m_sdlGlContext = SDL_GL_CreateContext(m_sdlWindow);
 
 		if (!m_sdlGlContext) {
@@ -349,16 +393,25 @@ namespace exa
 			return false;
 		}
 
-		//Use Vsync
-		if (SDL_GL_SetSwapInterval(1) < 0)
-		{
-			log::warning("Warning: Unable to set VSync!");
-			checkSDLError(__LINE__);
-		}
-
 		// Load OpenGL functions
 		gladLoadGLLoader(SDL_GL_GetProcAddress);
 
+#if EXA_GL_STATE_CACHE
+		// New context, nothing is known about it
+		GLSTATE().invalidate();
+#endif
+
+#if EXA_GL_DEBUG
+		GLDebug::init();
+#endif
+
+		if (GLAD_GL_ARB_parallel_shader_compile) {
+			// Let driver choose number of compiler threads, shaders compiled between beginLink and
+			// finishLink of Shader are then built in background
+			exaglMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+			log::debug("Parallel shader compilation is enabled");
+		}
+
 		// Print OpenGL version using glad.		   
 		log::debug("OpenGL %d.%d", GLVersion.major, GLVersion.minor);
 
@@ -374,19 +427,17 @@ namespace exa
 
 		log::debug("\n\n");
 
-		// Re-enabling Vertical Sync if necessary
-		// @see Flags SDL_GL_DOUBLEBUFFER and SDL_RENDERER_PRESENTVSYNC in SDL_CreateWindow
-		if (SDL_GL_GetSwapInterval() == 0) {
-			log::debug("Re-enabling Vertical Sync");
-			// Try to enable Vsync (late swap tearing mode) 
-			if (SDL_GL_SetSwapInterval(-1) < 0) {
-				//Try enable Vsync (updates synchronized with the vertical retrace mode) 
-				if (SDL_GL_SetSwapInterval(1) < 0)
-				{
-					log::warning("Warning: Unable to set VSync!");
-					checkSDLError(__LINE__);
-				}
+		// @note Swap interval (vsync) is set by engine frame pacer, see setSwapInterval
+
+		if (isHeadless()) {
+			m_offscreenFramebuffer = exanew Framebuffer();
+			if (!m_offscreenFramebuffer->create(getWidth(), getHeight())) {
+				log::error("Failed to create offscreen framebuffer");
+				return false;
 			}
+
+			// Everything is rendered into offscreen framebuffer
+			m_offscreenFramebuffer->bind();
 		}
 
 		int Buffers, Samples;
@@ -415,9 +466,80 @@ namespace exa
 
 	void Window::swapWindow()
 	{
+		if (isHeadless()) {
+			// Nothing to present, just submit queued commands
+			exaglFlush();
+			return;
+		}
+
 		SDL_GL_SwapWindow(m_sdlWindow);
 	}
 
+	bool Window::makeContextCurrent()
+	{
+		if (SDL_GL_MakeCurrent(m_sdlWindow, m_sdlGlContext) < 0) {
+			log::error("Failed to make OpenGL context current");
+			checkSDLError(__LINE__);
+			return false;
+		}
+		return true;
+	}
+
+	void Window::releaseContext()
+	{
+		SDL_GL_MakeCurrent(m_sdlWindow, nullptr);
+	}
+
+	void Window::setHeadless(int32 width, int32 height)
+	{
+		if (m_sdlWindow != nullptr) {
+			log::error("Headless mode must be set before window is initialized");
+			return;
+		}
+
+		m_WindowInformation.mode = WindowMode::Headless;
+		handleResize(width, height);
+	}
+
+	/**
+	* @param interval	0 - immediate updates, 1 - updates synchronized with vertical retrace,
+	*					-1 - late swap tearing (adaptive vsync), falls back to 1 if not supported
+	* @see https://wiki.libsdl.org/SDL_GL_SetSwapInterval
+	**/
+	bool Window::setSwapInterval(int interval)
+	{
+		if (SDL_GL_SetSwapInterval(interval) == 0) {
+			log::debug("Swap interval set to %d", interval);
+			return true;
+		}
+
+		if (interval == -1) {
+			log::warning("Warning: Late swap tearing not supported, using VSync");
+			checkSDLError(__LINE__);
+			return setSwapInterval(1);
+		}
+
+		log::warning("Warning: Unable to set swap interval %d!", interval);
+		checkSDLError(__LINE__);
+		return false;
+	}
+
+	int Window::getSwapInterval() const
+	{
+		return SDL_GL_GetSwapInterval();
+	}
+
+	int Window::getRefreshRate()
+	{
+		SDL_DisplayMode displayMode;
+		if (SDL_GetCurrentDisplayMode(getWindowDisplayIndex(), &displayMode) != 0 || displayMode.refresh_rate <= 0)
+		{
+			// Unspecified by driver
+			return 60;
+		}
+		return displayMode.refresh_rate;
+	}
+
 	void Window::setSize(int32 width, int32 height)
 	{
 		handleResize(width, height);
@@ -9,6 +9,7 @@
 namespace exa
 {
 	class Image;
+	class Framebuffer;
 
 	struct WindowSize {
 		int32 width;
@@ -82,6 +83,8 @@ namespace exa
 		Windowed,
 		/** fullscreen window at the current desktop resolution based on SDL_WINDOW_FULLSCREEN_DESKTOP  **/
 		fakeFullscreen,
+		/** no display, hidden offscreen window (EGL pbuffer) rendering into framebuffer object **/
+		Headless,
 		/** The total count of available window modes */
 		TotalCount
 	};
@@ -107,6 +110,10 @@ namespace exa
 
 		bool init();
 
+		// Renders into offscreen framebuffer without display server (uses SDL "offscreen" video driver).
+		// @note Must be called before init
+		void setHeadless(int32 width, int32 height);
+
 		// Used to get screen dimensions
 		void recalculateDisplayModeRect();
 
@@ -119,6 +126,20 @@ namespace exa
 		// Updates window
 		void swapWindow();
 
+		// Makes OpenGL context current on calling thread
+		bool makeContextCurrent();
+
+		// Detaches OpenGL context from calling thread, so other thread may use it
+		void releaseContext();
+
+		// Sets vsync mode, see SDL_GL_SetSwapInterval
+		bool setSwapInterval(int interval);
+
+		int getSwapInterval() const;
+
+		// Display refresh rate in Hz
+		int getRefreshRate();
+
 		void setSize(int32 width, int32 height);
 
 		void addSize(int32 x, int32 y);
@@ -317,6 +338,17 @@ namespace exa
 			return m_WindowInformation.mode == WindowMode::Windowed;
 		}
 
+		inline bool isHeadless() const
+		{
+			return m_WindowInformation.mode == WindowMode::Headless;
+		}
+
+		// Render target used instead of default framebuffer in headless mode
+		Framebuffer* getOffscreenFramebuffer() const
+		{
+			return m_offscreenFramebuffer;
+		}
+
 		static void checkSDLError(int line = -1);
 
 	private:
@@ -335,6 +367,8 @@ namespace exa
 		// An opaque handle to an OpenGL context.
 		SDL_GLContext m_sdlGlContext;
 
+		Framebuffer* m_offscreenFramebuffer = nullptr;
+
 		// maps the device index to indices in the devices array;
 		std::map<unsigned int, unsigned int> deviceMap;
 		const int JOYSTICK_DEAD_ZONE = 8000;
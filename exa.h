@@ -7,6 +7,7 @@
 
 #define PROJECT_SHADERS_DIR "assets/shaders/"
 #define PROJECT_IMAGES_DIR "assets/images/"
+#define PROJECT_SHADER_CACHE_DIR "cache/shaders/"
 
 #if defined(_DEBUG) && !defined(NDEBUG)
 #   define EXA_DEBUG 1
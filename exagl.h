@@ -15,73 +15,198 @@
 #define EVALUATOR(x,y)  PASTER(x,y)
 #define DECLARE_GL_EXT(y)  EVALUATOR(GL_PREFIX,y)
 
-#define exaglDrawArrays DECLARE_GL_EXT(glDrawArrays)
-
-#define exaglClear DECLARE_GL_EXT(glClear)
-
-#define exaglClearColor DECLARE_GL_EXT(glClearColor)
-
-#define exaglGetString DECLARE_GL_EXT(glGetString)
-
-#define exaglGenTextures DECLARE_GL_EXT(glGenTextures)
-
-#define exaglTexParameteri DECLARE_GL_EXT(glTexParameteri)
-#define exaglTexParameterf DECLARE_GL_EXT(glTexParameterf)
-#define exaglTexImage2D DECLARE_GL_EXT(glTexImage2D)
-#define exaglBindTexture DECLARE_GL_EXT(glBindTexture)
-
-#define exaglUniform4f DECLARE_GL_EXT(glUniform4f)
-
-#define exaglGenVertexArrays DECLARE_GL_EXT(glGenVertexArrays)
-#define exaglDeleteVertexArrays DECLARE_GL_EXT(glDeleteVertexArrays)	
-#define exaglBindVertexArray DECLARE_GL_EXT(glBindVertexArray)
-
-#define exaglValidateProgram DECLARE_GL_EXT(glValidateProgram)
-
-#define exaglDetachShader DECLARE_GL_EXT(glDetachShader)
-
-#define exaglEnableVertexAttribArray DECLARE_GL_EXT(glEnableVertexAttribArray)
-#define exaglDisableVertexAttribArray DECLARE_GL_EXT(glDisableVertexAttribArray)
-
-#define exaglShaderSource DECLARE_GL_EXT(glShaderSource)
-#define exaglUseProgram DECLARE_GL_EXT(glUseProgram)
-#define exaglVertexAttribPointer DECLARE_GL_EXT(glVertexAttribPointer)
-#define exaglActiveTexture DECLARE_GL_EXT(glActiveTexture)
-#define exaglDeleteProgram DECLARE_GL_EXT(glDeleteProgram)
-#define exaglGetShaderiv DECLARE_GL_EXT(glGetShaderiv)
-#define exaglGetShaderInfoLog DECLARE_GL_EXT(glGetShaderInfoLog)
-#define exaglCreateShader DECLARE_GL_EXT(glCreateShader)
-#define exaglCreateProgram DECLARE_GL_EXT(glCreateProgram)
-#define exaglAttachShader DECLARE_GL_EXT(glAttachShader)
-#define exaglCompileShader DECLARE_GL_EXT(glCompileShader)
-#define exaglBindAttribLocation DECLARE_GL_EXT(glBindAttribLocation)
-#define exaglGetAttribLocation DECLARE_GL_EXT(glGetAttribLocation)
-#define exaglLinkProgram DECLARE_GL_EXT(glLinkProgram)
-#define exaglUniform1i DECLARE_GL_EXT(glUniform1i)
-#define exaglUniform2fv DECLARE_GL_EXT(glUniform2fv)
-#define exaglUniform2f DECLARE_GL_EXT(glUniform2f)
-#define exaglUniform3fv DECLARE_GL_EXT(glUniform3fv)
-#define exaglUniform4fv DECLARE_GL_EXT(glUniform4fv)
-#define exaglUniform1f DECLARE_GL_EXT(glUniform1f)
-#define exaglUniformMatrix4fv DECLARE_GL_EXT(glUniformMatrix4fv)
-#define exaglBindFramebuffer DECLARE_GL_EXT(glBindFramebuffer)
-#define exaglGenFramebuffers DECLARE_GL_EXT(glGenFramebuffers)
-#define exaglCheckFramebufferStatus DECLARE_GL_EXT(glCheckFramebufferStatus)
-#define exaglDeleteFramebuffers DECLARE_GL_EXT(glDeleteFramebuffers)
-#define exaglGetUniformLocation DECLARE_GL_EXT(glGetUniformLocation)
-#define exaglFramebufferTexture2D DECLARE_GL_EXT(glFramebufferTexture2D)
-#define exaglCompressedTexImage2D DECLARE_GL_EXT(glCompressedTexImage2D)
-#define exaglBindBuffer DECLARE_GL_EXT(glBindBuffer)
-#define exaglGenBuffers DECLARE_GL_EXT(glGenBuffers)
-#define exaglBufferData DECLARE_GL_EXT(glBufferData)
-#define exaglGetProgramiv DECLARE_GL_EXT(glGetProgramiv)
-#define exaglGenerateMipmap DECLARE_GL_EXT(glGenerateMipmap)
-#define exaglStencilOpSeparate DECLARE_GL_EXT(glStencilOpSeparate)
-#define exaglGenRenderbuffers DECLARE_GL_EXT(glGenRenderbuffers)
-#define exaglBindRenderbuffer DECLARE_GL_EXT(glBindRenderbuffer)
-#define exaglRenderbufferStorage DECLARE_GL_EXT(glRenderbufferStorage)
-#define exaglFramebufferRenderbuffer DECLARE_GL_EXT(glFramebufferRenderbuffer)
-#define exaglDeleteRenderbuffers DECLARE_GL_EXT(glDeleteRenderbuffers)
-#define exaglDeleteShader DECLARE_GL_EXT(glDeleteShader)
-#define exaglDeleteBuffers DECLARE_GL_EXT(glDeleteBuffers)
-#define exaglGetProgramInfoLog DECLARE_GL_EXT(glGetProgramInfoLog)
\ No newline at end of file
+// Set to 1 to check glGetError after every exagl* call and get KHR_debug messages, see GLDebug.h
+#ifndef EXA_GL_DEBUG
+#   if defined(_DEBUG) && !defined(NDEBUG)
+#       define EXA_GL_DEBUG 1
+#   else
+#       define EXA_GL_DEBUG 0
+#   endif
+#endif
+
+#if EXA_GL_DEBUG
+#   include "GLDebug.h"
+#   define EXA_GL_CALL(y) ::exa::makeGLCheckedCall(DECLARE_GL_EXT(y), #y, __FILE__, __LINE__)
+#else
+#   define EXA_GL_CALL(y) DECLARE_GL_EXT(y)
+#endif
+
+#define exaglDrawArrays EXA_GL_CALL(glDrawArrays)
+#define exaglDrawElements EXA_GL_CALL(glDrawElements)
+
+#define exaglClear EXA_GL_CALL(glClear)
+
+#define exaglFinish EXA_GL_CALL(glFinish)
+#define exaglFlush EXA_GL_CALL(glFlush)
+
+#define exaglReadPixels EXA_GL_CALL(glReadPixels)
+#define exaglPixelStorei EXA_GL_CALL(glPixelStorei)
+
+#define exaglGetString EXA_GL_CALL(glGetString)
+
+#define exaglGenTextures EXA_GL_CALL(glGenTextures)
+
+#define exaglTexParameteri EXA_GL_CALL(glTexParameteri)
+#define exaglTexParameterf EXA_GL_CALL(glTexParameterf)
+#define exaglTexImage2D EXA_GL_CALL(glTexImage2D)
+
+#define exaglUniform4f EXA_GL_CALL(glUniform4f)
+
+#define exaglGenVertexArrays EXA_GL_CALL(glGenVertexArrays)
+
+#define exaglValidateProgram EXA_GL_CALL(glValidateProgram)
+
+#define exaglDetachShader EXA_GL_CALL(glDetachShader)
+
+#define exaglEnableVertexAttribArray EXA_GL_CALL(glEnableVertexAttribArray)
+#define exaglDisableVertexAttribArray EXA_GL_CALL(glDisableVertexAttribArray)
+
+#define exaglShaderSource EXA_GL_CALL(glShaderSource)
+#define exaglVertexAttribPointer EXA_GL_CALL(glVertexAttribPointer)
+#define exaglGetShaderiv EXA_GL_CALL(glGetShaderiv)
+#define exaglGetShaderInfoLog EXA_GL_CALL(glGetShaderInfoLog)
+#define exaglCreateShader EXA_GL_CALL(glCreateShader)
+#define exaglCreateProgram EXA_GL_CALL(glCreateProgram)
+#define exaglAttachShader EXA_GL_CALL(glAttachShader)
+#define exaglCompileShader EXA_GL_CALL(glCompileShader)
+#define exaglBindAttribLocation EXA_GL_CALL(glBindAttribLocation)
+#define exaglGetAttribLocation EXA_GL_CALL(glGetAttribLocation)
+#define exaglLinkProgram EXA_GL_CALL(glLinkProgram)
+#define exaglUniform1i EXA_GL_CALL(glUniform1i)
+#define exaglUniform2fv EXA_GL_CALL(glUniform2fv)
+#define exaglUniform2f EXA_GL_CALL(glUniform2f)
+#define exaglUniform3fv EXA_GL_CALL(glUniform3fv)
+#define exaglUniform4fv EXA_GL_CALL(glUniform4fv)
+#define exaglUniform1f EXA_GL_CALL(glUniform1f)
+#define exaglUniformMatrix4fv EXA_GL_CALL(glUniformMatrix4fv)
+#define exaglUniform1fv EXA_GL_CALL(glUniform1fv)
+#define exaglUniform1iv EXA_GL_CALL(glUniform1iv)
+#define exaglUniform2iv EXA_GL_CALL(glUniform2iv)
+#define exaglUniform3iv EXA_GL_CALL(glUniform3iv)
+#define exaglUniform4iv EXA_GL_CALL(glUniform4iv)
+#define exaglUniform1uiv EXA_GL_CALL(glUniform1uiv)
+#define exaglUniform2uiv EXA_GL_CALL(glUniform2uiv)
+#define exaglUniform3uiv EXA_GL_CALL(glUniform3uiv)
+#define exaglUniform4uiv EXA_GL_CALL(glUniform4uiv)
+#define exaglUniformMatrix2fv EXA_GL_CALL(glUniformMatrix2fv)
+#define exaglUniformMatrix3fv EXA_GL_CALL(glUniformMatrix3fv)
+#define exaglUniformMatrix2x3fv EXA_GL_CALL(glUniformMatrix2x3fv)
+#define exaglUniformMatrix3x2fv EXA_GL_CALL(glUniformMatrix3x2fv)
+#define exaglUniformMatrix2x4fv EXA_GL_CALL(glUniformMatrix2x4fv)
+#define exaglUniformMatrix4x2fv EXA_GL_CALL(glUniformMatrix4x2fv)
+#define exaglUniformMatrix3x4fv EXA_GL_CALL(glUniformMatrix3x4fv)
+#define exaglUniformMatrix4x3fv EXA_GL_CALL(glUniformMatrix4x3fv)
+#define exaglGetActiveUniform EXA_GL_CALL(glGetActiveUniform)
+#define exaglGetActiveAttrib EXA_GL_CALL(glGetActiveAttrib)
+#define exaglMaxShaderCompilerThreadsARB EXA_GL_CALL(glMaxShaderCompilerThreadsARB)
+#define exaglGenFramebuffers EXA_GL_CALL(glGenFramebuffers)
+#define exaglCheckFramebufferStatus EXA_GL_CALL(glCheckFramebufferStatus)
+#define exaglGetUniformLocation EXA_GL_CALL(glGetUniformLocation)
+#define exaglFramebufferTexture2D EXA_GL_CALL(glFramebufferTexture2D)
+#define exaglCompressedTexImage2D EXA_GL_CALL(glCompressedTexImage2D)
+#define exaglGenBuffers EXA_GL_CALL(glGenBuffers)
+#define exaglBufferData EXA_GL_CALL(glBufferData)
+#define exaglGetProgramiv EXA_GL_CALL(glGetProgramiv)
+#define exaglGenerateMipmap EXA_GL_CALL(glGenerateMipmap)
+#define exaglStencilOpSeparate EXA_GL_CALL(glStencilOpSeparate)
+#define exaglGenRenderbuffers EXA_GL_CALL(glGenRenderbuffers)
+#define exaglRenderbufferStorage EXA_GL_CALL(glRenderbufferStorage)
+#define exaglFramebufferRenderbuffer EXA_GL_CALL(glFramebufferRenderbuffer)
+#define exaglDeleteShader EXA_GL_CALL(glDeleteShader)
+#define exaglGetProgramInfoLog EXA_GL_CALL(glGetProgramInfoLog)
+#define exaglGenQueries EXA_GL_CALL(glGenQueries)
+#define exaglDeleteQueries EXA_GL_CALL(glDeleteQueries)
+#define exaglQueryCounter EXA_GL_CALL(glQueryCounter)
+#define exaglGetQueryObjectui64v EXA_GL_CALL(glGetQueryObjectui64v)
+#define exaglGetInteger64v EXA_GL_CALL(glGetInteger64v)
+#define exaglGetIntegerv EXA_GL_CALL(glGetIntegerv)
+#define exaglGetProgramBinary EXA_GL_CALL(glGetProgramBinary)
+#define exaglProgramBinary EXA_GL_CALL(glProgramBinary)
+#define exaglProgramParameteri EXA_GL_CALL(glProgramParameteri)
+#define exaglGetActiveUniformsiv EXA_GL_CALL(glGetActiveUniformsiv)
+#define exaglGetActiveUniformBlockiv EXA_GL_CALL(glGetActiveUniformBlockiv)
+#define exaglGetActiveUniformBlockName EXA_GL_CALL(glGetActiveUniformBlockName)
+#define exaglGetUniformiv EXA_GL_CALL(glGetUniformiv)
+#define exaglVertexAttribIPointer EXA_GL_CALL(glVertexAttribIPointer)
+#define exaglBufferSubData EXA_GL_CALL(glBufferSubData)
+#define exaglBufferStorage EXA_GL_CALL(glBufferStorage)
+#define exaglMapBufferRange EXA_GL_CALL(glMapBufferRange)
+#define exaglFlushMappedBufferRange EXA_GL_CALL(glFlushMappedBufferRange)
+#define exaglUnmapBuffer EXA_GL_CALL(glUnmapBuffer)
+#define exaglFenceSync EXA_GL_CALL(glFenceSync)
+#define exaglClientWaitSync EXA_GL_CALL(glClientWaitSync)
+#define exaglDeleteSync EXA_GL_CALL(glDeleteSync)
+#define exaglCopyBufferSubData EXA_GL_CALL(glCopyBufferSubData)
+#define exaglDrawElementsBaseVertex EXA_GL_CALL(glDrawElementsBaseVertex)
+#define exaglVertexAttribDivisor EXA_GL_CALL(glVertexAttribDivisor)
+#define exaglDrawArraysInstanced EXA_GL_CALL(glDrawArraysInstanced)
+#define exaglDrawElementsInstancedBaseVertex EXA_GL_CALL(glDrawElementsInstancedBaseVertex)
+#define exaglMultiDrawElementsIndirect EXA_GL_CALL(glMultiDrawElementsIndirect)
+#define exaglVertexAttribI1ui EXA_GL_CALL(glVertexAttribI1ui)
+#define exaglGetUniformBlockIndex EXA_GL_CALL(glGetUniformBlockIndex)
+#define exaglUniformBlockBinding EXA_GL_CALL(glUniformBlockBinding)
+
+// Set to 0 to send all state changes straight to driver
+#ifndef EXA_GL_STATE_CACHE
+#   define EXA_GL_STATE_CACHE 1
+#endif
+
+// State changing calls, dropped by GLStateCache if they would not change anything
+#if EXA_GL_STATE_CACHE
+#   include "GLStateCache.h"
+// Debug layer reports errors of cached calls at call site, not inside GLStateCache.cpp
+#   if EXA_GL_DEBUG
+#       define EXA_GL_STATE_CALL() GLSTATE().setCallSite(__FILE__, __LINE__)
+#   else
+#       define EXA_GL_STATE_CALL() GLSTATE()
+#   endif
+#   define exaglUseProgram EXA_GL_STATE_CALL().useProgram
+#   define exaglBindVertexArray EXA_GL_STATE_CALL().bindVertexArray
+#   define exaglBindBuffer EXA_GL_STATE_CALL().bindBuffer
+#   define exaglBindBufferBase EXA_GL_STATE_CALL().bindBufferBase
+#   define exaglBindBufferRange EXA_GL_STATE_CALL().bindBufferRange
+#   define exaglBindFramebuffer EXA_GL_STATE_CALL().bindFramebuffer
+#   define exaglBindRenderbuffer EXA_GL_STATE_CALL().bindRenderbuffer
+#   define exaglActiveTexture EXA_GL_STATE_CALL().activeTexture
+#   define exaglBindTexture EXA_GL_STATE_CALL().bindTexture
+#   define exaglEnable EXA_GL_STATE_CALL().enable
+#   define exaglDisable EXA_GL_STATE_CALL().disable
+#   define exaglBlendFunc EXA_GL_STATE_CALL().blendFunc
+#   define exaglBlendFuncSeparate EXA_GL_STATE_CALL().blendFuncSeparate
+#   define exaglBlendEquation EXA_GL_STATE_CALL().blendEquation
+#   define exaglDepthFunc EXA_GL_STATE_CALL().depthFunc
+#   define exaglDepthMask EXA_GL_STATE_CALL().depthMask
+#   define exaglViewport EXA_GL_STATE_CALL().viewport
+#   define exaglClearColor EXA_GL_STATE_CALL().clearColor
+#   define exaglDeleteProgram EXA_GL_STATE_CALL().deleteProgram
+#   define exaglDeleteVertexArrays EXA_GL_STATE_CALL().deleteVertexArrays
+#   define exaglDeleteBuffers EXA_GL_STATE_CALL().deleteBuffers
+#   define exaglDeleteTextures EXA_GL_STATE_CALL().deleteTextures
+#   define exaglDeleteFramebuffers EXA_GL_STATE_CALL().deleteFramebuffers
+#   define exaglDeleteRenderbuffers EXA_GL_STATE_CALL().deleteRenderbuffers
+#else
+#   define exaglUseProgram EXA_GL_CALL(glUseProgram)
+#   define exaglBindVertexArray EXA_GL_CALL(glBindVertexArray)
+#   define exaglBindBuffer EXA_GL_CALL(glBindBuffer)
+#   define exaglBindBufferBase EXA_GL_CALL(glBindBufferBase)
+#   define exaglBindBufferRange EXA_GL_CALL(glBindBufferRange)
+#   define exaglBindFramebuffer EXA_GL_CALL(glBindFramebuffer)
+#   define exaglBindRenderbuffer EXA_GL_CALL(glBindRenderbuffer)
+#   define exaglActiveTexture EXA_GL_CALL(glActiveTexture)
+#   define exaglBindTexture EXA_GL_CALL(glBindTexture)
+#   define exaglEnable EXA_GL_CALL(glEnable)
+#   define exaglDisable EXA_GL_CALL(glDisable)
+#   define exaglBlendFunc EXA_GL_CALL(glBlendFunc)
+#   define exaglBlendFuncSeparate EXA_GL_CALL(glBlendFuncSeparate)
+#   define exaglBlendEquation EXA_GL_CALL(glBlendEquation)
+#   define exaglDepthFunc EXA_GL_CALL(glDepthFunc)
+#   define exaglDepthMask EXA_GL_CALL(glDepthMask)
+#   define exaglViewport EXA_GL_CALL(glViewport)
+#   define exaglClearColor EXA_GL_CALL(glClearColor)
+#   define exaglDeleteProgram EXA_GL_CALL(glDeleteProgram)
+#   define exaglDeleteVertexArrays EXA_GL_CALL(glDeleteVertexArrays)
+#   define exaglDeleteBuffers EXA_GL_CALL(glDeleteBuffers)
+#   define exaglDeleteTextures EXA_GL_CALL(glDeleteTextures)
+#   define exaglDeleteFramebuffers EXA_GL_CALL(glDeleteFramebuffers)
+#   define exaglDeleteRenderbuffers EXA_GL_CALL(glDeleteRenderbuffers)
+#endif
\ No newline at end of file
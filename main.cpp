@@ -2,12 +2,57 @@
 // For conditions of distribution and use, see copyright notice in LICENSE.txt
 
 #include "Exagine.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 using namespace exa;
 
+/**
+* Command line options:
+*	--headless WIDTHxHEIGHT		render offscreen without display (default 1280x720)
+*	--frames N					quit after N frames
+*	--render-thread				replay OpenGL commands on dedicated thread
+*	--trace FILE				write profile of last frames in Chrome trace format on exit
+*	--hot-reload				recompile shaders when their files change (default in debug builds)
+**/
 int main(int argc, char** argv)
 {
 	Exagine& engine = EXAGINE();
+
+	const char* traceFile = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			int width = 1280;
+			int height = 720;
+			if (i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2) {
+				i++;
+			}
+			engine.setHeadless(width, height);
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			engine.setMaxFrames(strtoull(argv[++i], nullptr, 10));
+		}
+		else if (strcmp(argv[i], "--render-thread") == 0) {
+			engine.setRenderThreadEnabled();
+		}
+		else if (strcmp(argv[i], "--hot-reload") == 0) {
+			engine.setShaderHotReload(true);
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			traceFile = argv[++i];
+			PROFILER().setEnabled(true);
+		}
+	}
+
 	int result = engine.start();
+
+	if (traceFile != nullptr) {
+		PROFILER().exportChromeTrace(traceFile);
+	}
+
 	return result;
 }